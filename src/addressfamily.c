@@ -0,0 +1,225 @@
+/**
+ * \file addressfamily.c
+ * \brief Learned preference for IPv4 or IPv6 per host.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "addressfamily.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Group of the cache file that holds the address family of each host. */
+#define ADDRESS_FAMILY_GROUP "address families"
+
+
+
+/**
+ * Open the address family cache in a file.  A missing or unreadable file
+ * leaves the cache empty.
+ * @param file_name [in] File that keeps the cache between runs.
+ * @return New address family cache.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+address_family_cache_t*
+create_address_family_cache( const gchar *file_name )
+{
+	address_family_cache_t *cache;
+
+	cache = g_new0( address_family_cache_t, 1 );
+	cache->families  = g_key_file_new( );
+	cache->file_name = g_strdup( file_name );
+	g_mutex_init( &cache->lock );
+	g_key_file_load_from_file( cache->families, file_name, G_KEY_FILE_NONE,
+							   NULL );
+
+	return( cache );
+}
+
+
+
+/**
+ * Close the address family cache.  The cache is written to its file if an
+ * address family has changed.
+ * @param cache [out] The cache that is to be closed, or \a NULL.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+void
+destroy_address_family_cache( address_family_cache_t *cache )
+{
+	gchar *contents;
+	gsize length;
+
+	if( cache != NULL )
+	{
+		if( cache->changed == TRUE )
+		{
+			contents = g_key_file_to_data( cache->families, &length, NULL );
+			g_file_set_contents( cache->file_name, contents, length, NULL );
+			g_free( contents );
+		}
+		g_key_file_free( cache->families );
+		g_free( cache->file_name );
+		g_mutex_clear( &cache->lock );
+		g_free( cache );
+	}
+}
+
+
+
+/**
+ * Get the host name of a URL, without the scheme, user, port, and path.
+ * The brackets around an IPv6 address are removed.
+ * @param url [in] URL.
+ * @return Newly allocated host name.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+gchar*
+get_url_host( const gchar *url )
+{
+	const gchar *host;
+	const gchar *host_end;
+	const gchar *user_end;
+
+	host = strstr( url, "://" );
+	host = ( host != NULL ) ? host + strlen( "://" ) : url;
+	host_end = host + strcspn( host, "/?#" );
+	user_end = memchr( host, '@', host_end - host );
+	if( user_end != NULL )
+	{
+		host = user_end + 1;
+	}
+	if( *host == '[' )
+	{
+		host++;
+		host_end = host + strcspn( host, "]/?#" );
+	}
+	else
+	{
+		host_end = host + strcspn( host, ":/?#" );
+	}
+
+	return( g_ascii_strdown( host, host_end - host ) );
+}
+
+
+
+/**
+ * Get the address family that connected first to the host of a URL in an
+ * earlier connection.
+ * @param cache [in/out] Address family cache, or \a NULL.
+ * @param url [in] URL of a request.
+ * @return The address family, or \a ADDRESS_FAMILY_UNKNOWN if the host has
+ *         not been connected to.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+address_family_t
+get_preferred_address_family( address_family_cache_t *cache,
+							  const gchar *url )
+{
+	gchar            *host;
+	gchar            *family_name;
+	address_family_t family = ADDRESS_FAMILY_UNKNOWN;
+
+	if( cache != NULL )
+	{
+		host = get_url_host( url );
+		g_mutex_lock( &cache->lock );
+		family_name = g_key_file_get_string( cache->families,
+											 ADDRESS_FAMILY_GROUP, host,
+											 NULL );
+		g_mutex_unlock( &cache->lock );
+		if( g_strcmp0( family_name, "ipv4" ) == 0 )
+		{
+			family = ADDRESS_FAMILY_IPV4;
+		}
+		else if( g_strcmp0( family_name, "ipv6" ) == 0 )
+		{
+			family = ADDRESS_FAMILY_IPV6;
+		}
+		g_free( family_name );
+		g_free( host );
+	}
+
+	return( family );
+}
+
+
+
+/**
+ * Remember the address family that connected first to the host of a URL.
+ * @param cache [in/out] Address family cache, or \a NULL.
+ * @param url [in] URL of a request.
+ * @param family [in] Address family of the connection.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+void
+set_preferred_address_family( address_family_cache_t *cache,
+							  const gchar *url, address_family_t family )
+{
+	gchar *host;
+
+	if( ( cache != NULL ) && ( family != ADDRESS_FAMILY_UNKNOWN ) &&
+		( get_preferred_address_family( cache, url ) != family ) )
+	{
+		host = get_url_host( url );
+		g_mutex_lock( &cache->lock );
+		g_key_file_set_string( cache->families, ADDRESS_FAMILY_GROUP, host,
+							   family == ADDRESS_FAMILY_IPV4 ?
+							   "ipv4" : "ipv6" );
+		cache->changed = TRUE;
+		g_mutex_unlock( &cache->lock );
+		g_free( host );
+	}
+}
+
+
+
+/**
+ * Determine the address family of a numeric IP address.
+ * @param ip_address [in] IP address, or \a NULL.
+ * @return \a ADDRESS_FAMILY_IPV6 if the address contains a colon,
+ *         \a ADDRESS_FAMILY_IPV4 if it contains a dot, or
+ *         \a ADDRESS_FAMILY_UNKNOWN otherwise.
+ * Test: unit test (test-gtasks.c: address_family_cache).
+ */
+address_family_t
+get_address_family( const gchar *ip_address )
+{
+	if( ip_address == NULL )
+	{
+		return( ADDRESS_FAMILY_UNKNOWN );
+	}
+	if( strchr( ip_address, ':' ) != NULL )
+	{
+		return( ADDRESS_FAMILY_IPV6 );
+	}
+	if( strchr( ip_address, '.' ) != NULL )
+	{
+		return( ADDRESS_FAMILY_IPV4 );
+	}
+	return( ADDRESS_FAMILY_UNKNOWN );
+}
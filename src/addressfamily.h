@@ -0,0 +1,84 @@
+/**
+ * \file addressfamily.h
+ * \brief Definitions for the learned address family of each host.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_ADDRESSFAMILY_H
+#define __GTASKS_ADDRESSFAMILY_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* Address family that connected first to a host. */
+typedef enum
+{
+	ADDRESS_FAMILY_UNKNOWN,
+	ADDRESS_FAMILY_IPV4,
+	ADDRESS_FAMILY_IPV6
+} address_family_t;
+
+/* The address family that won the connection race to each host, kept on
+   disk between runs.  The cache is locked because the connections are
+   pre-warmed in another thread. */
+typedef struct
+{
+	GKeyFile *families;
+	gchar    *file_name;
+	gboolean changed;
+	GMutex   lock;
+} address_family_cache_t;
+
+
+/*
+ * Open the address family cache in a file.
+ */
+address_family_cache_t *create_address_family_cache( const gchar *file_name );
+
+/*
+ * Close the address family cache, writing it to its file if it changed.
+ */
+void destroy_address_family_cache( address_family_cache_t *cache );
+
+/*
+ * Get the address family that connected first to the host of a URL.
+ */
+address_family_t get_preferred_address_family( address_family_cache_t *cache,
+											   const gchar *url );
+
+/*
+ * Remember the address family that connected first to the host of a URL.
+ */
+void set_preferred_address_family( address_family_cache_t *cache,
+								   const gchar *url,
+								   address_family_t family );
+
+/*
+ * Determine the address family of a numeric IP address.
+ */
+address_family_t get_address_family( const gchar *ip_address );
+
+/*
+ * Get the host name of a URL.
+ */
+gchar *get_url_host( const gchar *url );
+
+
+#endif /* __GTASKS_ADDRESSFAMILY_H */
@@ -0,0 +1,347 @@
+/**
+ * \file batch.c
+ * \brief Pack several Google API requests into one batch request.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "postform.h"
+#include "multirequest.h"
+#include "batch.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+
+/**
+ * Build the multipart/mixed body of a batch request.  Each request becomes
+ * an application/http part whose Content-ID identifies the request by its
+ * position in the list, starting with "item1".
+ * @param requests [in] List of the \a api_request_t requests in the batch.
+ * @param boundary [in] Boundary string that separates the parts.
+ * @return Newly allocated batch body.
+ * Test: unit test (test-gtasks.c: build_batch_body).
+ */
+gchar*
+build_batch_body( const GSList *requests, const gchar *boundary )
+{
+	GString             *body;
+	const GSList        *request_entry;
+	const api_request_t *request;
+	const gchar         *path;
+	guint               item = 1;
+
+	body = g_string_new( NULL );
+	for( request_entry = requests; request_entry != NULL;
+		 request_entry = request_entry->next )
+	{
+		request = request_entry->data;
+		/* The request line only contains the path of the URL. */
+		path = strstr( request->url, "://" );
+		path = ( path != NULL ) ? strchr( path + 3, '/' ) : request->url;
+		if( path == NULL )
+		{
+			path = "/";
+		}
+		g_string_append_printf( body,
+								"--%s\r\n"
+								"Content-Type: application/http\r\n"
+								"Content-ID: <item%u>\r\n"
+								"\r\n"
+								"%s %s HTTP/1.1\r\n",
+								boundary, item++, request->method, path );
+		if( request->cached_etag != NULL )
+		{
+			g_string_append_printf( body, "If-None-Match: %s\r\n",
+									request->cached_etag );
+		}
+		if( request->body != NULL )
+		{
+			g_string_append_printf( body,
+									"Content-Type: application/json\r\n"
+									"Content-Length: %u\r\n"
+									"\r\n"
+									"%s\r\n",
+									(guint) strlen( request->body ),
+									request->body );
+		}
+		else
+		{
+			g_string_append( body, "\r\n" );
+		}
+	}
+	g_string_append_printf( body, "--%s--\r\n", boundary );
+
+	return( g_string_free( body, FALSE ) );
+}
+
+
+
+/**
+ * Extract the boundary parameter from a multipart Content-Type value.
+ * @param content_type [in] Value of the Content-Type header.
+ * @return Newly allocated boundary string, or \a NULL if the content type
+ *         has no boundary.
+ * Test: implied (test-gtasks.c: demultiplex_batch_response).
+ */
+STATIC gchar*
+get_batch_boundary( const gchar *content_type )
+{
+	const gchar *boundary;
+	gsize       length;
+
+	if( content_type == NULL )
+	{
+		return( NULL );
+	}
+	boundary = strstr( content_type, "boundary=" );
+	if( boundary == NULL )
+	{
+		return( NULL );
+	}
+	boundary += strlen( "boundary=" );
+	/* The boundary may be quoted. */
+	if( *boundary == '"' )
+	{
+		boundary++;
+		length = strcspn( boundary, "\"" );
+	}
+	else
+	{
+		length = strcspn( boundary, "; \t\r\n" );
+	}
+
+	return( g_strndup( boundary, length ) );
+}
+
+
+
+/**
+ * Find the end of a block of headers, which is terminated by an empty line.
+ * Both CRLF and LF line endings are accepted.
+ * @param text [in] Text that begins with a block of headers.
+ * @return Pointer to the first character after the empty line, or a pointer
+ *         to the end of the text if there is no empty line.
+ */
+STATIC const gchar*
+find_headers_end( const gchar *text )
+{
+	const gchar *line = text;
+
+	while( *line != '\0' )
+	{
+		if( *line == '\n' )
+		{
+			return( line + 1 );
+		}
+		if( ( line[ 0 ] == '\r' ) && ( line[ 1 ] == '\n' ) )
+		{
+			return( line + 2 );
+		}
+		/* Skip to the next line. */
+		line = strchr( line, '\n' );
+		if( line == NULL )
+		{
+			return( text + strlen( text ) );
+		}
+		line++;
+	}
+
+	return( line );
+}
+
+
+
+/**
+ * Find the value of a header in a block of headers.  The header name is
+ * matched without regard to case.
+ * @param headers [in] Block of headers.
+ * @param headers_end [in] End of the block of headers.
+ * @param name [in] Name of the header, without the colon.
+ * @return Pointer to the header value within the headers, or \a NULL if the
+ *         header is not found.
+ */
+STATIC const gchar*
+find_header_value( const gchar *headers, const gchar *headers_end,
+				   const gchar *name )
+{
+	const gchar *line;
+	gsize       name_length = strlen( name );
+
+	for( line = headers; ( line != NULL ) && ( line < headers_end ); )
+	{
+		if( ( g_ascii_strncasecmp( line, name, name_length ) == 0 ) &&
+			( line[ name_length ] == ':' ) )
+		{
+			line += name_length + 1;
+			while( ( *line == ' ' ) || ( *line == '\t' ) )
+			{
+				line++;
+			}
+			return( line );
+		}
+		line = strchr( line, '\n' );
+		if( line != NULL )
+		{
+			line++;
+		}
+	}
+
+	return( NULL );
+}
+
+
+
+/**
+ * Decode one part of a batch response and assign the HTTP status and the
+ * body to the request that the part's Content-ID refers to.
+ * @param part [in] The part, without the boundary delimiters.
+ * @param requests [in/out] List of the requests in the batch.
+ * @return Nothing.
+ */
+STATIC void
+demultiplex_batch_part( const gchar *part, GSList *requests )
+{
+	const gchar   *part_body;
+	const gchar   *content_id;
+	const gchar   *content_end;
+	const gchar   *item;
+	const gchar   *http_body;
+	const gchar   *etag;
+	guint         item_number;
+	long          http_status;
+	api_request_t *request;
+	gchar         *body;
+
+	/* Find the request from the part's Content-ID, which is of the form
+	   <response-itemN>. */
+	while( ( *part == '\r' ) || ( *part == '\n' ) )
+	{
+		part++;
+	}
+	part_body  = find_headers_end( part );
+	content_id = find_header_value( part, part_body, "Content-ID" );
+	if( content_id == NULL )
+	{
+		return;
+	}
+	/* Look for the item number only in the Content-ID header's value. */
+	content_end = content_id + strcspn( content_id, "\r\n" );
+	item = g_strstr_len( content_id, content_end - content_id, "item" );
+	if( item == NULL )
+	{
+		return;
+	}
+	item_number = strtoul( item + strlen( "item" ), NULL, 10 );
+	request = g_slist_nth_data( requests, item_number - 1 );
+	if( ( item_number == 0 ) || ( request == NULL ) )
+	{
+		return;
+	}
+
+	/* The part's body is an HTTP response with a status line, headers,
+	   and a body. */
+	if( sscanf( part_body, "HTTP/%*s %ld", &http_status ) != 1 )
+	{
+		return;
+	}
+	http_body = find_headers_end( part_body );
+	etag      = find_header_value( part_body, http_body, "ETag" );
+	if( etag != NULL )
+	{
+		g_free( request->etag );
+		request->etag = g_strndup( etag, strcspn( etag, "\r\n" ) );
+	}
+	body      = g_strchomp( g_strdup( http_body ) );
+	request->http_status   = http_status;
+	g_free( request->response.data );
+	request->response.data = body;
+	request->response.size = strlen( body );
+	request->response.allocated = request->response.size + 1;
+}
+
+
+
+/**
+ * Split the multipart/mixed response to a batch request into the responses
+ * to the individual requests.  Each request's \a http_status and \a response
+ * are set from the part with the matching Content-ID; requests without a
+ * matching part are left untouched.
+ * @param content_type [in] Content-Type header of the batch response.
+ * @param response [in] Body of the batch response.
+ * @param requests [in/out] List of the \a api_request_t requests in the batch,
+ *        in the order they were packed by \a build_batch_body.
+ * @return \a TRUE if the response is a multipart response, or \a FALSE
+ *         otherwise.
+ * Test: unit test (test-gtasks.c: demultiplex_batch_response).
+ */
+gboolean
+demultiplex_batch_response( const gchar *content_type, const gchar *response,
+							GSList *requests )
+{
+	gchar       *boundary;
+	gchar       *delimiter;
+	gsize       delimiter_length;
+	const gchar *part_start;
+	const gchar *part_end;
+	gchar       *part;
+	gboolean    success = FALSE;
+
+	boundary = get_batch_boundary( content_type );
+	if( ( boundary == NULL ) || ( response == NULL ) )
+	{
+		g_free( boundary );
+		return( FALSE );
+	}
+	delimiter        = g_strconcat( "--", boundary, NULL );
+	delimiter_length = strlen( delimiter );
+
+	part_start = strstr( response, delimiter );
+	while( part_start != NULL )
+	{
+		part_start += delimiter_length;
+		/* Stop at the closing delimiter. */
+		if( strncmp( part_start, "--", 2 ) == 0 )
+		{
+			success = TRUE;
+			break;
+		}
+		part_end = strstr( part_start, delimiter );
+		if( part_end == NULL )
+		{
+			break;
+		}
+		part = g_strndup( part_start, part_end - part_start );
+		demultiplex_batch_part( part, requests );
+		g_free( part );
+		success    = TRUE;
+		part_start = part_end;
+	}
+
+	g_free( delimiter );
+	g_free( boundary );
+
+	return( success );
+}
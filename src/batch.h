@@ -0,0 +1,49 @@
+/**
+ * \file batch.h
+ * \brief Definitions for batches of Google API requests.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_BATCH_H
+#define __GTASKS_BATCH_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* Largest number of requests that are packed into one batch request. */
+#define MAX_BATCH_REQUESTS 100
+
+
+/*
+ * Build the multipart/mixed body of a batch request that contains the
+ * specified requests.
+ */
+gchar *build_batch_body( const GSList *requests, const gchar *boundary );
+
+/*
+ * Split the multipart/mixed response to a batch request into the responses
+ * to the individual requests.
+ */
+gboolean demultiplex_batch_response( const gchar *content_type,
+									 const gchar *response,
+									 GSList *requests );
+
+
+#endif /* __GTASKS_BATCH_H */
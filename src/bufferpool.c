@@ -0,0 +1,160 @@
+/**
+ * \file bufferpool.c
+ * \brief Pool of response buffers that are reused across requests.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "postform.h"
+#include "bufferpool.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+
+/**
+ * Create a buffer pool.
+ * @param max_free [in] Largest number of free buffers that the pool keeps.
+ * @return New buffer pool.
+ */
+buffer_pool_t*
+create_buffer_pool( guint max_free )
+{
+	buffer_pool_t *pool;
+
+	pool = g_new0( buffer_pool_t, 1 );
+	pool->max_free = max_free;
+
+	return( pool );
+}
+
+
+
+/**
+ * Auxiliary function used by \a destroy_buffer_pool to free a buffer.
+ * @param buffer_ptr [in] Pointer to a \a struct \a curl_write_buffer_t.
+ * @param user_data [in] Unused.
+ * @return Nothing.
+ */
+STATIC void
+destroy_pooled_buffer( gpointer buffer_ptr, gpointer user_data )
+{
+	struct curl_write_buffer_t *buffer = buffer_ptr;
+
+	g_free( buffer->data );
+	g_free( buffer );
+}
+
+
+
+/**
+ * Destroy a buffer pool and its free buffers.  Buffers that are in use are
+ * not affected.
+ * @param pool [out] The buffer pool that is to be destroyed.
+ * @return Nothing.
+ */
+void
+destroy_buffer_pool( buffer_pool_t *pool )
+{
+	if( pool != NULL )
+	{
+		g_slist_foreach( pool->free_buffers, destroy_pooled_buffer, NULL );
+		g_slist_free( pool->free_buffers );
+		g_free( pool );
+	}
+}
+
+
+
+/**
+ * Get an empty, zero-terminated response buffer from the pool.  The most
+ * recently released buffer is reused if there is one; otherwise a new buffer
+ * is allocated.
+ * @param pool [in/out] Buffer pool.
+ * @param buffer [out] Response buffer, which must not hold any data.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: buffer_pool).
+ */
+void
+acquire_pooled_buffer( buffer_pool_t *pool,
+					   struct curl_write_buffer_t *buffer )
+{
+	struct curl_write_buffer_t *free_buffer;
+
+	if( pool->free_buffers != NULL )
+	{
+		free_buffer = pool->free_buffers->data;
+		pool->free_buffers = g_slist_delete_link( pool->free_buffers,
+												  pool->free_buffers );
+		pool->free_count--;
+		*buffer = *free_buffer;
+		g_free( free_buffer );
+		pool->hits++;
+	}
+	else
+	{
+		buffer->data      = g_malloc( POOL_BUFFER_SIZE );
+		buffer->allocated = POOL_BUFFER_SIZE;
+		pool->misses++;
+	}
+	buffer->size      = 0;
+	buffer->data[ 0 ] = '\0';
+}
+
+
+
+/**
+ * Return a response buffer to the pool.  The buffer is freed instead if the
+ * pool is full or the buffer is very large.  The buffer is empty afterwards.
+ * @param pool [in/out] Buffer pool.
+ * @param buffer [in/out] Response buffer.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: buffer_pool).
+ */
+void
+release_pooled_buffer( buffer_pool_t *pool,
+					   struct curl_write_buffer_t *buffer )
+{
+	struct curl_write_buffer_t *free_buffer;
+
+	if( buffer->data == NULL )
+	{
+		return;
+	}
+	if( ( pool != NULL ) && ( pool->free_count < pool->max_free ) &&
+		( buffer->allocated > 0 ) &&
+		( buffer->allocated <= MAX_POOL_BUFFER_SIZE ) )
+	{
+		free_buffer  = g_new( struct curl_write_buffer_t, 1 );
+		*free_buffer = *buffer;
+		pool->free_buffers = g_slist_prepend( pool->free_buffers,
+											  free_buffer );
+		pool->free_count++;
+	}
+	else
+	{
+		g_free( buffer->data );
+	}
+	buffer->data      = NULL;
+	buffer->size      = 0;
+	buffer->allocated = 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * \file bufferpool.h
+ * \brief Definitions for the pool of response buffers.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_BUFFERPOOL_H
+#define __GTASKS_BUFFERPOOL_H
+
+#include <config.h>
+#include <glib.h>
+#include "postform.h"
+
+
+/* Size of the buffers that the pool allocates when it has no free
+   buffers. */
+#define POOL_BUFFER_SIZE ( 16 * 1024 )
+/* Buffers larger than this are freed instead of being returned to the
+   pool. */
+#define MAX_POOL_BUFFER_SIZE ( 4 * 1024 * 1024 )
+
+
+/* The buffer pool keeps the response buffers of completed requests so that
+   later requests in the session can receive their responses into them. */
+typedef struct
+{
+	/* Free buffers, as struct curl_write_buffer_t pointers. */
+	GSList *free_buffers;
+	guint  free_count;
+	guint  max_free;
+	/* Number of buffers that were handed out from the free buffers, and
+	   number of buffers that had to be allocated. */
+	guint  hits;
+	guint  misses;
+} buffer_pool_t;
+
+
+/*
+ * Create a buffer pool.
+ */
+buffer_pool_t *create_buffer_pool( guint max_free );
+
+/*
+ * Destroy a buffer pool and its free buffers.
+ */
+void destroy_buffer_pool( buffer_pool_t *pool );
+
+/*
+ * Get an empty response buffer from the pool.
+ */
+void acquire_pooled_buffer( buffer_pool_t *pool,
+							struct curl_write_buffer_t *buffer );
+
+/*
+ * Return a response buffer to the pool.
+ */
+void release_pooled_buffer( buffer_pool_t *pool,
+							struct curl_write_buffer_t *buffer );
+
+
+#endif /* __GTASKS_BUFFERPOOL_H */
@@ -0,0 +1,235 @@
+/**
+ * \file circuitbreaker.c
+ * \brief Circuit breakers that fail requests to degraded servers fast.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "circuitbreaker.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+
+/**
+ * Create circuit breakers.
+ * @param threshold [in] Number of consecutive failures that open a circuit.
+ * @param open_time [in] Time in microseconds that a circuit stays open
+ *        before a probe request is let through.
+ * @return New circuit breakers, or \a NULL if \a threshold is 0, which
+ *         disables the circuit breakers.
+ * Test: unit test (test-gtasks.c: circuit_breaker).
+ */
+circuit_breakers_t*
+create_circuit_breakers( guint threshold, gint64 open_time )
+{
+	circuit_breakers_t *breakers;
+
+	if( threshold == 0 )
+	{
+		return( NULL );
+	}
+	breakers = g_new0( circuit_breakers_t, 1 );
+	breakers->circuits  = g_hash_table_new_full( g_str_hash, g_str_equal,
+												 g_free, g_free );
+	breakers->threshold = threshold;
+	breakers->open_time = open_time;
+
+	return( breakers );
+}
+
+
+
+/**
+ * Destroy circuit breakers.
+ * @param breakers [out] The circuit breakers that are to be destroyed, or
+ *        \a NULL.
+ * @return Nothing.
+ */
+void
+destroy_circuit_breakers( circuit_breakers_t *breakers )
+{
+	if( breakers != NULL )
+	{
+		g_hash_table_destroy( breakers->circuits );
+		g_free( breakers );
+	}
+}
+
+
+
+/**
+ * Get the name of the circuit that a URL belongs to, which is the URL's
+ * scheme and host.  A degraded server fails requests to all of its paths,
+ * so they share one circuit.
+ * @param url [in] URL of a request.
+ * @return Newly allocated circuit name.
+ * Test: unit test (test-gtasks.c: circuit_breaker).
+ */
+gchar*
+get_circuit_name( const gchar *url )
+{
+	const gchar *host;
+
+	host = strstr( url, "://" );
+	host = ( host != NULL ) ? host + strlen( "://" ) : url;
+
+	return( g_strndup( url, host + strcspn( host, "/?" ) - url ) );
+}
+
+
+
+/**
+ * Find the circuit of a URL, adding a closed circuit if it does not exist.
+ * @param breakers [in/out] Circuit breakers.
+ * @param url [in] URL of a request.
+ * @return The circuit.
+ */
+STATIC circuit_t*
+find_circuit( circuit_breakers_t *breakers, const gchar *url )
+{
+	gchar     *name;
+	circuit_t *circuit;
+
+	name = get_circuit_name( url );
+	circuit = g_hash_table_lookup( breakers->circuits, name );
+	if( circuit == NULL )
+	{
+		circuit = g_new0( circuit_t, 1 );
+		g_hash_table_insert( breakers->circuits, name, circuit );
+	}
+	else
+	{
+		g_free( name );
+	}
+
+	return( circuit );
+}
+
+
+
+/**
+ * Determine whether a request may be sent to a URL.  When an open circuit
+ * has been open long enough, it becomes half-open and lets the request
+ * through as a probe.  A half-open circuit lets no other requests through
+ * until the probe completes, or until it has been waited for as long as
+ * the circuit stays open, in case the probe was abandoned.
+ * @param breakers [in/out] Circuit breakers, or \a NULL.
+ * @param url [in] URL of the request.
+ * @param now [in] Current monotonic time.
+ * @return \a TRUE if the request may be sent, or \a FALSE if it should fail
+ *         without being sent.
+ * Test: unit test (test-gtasks.c: circuit_breaker).
+ */
+gboolean
+allow_circuit_request( circuit_breakers_t *breakers, const gchar *url,
+					   gint64 now )
+{
+	circuit_t *circuit;
+	gchar     *name;
+
+	if( breakers == NULL )
+	{
+		return( TRUE );
+	}
+	circuit = find_circuit( breakers, url );
+	if( circuit->state == CIRCUIT_CLOSED )
+	{
+		return( TRUE );
+	}
+	if( now - circuit->opened < breakers->open_time )
+	{
+		return( FALSE );
+	}
+
+	/* Send a probe. */
+	if( ( circuit->state == CIRCUIT_OPEN ) &&
+		( global_config.verbose == TRUE ) )
+	{
+		name = get_circuit_name( url );
+		printf( "Probing %s\n", name );
+		g_free( name );
+	}
+	circuit->state  = CIRCUIT_HALF_OPEN;
+	circuit->opened = now;
+	return( TRUE );
+}
+
+
+
+/**
+ * Update the circuit of a URL with the outcome of a request.  A success
+ * closes the circuit.  Transport errors and server errors count as
+ * failures, whereas other responses show that the server works.  A failed
+ * probe reopens the circuit, and so do consecutive failures that reach the
+ * threshold.
+ * @param breakers [in/out] Circuit breakers, or \a NULL.
+ * @param url [in] URL of the request.
+ * @param result [in] CURL result of the request.
+ * @param http_status [in] HTTP status of the response.
+ * @param now [in] Current monotonic time.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: circuit_breaker).
+ */
+void
+record_circuit_result( circuit_breakers_t *breakers, const gchar *url,
+					   CURLcode result, long http_status, gint64 now )
+{
+	circuit_t *circuit;
+	gchar     *name;
+
+	if( breakers == NULL )
+	{
+		return;
+	}
+	circuit = find_circuit( breakers, url );
+	if( ( result == CURLE_OK ) && ( http_status < 500 ) )
+	{
+		circuit->state    = CIRCUIT_CLOSED;
+		circuit->failures = 0;
+	}
+	else
+	{
+		circuit->failures++;
+		if( ( circuit->state == CIRCUIT_HALF_OPEN ) ||
+			( ( circuit->state == CIRCUIT_CLOSED ) &&
+			  ( circuit->failures >= breakers->threshold ) ) )
+		{
+			if( global_config.verbose == TRUE )
+			{
+				name = get_circuit_name( url );
+				printf( "%s failed %u times; failing its requests fast\n",
+						name, circuit->failures );
+				g_free( name );
+			}
+			circuit->state  = CIRCUIT_OPEN;
+			circuit->opened = now;
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/**
+ * \file circuitbreaker.h
+ * \brief Definitions for circuit breakers that fail requests fast.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_CIRCUITBREAKER_H
+#define __GTASKS_CIRCUITBREAKER_H
+
+#include <config.h>
+#include <glib.h>
+#include <curl/curl.h>
+
+
+/* States of a circuit:  requests pass through a closed circuit; an open
+   circuit fails them without sending them; a half-open circuit lets a
+   single probe request through, whose outcome closes or reopens the
+   circuit. */
+typedef enum
+{
+	CIRCUIT_CLOSED,
+	CIRCUIT_OPEN,
+	CIRCUIT_HALF_OPEN
+} circuit_state_t;
+
+/* The circuit of a server. */
+typedef struct
+{
+	circuit_state_t state;
+	/* Number of consecutive failures. */
+	guint           failures;
+	/* Monotonic time when the circuit was opened, or when the probe was
+	   sent while it is half-open. */
+	gint64          opened;
+} circuit_t;
+
+/* The circuit breakers of the servers that requests are sent to, keyed by
+   the scheme and host of the URL.  A circuit opens after \a threshold
+   consecutive failures and stays open for \a open_time microseconds before
+   it is probed. */
+typedef struct
+{
+	GHashTable *circuits;
+	guint      threshold;
+	gint64     open_time;
+} circuit_breakers_t;
+
+
+/*
+ * Create circuit breakers.
+ */
+circuit_breakers_t *create_circuit_breakers( guint threshold,
+											 gint64 open_time );
+
+/*
+ * Destroy circuit breakers.
+ */
+void destroy_circuit_breakers( circuit_breakers_t *breakers );
+
+/*
+ * Determine whether a request may be sent to a URL.
+ */
+gboolean allow_circuit_request( circuit_breakers_t *breakers,
+								const gchar *url, gint64 now );
+
+/*
+ * Update the circuit of a URL with the outcome of a request.
+ */
+void record_circuit_result( circuit_breakers_t *breakers, const gchar *url,
+							CURLcode result, long http_status, gint64 now );
+
+/*
+ * Get the name of the circuit that a URL belongs to.
+ */
+gchar *get_circuit_name( const gchar *url );
+
+
+#endif /* __GTASKS_CIRCUITBREAKER_H */
@@ -0,0 +1,87 @@
+/**
+ * \file compressbody.c
+ * \brief Gzip compression of request bodies.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <zlib.h>
+#include "gtasks2ical.h"
+#include "compressbody.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Window bits that make zlib write a gzip header and trailer instead of a
+   zlib header. */
+#define GZIP_WINDOW_BITS ( 15 + 16 )
+/* Memory level of the compressor, which is zlib's default. */
+#define GZIP_MEMORY_LEVEL 8
+
+
+
+/**
+ * Compress a request body with gzip in a single pass into a buffer that is
+ * large enough for the worst case.
+ * @param body [in] The request body.
+ * @param length [in] Length of the body in bytes.
+ * @param compressed_length [out] Length of the compressed body in bytes.
+ * @return Newly allocated compressed body, or \a NULL if the body could not
+ *         be compressed or would not become smaller.
+ * Test: unit test (test-gtasks.c: compress_request_body).
+ */
+gchar*
+compress_request_body( const gchar *body, gsize length,
+					   gsize *compressed_length )
+{
+	z_stream stream;
+	gsize    bound;
+	gchar    *compressed;
+	int      status;
+
+	memset( &stream, 0, sizeof( stream ) );
+	if( deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+					  GZIP_WINDOW_BITS, GZIP_MEMORY_LEVEL,
+					  Z_DEFAULT_STRATEGY ) != Z_OK )
+	{
+		return( NULL );
+	}
+	/* Leave room for the gzip header and trailer, which older versions of
+	   zlib do not include in the bound. */
+	bound      = deflateBound( &stream, length ) + 18;
+	compressed = g_malloc( bound );
+	stream.next_in   = (Bytef*) body;
+	stream.avail_in  = length;
+	stream.next_out  = (Bytef*) compressed;
+	stream.avail_out = bound;
+	status = deflate( &stream, Z_FINISH );
+	*compressed_length = stream.total_out;
+	deflateEnd( &stream );
+
+	if( ( status != Z_STREAM_END ) || ( *compressed_length >= length ) )
+	{
+		g_free( compressed );
+		compressed = NULL;
+	}
+
+	return( compressed );
+}
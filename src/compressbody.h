@@ -0,0 +1,37 @@
+/**
+ * \file compressbody.h
+ * \brief Definitions for gzip compression of request bodies.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_COMPRESSBODY_H
+#define __GTASKS_COMPRESSBODY_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/*
+ * Compress a request body with gzip.
+ */
+gchar *compress_request_body( const gchar *body, gsize length,
+							  gsize *compressed_length );
+
+
+#endif /* __GTASKS_COMPRESSBODY_H */
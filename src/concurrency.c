@@ -0,0 +1,185 @@
+/**
+ * \file concurrency.c
+ * \brief Adaptive control of the number of requests in flight.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gtasks2ical.h"
+#include "concurrency.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* The latency is considered to spike when the smoothed latency exceeds the
+   baseline by this factor. */
+#define LATENCY_SPIKE_FACTOR 2.0
+/* Weight of a new latency in the smoothed latency, and the fraction of the
+   difference to the smoothed latency by which the baseline drifts up with
+   each request. */
+#define LATENCY_SMOOTHING 0.2
+#define BASELINE_DRIFT    0.01
+
+
+
+/**
+ * Create a concurrency controller.  If the file holds a limit from an
+ * earlier run, the controller resumes from that limit.
+ * @param initial_limit [in] Limit if none has been kept.
+ * @param max_limit [in] Largest limit.
+ * @param file_name [in] File that keeps the limit between runs, or \a NULL.
+ * @return New concurrency controller.
+ * Test: unit test (test-gtasks.c: concurrency_limiter).
+ */
+concurrency_limiter_t*
+create_concurrency_limiter( guint initial_limit, guint max_limit,
+							const gchar *file_name )
+{
+	concurrency_limiter_t *limiter;
+	gchar                 *contents;
+	guint64               kept_limit;
+
+	limiter = g_new0( concurrency_limiter_t, 1 );
+	limiter->max_limit = MAX( max_limit, 1 );
+	limiter->limit     = CLAMP( initial_limit, 1, limiter->max_limit );
+	limiter->file_name = g_strdup( file_name );
+
+	if( ( file_name != NULL ) &&
+		( g_file_get_contents( file_name, &contents, NULL, NULL ) == TRUE ) )
+	{
+		kept_limit = g_ascii_strtoull( contents, NULL, 10 );
+		if( kept_limit > 0 )
+		{
+			limiter->limit = MIN( kept_limit, limiter->max_limit );
+		}
+		g_free( contents );
+	}
+
+	return( limiter );
+}
+
+
+
+/**
+ * Destroy a concurrency controller.  Its limit is written to its file, where
+ * the next run picks it up.
+ * @param limiter [out] The controller that is to be destroyed, or \a NULL.
+ * @return Nothing.
+ */
+void
+destroy_concurrency_limiter( concurrency_limiter_t *limiter )
+{
+	gchar *contents;
+
+	if( limiter != NULL )
+	{
+		if( limiter->file_name != NULL )
+		{
+			contents = g_strdup_printf( "%u\n",
+										get_concurrency_limit( limiter ) );
+			g_file_set_contents( limiter->file_name, contents, -1, NULL );
+			g_free( contents );
+		}
+		g_free( limiter->file_name );
+		g_free( limiter );
+	}
+}
+
+
+
+/**
+ * Get the number of requests that may be in flight.
+ * @param limiter [in] Concurrency controller.
+ * @return The limit, which is at least 1.
+ * Test: unit test (test-gtasks.c: concurrency_limiter).
+ */
+guint
+get_concurrency_limit( const concurrency_limiter_t *limiter )
+{
+	return( (guint) limiter->limit );
+}
+
+
+
+/**
+ * Adjust the limit to the outcome of a completed request.  The limit grows
+ * by the reciprocal of the limit for each request, i.e., by one request per
+ * window, unless the server was overloaded or the latency spiked, in which
+ * case the limit is halved unless it was already halved during the last
+ * round trip.
+ * @param limiter [in/out] Concurrency controller.
+ * @param latency [in] Latency of the request, or 0 if the request is not
+ *        comparable with the others, such as a batch request.
+ * @param overloaded [in] \a TRUE if the server refused the request for
+ *        exceeding the quota or the request timed out.
+ * @param now [in] Current monotonic time.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: concurrency_limiter).
+ */
+void
+record_concurrency_sample( concurrency_limiter_t *limiter, gint64 latency,
+						   gboolean overloaded, gint64 now )
+{
+	gboolean spike = FALSE;
+
+	if( latency > 0 )
+	{
+		if( ( limiter->baseline == 0.0 ) || ( latency < limiter->baseline ) )
+		{
+			limiter->baseline = latency;
+		}
+		else
+		{
+			limiter->baseline += ( limiter->smoothed - limiter->baseline ) *
+				BASELINE_DRIFT;
+		}
+		if( limiter->smoothed == 0.0 )
+		{
+			limiter->smoothed = latency;
+		}
+		else
+		{
+			limiter->smoothed += ( latency - limiter->smoothed ) *
+				LATENCY_SMOOTHING;
+		}
+		spike = limiter->smoothed > limiter->baseline * LATENCY_SPIKE_FACTOR;
+	}
+
+	if( ( overloaded == TRUE ) || ( spike == TRUE ) )
+	{
+		/* Requests that were in flight when the limit was halved report
+		   the same congestion, so wait a round trip before halving it
+		   again. */
+		if( ( limiter->decreased == 0 ) ||
+			( now - limiter->decreased >= (gint64) limiter->smoothed ) )
+		{
+			limiter->limit     = MAX( limiter->limit / 2.0, 1.0 );
+			limiter->decreased = now;
+		}
+	}
+	else
+	{
+		limiter->limit = MIN( limiter->limit + 1.0 / limiter->limit,
+							  (gdouble) limiter->max_limit );
+	}
+}
@@ -0,0 +1,77 @@
+/**
+ * \file concurrency.h
+ * \brief Definitions for adaptive request concurrency.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_CONCURRENCY_H
+#define __GTASKS_CONCURRENCY_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* An additive-increase/multiplicative-decrease controller for the number of
+   requests in flight.  The limit grows by one request per window of
+   completed requests while the latency stays flat, and is halved, at most
+   once per round trip, when the server refuses requests for exceeding the
+   quota or when the smoothed latency rises well above the lowest latency
+   seen.  Latencies and times are in microseconds. */
+typedef struct
+{
+	gdouble limit;
+	guint   max_limit;
+	/* Lowest latency, which drifts slowly towards the smoothed latency so
+	   that a lasting change in latency becomes the new baseline, and the
+	   exponentially smoothed latency. */
+	gdouble baseline;
+	gdouble smoothed;
+	/* Monotonic time when the limit was last decreased. */
+	gint64  decreased;
+	/* File that the limit is kept in between runs, or \a NULL. */
+	gchar   *file_name;
+} concurrency_limiter_t;
+
+
+/*
+ * Create a concurrency controller, resuming from the limit kept in a file.
+ */
+concurrency_limiter_t *create_concurrency_limiter( guint initial_limit,
+												   guint max_limit,
+												   const gchar *file_name );
+
+/*
+ * Destroy a concurrency controller, keeping its limit in its file.
+ */
+void destroy_concurrency_limiter( concurrency_limiter_t *limiter );
+
+/*
+ * Get the number of requests that may be in flight.
+ */
+guint get_concurrency_limit( const concurrency_limiter_t *limiter );
+
+/*
+ * Adjust the limit to the outcome of a completed request.
+ */
+void record_concurrency_sample( concurrency_limiter_t *limiter,
+								gint64 latency, gboolean overloaded,
+								gint64 now );
+
+
+#endif /* __GTASKS_CONCURRENCY_H */
@@ -28,6 +28,9 @@
 #include <libical/ical.h>
 #include "gtasks2ical.h"
 #include "postform.h"
+#include "session.h"
+#include "multirequest.h"
+#include "jsonstream.h"
 #include "gtasks.h"
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -35,153 +38,438 @@
 
 
 #define GOOGLE_TASKS_API "https://www.googleapis.com/tasks/v1/"
+#define GOOGLE_TASKS_BATCH_API "https://www.googleapis.com/batch/tasks/v1"
 
-struct tasks_page_t
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+STATIC gboolean pull_task_list( json_pull_t *pull, gpointer list_ptr );
+STATIC gboolean pull_task( json_pull_t *pull, gpointer task_ptr );
+STATIC gboolean pull_task_lists( json_pull_t *pull, gpointer lists_ptr );
+STATIC gboolean pull_task_page( json_pull_t *pull, gpointer page_ptr );
+STATIC void emit_task( struct tasks_page_t *tasks_page, gtask_t *task );
+
+
+/* The schemas of the Google Tasks resources, generated from their field
+   lists in gtasks.h. */
+#define SCHEMA_STRUCTURE gtask_list_t
+static const schema_field_t gtask_list_fields[ ] =
 {
-	GSList *tasks;
-	gchar  *next_page;
+	GTASK_LIST_FIELDS( DESCRIBE_SCHEMA_FIELD )
 };
+#undef SCHEMA_STRUCTURE
+record_schema_t gtask_list_schema =
+	RECORD_SCHEMA( gtask_list_t, gtask_list_fields );
 
+#define SCHEMA_STRUCTURE gtask_link_t
+static const schema_field_t gtask_link_fields[ ] =
+{
+	GTASK_LINK_FIELDS( DESCRIBE_SCHEMA_FIELD )
+};
+#undef SCHEMA_STRUCTURE
+record_schema_t gtask_link_schema =
+	RECORD_SCHEMA( gtask_link_t, gtask_link_fields );
 
-/* Global configuration data. */
-extern struct configuration_t global_config;
+#define SCHEMA_STRUCTURE gtask_t
+static const schema_field_t gtask_fields[ ] =
+{
+	GTASK_FIELDS( DESCRIBE_SCHEMA_FIELD )
+};
+#undef SCHEMA_STRUCTURE
+record_schema_t gtask_schema = RECORD_SCHEMA( gtask_t, gtask_fields );
 
 
 
 /**
- * Submit a request to the Google Tasks API, optionally with body data.
- * NOTE:  body data is currently ignored.
- * @param curl [in] CURL handle.
- * @param method [in] HTTP method (POST, GET, etc...).
- * @param rest_uri [in] API URI (e.g., "users/@me/lists").
- * @param access_token [in] The applications authorizaton token.
- * @param body [in] Body message to include in the request, or \a NULL if no
- *        body content should be submitted.
- * @param curl_headers [in] Any CURL headers that may need to be submitted.
- * @return JSON response from the Google Tasks API.
+ * Determine whether the configuration asks to leave out a member from the
+ * responses.  A member with sub-selections, such as "links(type)", is
+ * identified by the name before the parenthesis.
+ * @param field [in] Field selector of the member.
+ * @return \a TRUE if the member is left out, or \a FALSE otherwise.
  */
-STATIC gchar*
-send_gtasks_data( CURL *curl, const gchar *method, const gchar *rest_uri,
-				  const gchar *access_token,
-				  const gchar *body, struct curl_slist *curl_headers )
+STATIC gboolean
+is_field_omitted( const gchar *field )
 {
-	gchar                      *authorization;
-	gchar                      *url;
-	struct curl_write_buffer_t html_response = { .data = NULL, .size = 0 };
-
-
-	authorization = g_strconcat( "Authorization: Bearer ",
-								 access_token, NULL );
-	curl_headers = curl_slist_append( curl_headers,
-									  "Accept: application/json" );
-	curl_headers = curl_slist_append( curl_headers, authorization );
-
-//	curl_easy_setopt( curl, CURLOPT_VERBOSE, 1 );
-	if( global_config.ipv4_only == TRUE )
-	{
-		curl_easy_setopt( curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4 );
-	}
-	curl_easy_setopt( curl, CURLOPT_CUSTOMREQUEST, method );
-	curl_easy_setopt( curl, CURLOPT_HTTPHEADER, curl_headers );
-	/* Assume redirections. */
-	curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1 );
-	curl_easy_setopt( curl, CURLOPT_UNRESTRICTED_AUTH, 1 );
-	/* Set the URL. */
-	url = g_strconcat( GOOGLE_TASKS_API, rest_uri, NULL );
-	curl_easy_setopt( curl, CURLOPT_URL, url );
-	/* Send the request, receiving the response in html_response. */
-	curl_easy_setopt( curl, CURLOPT_WRITEDATA, &html_response );
-	curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, receive_curl_response );
-	curl_easy_setopt( curl, CURLOPT_HEADERDATA, NULL );
-	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, NULL );
-	curl_easy_perform( curl );
+	gsize       name_length;
+	gchar *const *omitted;
 
-	g_free( url );
-	g_free( authorization );
-	curl_slist_free_all( curl_headers );
-	curl_easy_reset( curl );
+	if( global_config.omitted_fields == NULL )
+	{
+		return( FALSE );
+	}
+	name_length = strcspn( field, "(" );
+	for( omitted = global_config.omitted_fields; *omitted != NULL; omitted++ )
+	{
+		if( ( strlen( *omitted ) == name_length ) &&
+			( strncmp( *omitted, field, name_length ) == 0 ) )
+		{
+			return( TRUE );
+		}
+	}
 
-	return( html_response.data );
+	return( FALSE );
 }
 
 
 
 /**
- * Callback function that copies the attributes of a task list into a "lists"
- * container.
- * @param member_name [in] Name of the attribute.
- * @param member_node [in] Node that contains the attribute.
- * @param data_ptr [out] Pointer to a list element.
+ * Append a comma-separated list of the members in a schema to a field mask,
+ * leaving out the members that the configuration omits.  The "id" member is
+ * always included, and the members of the records in an array are selected
+ * in parentheses after the array's name.
+ * @param mask [in/out] Field mask.
+ * @param schema [in] Schema of the resource.
+ * @param omit [in] \a TRUE if the configuration's omitted members are left
+ *        out, or \a FALSE if all members are selected.
  * @return Nothing.
-*/
+ */
 STATIC void
-copy_list_name_values( const gchar *member_name, JsonNode *member_node,
-					   gpointer data_ptr )
+append_fields( GString *mask, const record_schema_t *schema, gboolean omit )
 {
-	gtask_list_t *list = data_ptr;
-	const gchar  *date_string;
-	GTimeVal     updated_time;
+	gboolean             first = TRUE;
+	guint                idx;
+	const schema_field_t *field;
 
-	SET_JSON_MEMBER( list, id );
-	SET_JSON_MEMBER( list, title );
-	/* Create a timestamp version of the "updated" value. */
-	if( g_strcmp0( member_name, "updated" ) == 0 )
+	for( idx = 0; idx < schema->field_count; idx++ )
 	{
-		date_string = json_node_get_string( member_node );
-		g_time_val_from_iso8601( date_string, &updated_time );
-		list->updated = g_date_time_new_from_timeval_local( &updated_time );
+		field = &schema->fields[ idx ];
+		if( ( field->name != NULL ) &&
+			( ( omit == FALSE ) || ( g_strcmp0( field->name, "id" ) == 0 ) ||
+			  ( is_field_omitted( field->name ) == FALSE ) ) )
+		{
+			if( first == FALSE )
+			{
+				g_string_append_c( mask, ',' );
+			}
+			g_string_append( mask, field->name );
+			if( field->type == FIELD_RECORDS )
+			{
+				g_string_append_c( mask, '(' );
+				append_fields( mask, field->element, FALSE );
+				g_string_append_c( mask, ')' );
+			}
+			first = FALSE;
+		}
 	}
 }
 
 
 
 /**
- * Callback function that walks through the elements of a list member.
- * @param items [in] Not used.
- * @param index [in] Not used.
- * @param node [in] Node containing the array.
- * @param data_ptr [in] Pointer to the "lists" list that should be populated.
- * @return Nothing.
+ * Build the partial-response field mask for a pull decoder, which selects
+ * only the members that the decoder copies.
+ * @param pull_decoder [in] Pull decoder for the response.
+ * @return Newly allocated field mask, or \a NULL if the decoder has no known
+ *         set of members.
+ * Test: unit test (test-gtasks.c: build_fields_mask).
  */
-STATIC void
-copy_list_name( JsonArray *items, guint index, JsonNode *node,
-				gpointer data_ptr )
+STATIC gchar*
+build_fields_mask( json_pull_decoder pull_decoder )
 {
-	GSList                **lists = data_ptr;
-	gtask_list_t          *list_entry;
-	JsonObject            *root;
-	struct json_wrapper_t json_wrapper;
+	GString *mask = g_string_new( NULL );
 
-	list_entry = g_new0( gtask_list_t, 1 );
-	/* Copy the list name attributes into the list entry. */
-	root = json_node_get_object( node );
-	json_wrapper.function = copy_list_name_values;
-	json_wrapper.data     = list_entry;
-	json_object_foreach_member( root, decode_json_foreach_wrapper,
-								&json_wrapper );
-	/* Add the list name. */
-	*lists = g_slist_append( *lists, list_entry );
+	if( pull_decoder == pull_task )
+	{
+		append_fields( mask, &gtask_schema, TRUE );
+	}
+	else if( pull_decoder == pull_task_page )
+	{
+		g_string_append( mask, "nextPageToken,items(" );
+		append_fields( mask, &gtask_schema, TRUE );
+		g_string_append_c( mask, ')' );
+	}
+	else if( pull_decoder == pull_task_list )
+	{
+		append_fields( mask, &gtask_list_schema, TRUE );
+	}
+	else if( pull_decoder == pull_task_lists )
+	{
+		g_string_append( mask, "items(" );
+		append_fields( mask, &gtask_list_schema, TRUE );
+		g_string_append_c( mask, ')' );
+	}
+	else
+	{
+		g_string_free( mask, TRUE );
+		return( NULL );
+	}
+
+	return( g_string_free( mask, FALSE ) );
 }
 
 
 
 /**
- * Callback function that extracts the array from a task lists JSON reply.
- * @param name [in] Name of the current node.
- * @param node [in] Node containing the top-level JSON reply members.
- * @param data_ptr [out] Pointer to the "lists" list that should be populated.
- * @return Nothing.
+ * Pull decoder for a task list resource.
+ * @param pull [in/out] Pull parser.
+ * @param list_ptr [out] Pointer to the task list.
+ * @return \a TRUE if the task list was decoded, or \a FALSE otherwise.
  */
-STATIC void
-decode_tasklists_json( const gchar *name, JsonNode *node, gpointer data_ptr )
+STATIC gboolean
+pull_task_list( json_pull_t *pull, gpointer list_ptr )
+{
+	return( pull_schema_record( pull, &gtask_list_schema, list_ptr ) );
+}
+
+
+
+/**
+ * Pull decoder for a task resource.
+ * @param pull [in/out] Pull parser.
+ * @param task_ptr [out] Pointer to the task.
+ * @return \a TRUE if the task was decoded, or \a FALSE otherwise.
+ */
+STATIC gboolean
+pull_task( json_pull_t *pull, gpointer task_ptr )
+{
+	return( pull_schema_record( pull, &gtask_schema, task_ptr ) );
+}
+
+
+
+/**
+ * Pull decoder for the user's task lists, which adds the task lists in the
+ * "items" array to a list.
+ * @param pull [in/out] Pull parser.
+ * @param lists_ptr [out] Pointer to the "lists" list that is populated.
+ * @return \a TRUE if the task lists were decoded, or \a FALSE otherwise.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+STATIC gboolean
+pull_task_lists( json_pull_t *pull, gpointer lists_ptr )
+{
+	GSList       **lists = lists_ptr;
+	json_token_t token;
+	json_token_t value;
+	gtask_list_t *list_entry;
+
+	if( next_json_token( pull, &token ) != JSON_TOKEN_OBJECT_BEGIN )
+	{
+		return( FALSE );
+	}
+	while( next_json_token( pull, &token ) == JSON_TOKEN_STRING )
+	{
+		next_json_token( pull, &value );
+		if( is_json_key( &token, "items" ) &&
+			( value.type == JSON_TOKEN_ARRAY_BEGIN ) )
+		{
+			while( next_json_token( pull, &value ) ==
+				   JSON_TOKEN_OBJECT_BEGIN )
+			{
+				list_entry = g_new0( gtask_list_t, 1 );
+				if( pull_schema_members( pull, &gtask_list_schema,
+										 list_entry ) == FALSE )
+				{
+					destroy_schema_record( &gtask_list_schema, list_entry );
+					return( FALSE );
+				}
+				*lists = g_slist_append( *lists, list_entry );
+			}
+		}
+		else if( skip_json_value( pull, &value ) == FALSE )
+		{
+			return( FALSE );
+		}
+	}
+
+	return( token.type == JSON_TOKEN_OBJECT_END );
+}
+
+
+
+/**
+ * Pull decoder for a page of tasks, which stores the "next page" token and
+ * hands each task in the "items" array to the page as soon as it has been
+ * decoded.
+ * @param pull [in/out] Pull parser.
+ * @param page_ptr [out] Pointer to page and tasks container.
+ * @return \a TRUE if the page was decoded, or \a FALSE otherwise.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+STATIC gboolean
+pull_task_page( json_pull_t *pull, gpointer page_ptr )
+{
+	struct tasks_page_t *tasks_page = page_ptr;
+	json_token_t        token;
+	json_token_t        value;
+	gtask_t             *task;
+
+	if( next_json_token( pull, &token ) != JSON_TOKEN_OBJECT_BEGIN )
+	{
+		return( FALSE );
+	}
+	while( next_json_token( pull, &token ) == JSON_TOKEN_STRING )
+	{
+		next_json_token( pull, &value );
+		if( is_json_key( &token, "nextPageToken" ) &&
+			( value.type == JSON_TOKEN_STRING ) )
+		{
+			g_free( tasks_page->next_page );
+			tasks_page->next_page = dup_json_string( &value );
+		}
+		else if( is_json_key( &token, "items" ) &&
+				 ( value.type == JSON_TOKEN_ARRAY_BEGIN ) )
+		{
+			while( next_json_token( pull, &value ) ==
+				   JSON_TOKEN_OBJECT_BEGIN )
+			{
+				/* A task that is cut short is dropped. */
+				task = g_new0( gtask_t, 1 );
+				if( pull_schema_members( pull, &gtask_schema, task ) == FALSE )
+				{
+					destroy_schema_record( &gtask_schema, task );
+					return( FALSE );
+				}
+				emit_task( tasks_page, task );
+			}
+		}
+		else if( skip_json_value( pull, &value ) == FALSE )
+		{
+			return( FALSE );
+		}
+	}
+
+	return( token.type == JSON_TOKEN_OBJECT_END );
+}
+
+
+
+/**
+ * Queue a request to the Google Tasks API, optionally with body data, on the
+ * session's request engine.
+ * @param session [in/out] Session for the request.
+ * @param method [in] HTTP method (POST, GET, etc...).
+ * @param rest_uri [in] API URI (e.g., "users/@me/lists").
+ * @param access_token [in] The applications authorizaton token.
+ * @param body [in] Body message to include in the request, or \a NULL if no
+ *        body content should be submitted.
+ * @param curl_headers [in] Any CURL headers that may need to be submitted,
+ *        or \a NULL to submit only the session's API headers.
+ * @param pull_decoder [in] Pull decoder for the JSON response, or \a NULL if
+ *        the response is not decoded.
+ * @param decoder_data [out] User data for the decoder.
+ * @return The submitted request.
+ */
+STATIC api_request_t*
+submit_gtasks_request( gtasks_session_t *session, const gchar *method,
+					   const gchar *rest_uri, const gchar *access_token,
+					   const gchar *body, struct curl_slist *curl_headers,
+					   json_pull_decoder pull_decoder,
+					   gpointer decoder_data )
+{
+	gchar             *authorization;
+	gchar             *url;
+	gchar             *fields;
+	struct curl_slist *headers;
+	api_request_t     *request;
+
+	/* Reuse the session's API headers unless the caller adds its own. */
+	if( curl_headers == NULL )
+	{
+		headers = get_session_api_headers( session, access_token );
+	}
+	else
+	{
+		authorization = g_strconcat( "Authorization: Bearer ",
+									 access_token, NULL );
+		curl_headers = curl_slist_append( curl_headers,
+										  "Accept: application/json" );
+		curl_headers = curl_slist_append( curl_headers, authorization );
+		g_free( authorization );
+		headers = curl_headers;
+	}
+	/* Set the URL and queue the request.  Ask only for the members that
+	   the decoder uses. */
+	fields = NULL;
+	if( ( global_config.partial_responses == TRUE ) &&
+		( g_strcmp0( method, "GET" ) == 0 ) )
+	{
+		fields = build_fields_mask( pull_decoder );
+	}
+	if( fields != NULL )
+	{
+		url = g_strconcat( GOOGLE_TASKS_API, rest_uri,
+						   strchr( rest_uri, '?' ) == NULL ? "?" : "&",
+						   "fields=", fields, NULL );
+		g_free( fields );
+	}
+	else
+	{
+		url = g_strconcat( GOOGLE_TASKS_API, rest_uri, NULL );
+	}
+	request = submit_api_request( session->engine, method, url, headers, body,
+								  NULL, decoder_data );
+	request->own_headers = curl_headers;
+	/* Decode the Tasks API resources without building a JSON tree. */
+	pull_api_request( request, pull_decoder );
+	/* Requests with the session's API headers may share a batch request. */
+	if( curl_headers == NULL )
+	{
+		request->batch_url = GOOGLE_TASKS_BATCH_API;
+	}
+	g_free( url );
+
+	return( request );
+}
+
+
+
+/**
+ * Submit a request to the Google Tasks API, optionally with body data, and
+ * decode the response.
+ * @param session [in/out] Session for the request.
+ * @param method [in] HTTP method (POST, GET, etc...).
+ * @param rest_uri [in] API URI (e.g., "users/@me/lists").
+ * @param access_token [in] The applications authorizaton token.
+ * @param body [in] Body message to include in the request, or \a NULL if no
+ *        body content should be submitted.
+ * @param curl_headers [in] Any CURL headers that may need to be submitted,
+ *        or \a NULL to submit only the session's API headers.
+ * @param pull_decoder [in] Pull decoder for the JSON response, or \a NULL if
+ *        the response is not decoded.
+ * @param decoder_data [out] User data for the decoder.
+ * @return \a TRUE if a successful response was received and decoded, or
+ *         \a FALSE if the request failed, even after it was repeated.
+ */
+STATIC gboolean
+send_gtasks_data( gtasks_session_t *session, const gchar *method,
+				  const gchar *rest_uri, const gchar *access_token,
+				  const gchar *body, struct curl_slist *curl_headers,
+				  json_pull_decoder pull_decoder, gpointer decoder_data )
+{
+	api_request_t *request;
+	gboolean      success;
+
+	request = submit_gtasks_request( session, method, rest_uri, access_token,
+									 body, curl_headers,
+									 pull_decoder, decoder_data );
+	wait_for_api_request( session->engine, request );
+	success = request->answered;
+	if( ( success == FALSE ) && ( global_config.verbose == TRUE ) )
+	{
+		printf( "Request for %s failed (HTTP status %ld)\n", rest_uri,
+				request->http_status );
+	}
+	destroy_api_request( request );
+
+	return( success );
+}
+
+
+
+void
+debug_show_gtimeval( gint64 t )
 {
-	GSList    **lists = data_ptr;
-	JsonArray *items;
+	GDateTime *time = timestamp_to_date_time( t );
+	gchar     *formatted;
 
-	if( g_strcmp0( name, "items" ) == 0 )
+	if( time != NULL )
 	{
-		items = json_node_get_array( node );
-		json_array_foreach_element( items, copy_list_name, lists );
+		formatted = g_date_time_format( time, "%F %R:%S %Z" );
+		g_printf( "%s", formatted );
+		g_free( formatted );
+		g_date_time_unref( time );
 	}
 }
 
@@ -193,27 +481,25 @@ debug_show_list( gpointer data, gpointer user_data )
 	gtask_list_t *list = data;
 	g_printf( "LIST: %s\n", list->title );
 	g_printf( "  id = %s\n", list->id );
-	g_printf( "  updated = %s\n", g_date_time_format( list->updated, "%F %R:%S %Z" ) );
+	g_printf( "  updated = " ); debug_show_gtimeval( list->updated );
+	    g_printf( "\n" );
 }
 
 
 
 /**
  * Read the user's task lists.
- * @param curl [in] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param access_token [in] Access token for the user's Google data.
  * @return List of task list names.
  */
 GSList*
-get_gtasks_lists( CURL *curl, const gchar *access_token )
+get_gtasks_lists( gtasks_session_t *session, const gchar *access_token )
 {
-	GSList            *lists = NULL;
-	struct curl_slist *curl_headers = NULL;
-	gchar             *json_response;
+	GSList *lists = NULL;
 
-	json_response = send_gtasks_data( curl, "GET", "users/@me/lists",
-									  access_token, NULL, NULL );
-	decode_json_reply( json_response, decode_tasklists_json, &lists );
+	send_gtasks_data( session, "GET", "users/@me/lists",
+					  access_token, NULL, NULL, pull_task_lists, &lists );
 /*
 	g_slist_foreach( lists, debug_show_list, NULL );
 */
@@ -225,36 +511,33 @@ get_gtasks_lists( CURL *curl, const gchar *access_token )
 
 /**
  * Get information about a specified task list.
- * @param curl [in] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param access_token [in] Access token for the user's Google data.
  * @param task_list_id [in] ID of the task list.
  * @return Information about the task list.
  */
 gtask_list_t*
-get_specified_gtasks_list( CURL *curl, const gchar *access_token,
+get_specified_gtasks_list( gtasks_session_t *session,
+						   const gchar *access_token,
 						   const char *task_list_id )
 {
-	gchar             *uri;
-	struct curl_slist *curl_headers = NULL;
-	gchar             *json_response;
-	gtask_list_t      *list_entry;
+	gchar        *uri;
+	gtask_list_t *list_entry;
 
-	/* Request information about the specified list. */
+	/* Request information about the specified list, copying the list name
+	   attributes into the list entry. */
 	uri = g_strconcat( "users/@me/lists/", task_list_id, NULL );
-	json_response = send_gtasks_data( curl, "GET", uri,
-									  access_token, NULL, NULL );
-	g_free( uri );
-	/* Copy the list name attributes into the list entry. */
 	list_entry = g_new0( gtask_list_t, 1 );
-	decode_json_reply( json_response, copy_list_name_values, list_entry );
+	send_gtasks_data( session, "GET", uri, access_token, NULL, NULL,
+					  pull_task_list, list_entry );
+	g_free( uri );
 /*
 	debug_show_list( list_entry, NULL );
 */
 	/* Return zero if an error occurred. */
 	if( list_entry->title == NULL )
 	{
-		g_free( list_entry->id );
-		g_free( list_entry );
+		destroy_schema_record( &gtask_list_schema, list_entry );
 		list_entry = NULL;
 	}
 	return( list_entry );
@@ -263,192 +546,106 @@ get_specified_gtasks_list( CURL *curl, const gchar *access_token,
 
 
 /**
- * Copy the link type, description, and target to a link entry.
- * @param member_name [in] Either "type," "description," or "link."
- * @param member_node [in] The attribute value for the above type.
- * @param data_ptr [in] Pointer to the destination where the attributes are
- *        copied to.
- * @return Nothing.
+ * Get information about several task lists.  The requests for all the lists
+ * are in flight at the same time.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_ids [in] List of task list IDs.
+ * @return Information about the task lists that could be read, in the same
+ *         order as the IDs.
  */
-STATIC void
-copy_link_attributes( const gchar *member_name, JsonNode *member_node,
-					  gpointer data_ptr )
+GSList*
+get_specified_gtasks_lists( gtasks_session_t *session,
+							const gchar *access_token,
+							const GSList *task_list_ids )
 {
-	gtask_link_t *link = data_ptr;
-
-	g_printf( "DEBUG: copy_link_attributes\n" );
-
-	SET_JSON_MEMBER( link, type );
-	SET_JSON_MEMBER( link, description );
-	SET_JSON_MEMBER( link, link );
-}
-
-
+	const GSList  *id;
+	gchar         *uri;
+	gtask_list_t  *list_entry;
+	GSList        *requests = NULL;
+	GSList        *lists    = NULL;
+	GSList        *submitted;
+	api_request_t *request;
+
+	/* Submit a request for each list. */
+	for( id = task_list_ids; id != NULL; id = id->next )
+	{
+		uri = g_strconcat( "users/@me/lists/", (const gchar*) id->data, NULL );
+		list_entry = g_new0( gtask_list_t, 1 );
+		request = submit_gtasks_request( session, "GET", uri, access_token,
+										 NULL, NULL, pull_task_list,
+										 list_entry );
+		g_free( uri );
+		requests = g_slist_append( requests, request );
+	}
+	/* The responses are decoded into the list entries as they arrive.  Keep
+	   only the lists that were read successfully. */
+	for( submitted = requests; submitted != NULL;
+		 submitted = submitted->next )
+	{
+		request = submitted->data;
+		wait_for_api_request( session->engine, request );
+		list_entry = request->decoder_data;
+		if( ( request->answered == FALSE ) || ( list_entry->title == NULL ) )
+		{
+			destroy_schema_record( &gtask_list_schema, list_entry );
+		}
+		else
+		{
+			lists = g_slist_append( lists, list_entry );
+		}
+		destroy_api_request( request );
+	}
+	g_slist_free( requests );
 
-/**
- * Copy all the Google Tasks links to a linked list.
- * @param links [in] Array of links decoded from the Google Tasks JSON reply.
- * @param index [in] Unused.
- * @param node [in] The node with the link attributes.
- * @param data_ptr [in] Pointer the destination list where the links are
- *        inserted.
- * @return Nothing.
- */
-STATIC void
-copy_link( JsonArray *links, guint index, JsonNode *node, gpointer data_ptr )
-{
-	GSList                **link_list = data_ptr;
-	JsonObject            *root;
-	struct json_wrapper_t json_wrapper;
-	gtask_link_t          *link;
-
-	g_printf( "DEBUG: copy_link\n" );
-
-	/* Copy the task attributes into the task. */
-	link = g_new0( gtask_link_t, 1 );
-	json_wrapper.function = copy_link_attributes;
-	json_wrapper.data     = link;
-	root = json_node_get_object( node );
-	json_object_foreach_member( root, decode_json_foreach_wrapper,
-								&json_wrapper );
-	*link_list = g_slist_append( *link_list, link );
+	return( lists );
 }
 
 
 
 /**
- * Callback function that assigns values to the task attributes.
- * @param name [in] Name of the current node.
- * @param node [in] Current node.
- * @param page_ptr [out] Pointer to tasks structure.
+ * Hand a decoded task to the page's task handler, or add it to the page's
+ * tasks list if the page has no handler.
+ * @param tasks_page [in/out] Page that the task belongs to.
+ * @param task [in] The decoded task.
  * @return Nothing.
- * Test: manual.
  */
 STATIC void
-copy_task_values( const gchar *member_name, JsonNode *member_node,
-				  gpointer data_ptr )
+emit_task( struct tasks_page_t *tasks_page, gtask_t *task )
 {
-	gtask_t     *task = data_ptr;
-	const gchar *date_string;
-	JsonArray   *links;
-	GTimeVal    timeval;
-
-	SET_JSON_MEMBER( task, id );
-	SET_JSON_MEMBER( task, etag );
-	SET_JSON_MEMBER( task, title );
-	SET_JSON_MEMBER( task, parent );
-	SET_JSON_MEMBER( task, notes );
-	SET_JSON_MEMBER( task, status );
-	if( g_strcmp0( member_name, "updated" ) == 0 )
-	{
-		date_string = json_node_get_string( member_node );
-		g_time_val_from_iso8601( date_string, &timeval );
-		task->updated = g_date_time_new_from_timeval_local( &timeval );
-	}
-	else if( g_strcmp0( member_name, "selfLink" ) == 0 )
-	{
-		task->self_link = json_node_dup_string( member_node );
-	}
-	else if( g_strcmp0( member_name, "position" ) == 0 )
-	{
-		task->position = json_node_dup_string( member_node );
-	}
-	else if( g_strcmp0( member_name, "due" ) == 0 )
-	{
-		date_string = json_node_get_string( member_node );
-		g_time_val_from_iso8601( date_string, &timeval );
-		task->due = g_date_time_new_from_timeval_local( &timeval );
-	}
-	else if( g_strcmp0( member_name, "completed" ) == 0 )
-	{
-		date_string = json_node_get_string( member_node );
-		g_time_val_from_iso8601( date_string, &timeval );
-		task->completed = g_date_time_new_from_timeval_local( &timeval );
-	}
-	else if( g_strcmp0( member_name, "deleted" ) == 0 )
+	if( tasks_page->handler != NULL )
 	{
-		task->deleted = json_node_get_boolean( member_node );
+		tasks_page->handler( task, tasks_page->handler_data );
 	}
-	else if( g_strcmp0( member_name, "hidden" ) == 0 )
-	{
-		task->hidden = json_node_get_boolean( member_node );
-	}
-	else if( g_strcmp0( member_name, "links" ) == 0 )
+	else
 	{
-		links = json_node_get_array( member_node );
-		json_array_foreach_element( links, copy_link, &task->links );
+		tasks_page->tasks = g_slist_append( tasks_page->tasks, task );
 	}
 }
 
 
 
 /**
- * Callback function that walks through an array of task attributes to compile
- * a task.
- * @param items [in] Not used.
- * @param index [in] Not used.
- * @param node [in] Node containing the array.
- * @param data_ptr [in] Pointer to the task container that should be populated.
- * @return Nothing.
- * Test: manual.
- */
-STATIC void
-copy_task( JsonArray *items, guint index, JsonNode *node, gpointer data_ptr )
-{
-	struct tasks_page_t   *tasks_page = data_ptr;
-	JsonObject            *root;
-	struct json_wrapper_t json_wrapper;
-	gtask_t               *task;
-
-	/* Copy the task attributes into the task. */
-	task = g_new0( gtask_t, 1 );
-	json_wrapper.function = copy_task_values;
-	json_wrapper.data     = task;
-	root = json_node_get_object( node );
-	json_object_foreach_member( root, decode_json_foreach_wrapper,
-								&json_wrapper );
-	tasks_page->tasks = g_slist_append( tasks_page->tasks, task );
-}
-
-
-
-/**
- * Decode the "next page" token and the tasks in the current list.
- * @param name [in] Name of the current node.
- * @param node [in] Current node.
- * @param page_ptr [out] Pointer to page and tasks container.
+ * Decode a task from a task page while the page is being received.
+ * @param element [in] JSON object with the task attributes.
+ * @param length [in] Length of the JSON object.
+ * @param page_ptr [in/out] Pointer to the page that the task belongs to.
  * @return Nothing.
  * Test: manual.
  */
 STATIC void
-decode_task_page( const gchar *name, JsonNode *node, gpointer page_ptr )
+stream_task( const gchar *element, gsize length, gpointer page_ptr )
 {
 	struct tasks_page_t *tasks_page = page_ptr;
-	JsonArray           *items;
 	gtask_t             *task;
 
-	/* Store the "next page" token. */
-	if( g_strcmp0( name, "nextPageToken" ) == 0 )
-	{
-		tasks_page->next_page = json_node_dup_string( node );
-	}
-	/* The items array is an array of tasks. */
-	else if( g_strcmp0( name, "items" ) == 0 )
-	{
-		items = json_node_get_array( node );
-		json_array_foreach_element( items, copy_task, tasks_page );
-	}
+	task = g_new0( gtask_t, 1 );
+	decode_json_pull( element, length, tasks_page->strings, pull_task, task );
+	emit_task( tasks_page, task );
 }
 
 
 
-
-void
-debug_show_gtimeval( GDateTime *t )
-{
-	g_printf( "%s", g_date_time_format( t, "%F %R:%S %Z" ) );
-}
-
 void
 debug_show_task( gpointer task_ptr, gpointer data )
 {
@@ -480,25 +677,17 @@ debug_show_tasks( GSList *tasks )
 
 
 /**
- * Read all tasks for a particular task list.
- * @param curl [in] CURL handle.
- * @param access_token [in] Access token for the user's Google data.
+ * Build the API URI for a page of tasks in a task list.
  * @param task_list_id [in] ID of the task list.
- * @param page_token [in] Page token for requesting the next round of tasks.
- * @return Information about the task list.
- * Test: manual.
+ * @param page_token [in] Page token for requesting the next round of tasks,
+ *        or \a NULL for the first page.
+ * @return Newly allocated URI.
  */
-GSList*
-get_all_list_tasks( CURL *curl, const gchar *access_token,
-					const gchar *task_list_id, const gchar *page_token )
+STATIC gchar*
+build_task_page_uri( const gchar *task_list_id, const gchar *page_token )
 {
-	gchar               *uri;
-	gchar               *page;
-	struct curl_slist   *curl_headers = NULL;
-	gchar               *json_response;
-	struct tasks_page_t tasks_page = { NULL, NULL };
-	GSList              *tasks;
-	GSList              *tasks_to_append;
+	gchar *page;
+	gchar *uri;
 
 	/* Indicate which page is requested. */
 	if( page_token != NULL )
@@ -512,30 +701,203 @@ get_all_list_tasks( CURL *curl, const gchar *access_token,
 	/* Specify the list in the URI. */
 	uri = g_strconcat( "lists/", task_list_id, "/tasks", page, NULL );
 	g_free( page );
-	/* Request the tasks. */
-	json_response = send_gtasks_data( curl, "GET", uri,
-									  access_token, NULL, NULL );
+
+	return( uri );
+}
+
+
+
+/**
+ * Submit a request for a page of tasks.  Unless streaming is disabled, the
+ * tasks are decoded one by one while the page is received.
+ * @param session [in/out] Session for the request.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_id [in] ID of the task list.
+ * @param page_token [in] Page token, or \a NULL for the first page.
+ * @param tasks_page [out] Page that receives the tasks and the next-page
+ *        token.
+ * @return The submitted request.
+ */
+STATIC api_request_t*
+submit_task_page_request( gtasks_session_t *session,
+						  const gchar *access_token,
+						  const gchar *task_list_id, const gchar *page_token,
+						  struct tasks_page_t *tasks_page )
+{
+	gchar         *uri;
+	api_request_t *request;
+
+	uri = build_task_page_uri( task_list_id, page_token );
+	request = submit_gtasks_request( session, "GET", uri, access_token,
+									 NULL, NULL, pull_task_page,
+									 tasks_page );
 	g_free( uri );
+	if( global_config.streaming_json == TRUE )
+	{
+		stream_api_request( request, "items", stream_task, tasks_page );
+	}
+
+	return( request );
+}
+
+
+
+/**
+ * Read the pages of a task list one after another, starting with a
+ * specified page.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_id [in] ID of the task list.
+ * @param page_token [in] Page token of the first page to read, or \a NULL.
+ * @param tasks_page [out] Page that receives the tasks.
+ * @return Nothing.
+ */
+STATIC void
+read_task_pages( gtasks_session_t *session, const gchar *access_token,
+				 const gchar *task_list_id, const gchar *page_token,
+				 struct tasks_page_t *tasks_page )
+{
+	gchar         *next_page;
+	api_request_t *request;
+
+	next_page = g_strdup( page_token );
+	do
+	{
+		request = submit_task_page_request( session, access_token,
+											task_list_id, next_page,
+											tasks_page );
+		g_free( next_page );
+		wait_for_api_request( session->engine, request );
+		destroy_api_request( request );
+		/* Continue with the next page, if there is one. */
+		next_page = tasks_page->next_page;
+		tasks_page->next_page = NULL;
+	} while( next_page != NULL );
+}
+
+
+
+/**
+ * Read all tasks for a particular task list.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_id [in] ID of the task list.
+ * @param page_token [in] Page token for requesting the next round of tasks.
+ * @return Information about the task list.
+ * Test: manual.
+ */
+GSList*
+get_all_list_tasks( gtasks_session_t *session, const gchar *access_token,
+					const gchar *task_list_id, const gchar *page_token )
+{
+	struct tasks_page_t tasks_page = { NULL, NULL, NULL, NULL,
+									   session->strings };
+
+	/* Request the tasks page by page, appending the tasks of each page to
+	   our growing grande list o' tasks. */
+	read_task_pages( session, access_token, task_list_id, page_token,
+					 &tasks_page );
+
+//	debug_show_tasks( tasks_page.tasks );
+
+	return( tasks_page.tasks );
+}
+
+
+
+/**
+ * Read all tasks for a particular task list, handing each task to a handler
+ * as soon as it has been received.  Unless streaming is disabled, a task is
+ * decoded as soon as its JSON object is complete, so that only one task at a
+ * time is held in memory.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_id [in] ID of the task list.
+ * @param handler [in] Function that receives each task, which it owns.
+ * @param user_data [in] User data for the handler.
+ * @return Nothing.
+ * Test: manual.
+ */
+void
+read_list_tasks( gtasks_session_t *session, const gchar *access_token,
+				 const gchar *task_list_id, gtask_handler handler,
+				 gpointer user_data )
+{
+	struct tasks_page_t tasks_page = { NULL, NULL, handler, user_data,
+									   session->strings };
+
+	read_task_pages( session, access_token, task_list_id, NULL,
+					 &tasks_page );
+}
+
+
 
-	/* Decode the items list and the next-page token. */
-	g_printf( "json_response = %s\n", json_response );
-	decode_json_reply( json_response, decode_task_page, &tasks_page );
-	g_free( json_response );
-	tasks = tasks_page.tasks;
+/**
+ * Read all tasks for several task lists.  The first pages of all the lists
+ * are requested at the same time, and the next page of a list is requested
+ * as soon as the previous page has arrived.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_ids [in] List of task list IDs.
+ * @return List with a list of tasks for each task list, in the same order as
+ *         the IDs.
+ * Test: manual.
+ */
+GSList*
+get_tasks_of_lists( gtasks_session_t *session, const gchar *access_token,
+					const GSList *task_list_ids )
+{
+	const GSList        *id;
+	struct tasks_page_t *pages;
+	guint               list_count;
+	guint               list_idx;
+	api_request_t       *request;
+	api_request_t       *next_request;
+	struct tasks_page_t *tasks_page;
+	GSList              *requests       = NULL;
+	GSList              *tasks_of_lists = NULL;
+
+	/* Submit a request for the first page of each list. */
+	list_count = g_slist_length( (GSList*) task_list_ids );
+	pages      = g_new0( struct tasks_page_t, list_count );
+	for( id = task_list_ids, list_idx = 0; id != NULL;
+		 id = id->next, list_idx++ )
+	{
+		pages[ list_idx ].strings = session->strings;
+		request = submit_task_page_request( session, access_token, id->data,
+											NULL, &pages[ list_idx ] );
+		request->user_data = id->data;
+		requests = g_slist_prepend( requests, request );
+	}
 
-	/* If there are more pages, request the next page and append its task
-	   list to our growing grande list o' tasks. */
-	if( tasks_page.next_page != NULL )
+	/* The tasks of each page are appended to the list's tasks as the page
+	   arrives.  Request the next page if there is one. */
+	while( ( request = wait_for_any_api_request( session->engine,
+												 &requests ) ) != NULL )
 	{
-		tasks_to_append = get_all_list_tasks( curl, access_token, task_list_id,
-											  tasks_page.next_page );
-		g_free( tasks_page.next_page );
-		tasks = g_slist_concat( tasks, tasks_to_append );
+		tasks_page = request->decoder_data;
+		if( tasks_page->next_page != NULL )
+		{
+			next_request = submit_task_page_request( session, access_token,
+													 request->user_data,
+													 tasks_page->next_page,
+													 tasks_page );
+			g_free( tasks_page->next_page );
+			tasks_page->next_page = NULL;
+			next_request->user_data = request->user_data;
+			requests = g_slist_prepend( requests, next_request );
+		}
+		destroy_api_request( request );
 	}
 
-//	debug_show_tasks( tasks );
+	for( list_idx = 0; list_idx < list_count; list_idx++ )
+	{
+		tasks_of_lists = g_slist_append( tasks_of_lists,
+										 pages[ list_idx ].tasks );
+	}
+	g_free( pages );
 
-	return( tasks );
+	return( tasks_of_lists );
 }
 
 
@@ -582,7 +944,7 @@ convert_gtask_to_vcalendar( const gtask_t *gtask )
 
 /**
  * Read a specific task from a tasks list.
- * @param curl [in] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param access_token [in] Access token for the user's Google data.
  * @param task_list_id [in] ID of the task list.
  * @param task_id [in] The ID of the task to read.
@@ -590,28 +952,79 @@ convert_gtask_to_vcalendar( const gtask_t *gtask )
  * Test: manual.
  */
 gtask_t*
-get_specified_task( CURL *curl, const gchar *access_token,
+get_specified_task( gtasks_session_t *session, const gchar *access_token,
 					const gchar *task_list_id, const gchar *task_id )
 {
-	gchar             *uri;
-	struct curl_slist *curl_headers = NULL;
-	gchar             *json_response;
-	gtask_t           *task;
+	gchar   *uri;
+	gtask_t *task;
 
 	/* Specify the list and the task in the URI. */
 	uri = g_strconcat( "lists/", task_list_id, "/tasks/", task_id, NULL );
-	/* Request the tasks. */
-	json_response = send_gtasks_data( curl, "GET", uri,
-									  access_token, NULL, NULL );
-	g_printf( "json_response = %s\n", json_response );
-	g_free( uri );
-
-	/* Decode the items list and the next-page token. */
+	/* Request the task and decode its attributes. */
 	task = g_new0( gtask_t, 1 );
-	decode_json_reply( json_response, copy_task_values, task );
-	g_free( json_response );
+	send_gtasks_data( session, "GET", uri, access_token, NULL, NULL,
+					  pull_task, task );
+	g_free( uri );
 
 //	debug_show_task( task, NULL );
 
 	return( task );
 }
+
+
+
+/**
+ * Read several tasks from a tasks list.  The requests for all the tasks are
+ * in flight at the same time.
+ * @param session [in/out] Session for the requests.
+ * @param access_token [in] Access token for the user's Google data.
+ * @param task_list_id [in] ID of the task list.
+ * @param task_ids [in] List of IDs of the tasks to read.
+ * @return The tasks that could be read, in the same order as the IDs.
+ * Test: manual.
+ */
+GSList*
+get_specified_tasks( gtasks_session_t *session, const gchar *access_token,
+					 const gchar *task_list_id, const GSList *task_ids )
+{
+	const GSList  *id;
+	gchar         *uri;
+	gtask_t       *task;
+	GSList        *requests = NULL;
+	GSList        *tasks    = NULL;
+	GSList        *submitted;
+	api_request_t *request;
+
+	/* Submit a request for each task. */
+	for( id = task_ids; id != NULL; id = id->next )
+	{
+		uri = g_strconcat( "lists/", task_list_id, "/tasks/",
+						   (const gchar*) id->data, NULL );
+		task = g_new0( gtask_t, 1 );
+		request = submit_gtasks_request( session, "GET", uri, access_token,
+										 NULL, NULL, pull_task, task );
+		g_free( uri );
+		requests = g_slist_append( requests, request );
+	}
+	/* The responses are decoded into the tasks as they arrive.  Keep only
+	   the tasks that were read successfully, as the task lists do. */
+	for( submitted = requests; submitted != NULL;
+		 submitted = submitted->next )
+	{
+		request = submitted->data;
+		wait_for_api_request( session->engine, request );
+		task = request->decoder_data;
+		if( ( request->answered == FALSE ) || ( task->id == NULL ) )
+		{
+			destroy_schema_record( &gtask_schema, task );
+		}
+		else
+		{
+			tasks = g_slist_append( tasks, task );
+		}
+		destroy_api_request( request );
+	}
+	g_slist_free( requests );
+
+	return( tasks );
+}
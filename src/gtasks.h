@@ -26,61 +26,120 @@
 #include <config.h>
 #include <glib.h>
 #include <curl/curl.h>
+#include "session.h"
+#include "taskschema.h"
 
 
 #define GOOGLE_TASKS_API "https://www.googleapis.com/tasks/v1/"
 
 
+/* The members of the Google Tasks resources, which generate the structures
+   below and the schemas that decode, encode, copy, and free them.  The
+   order of the members is the order of the partial-response field masks.
+   The INTERNED members, that is, the status and parent of a task and the
+   type of a link, are not owned by the records.  The tasks that a session
+   reads borrow them from the session's string pool, which
+   destroy_gtasks_session frees, so the records must not outlive the
+   session. */
+#define GTASK_LIST_FIELDS( FIELD )                           \
+	FIELD( id,               "id",          STRING,   NULL ) \
+	FIELD( title,            "title",       STRING,   NULL ) \
+	FIELD( updated,          "updated",     TIME,     NULL )
+
+#define GTASK_LINK_FIELDS( FIELD )                           \
+	FIELD( type,             "type",        INTERNED, NULL ) \
+	FIELD( description,      "description", STRING,   NULL ) \
+	FIELD( link,             "link",        STRING,   NULL )
+
+#define GTASK_FIELDS( FIELD )                                               \
+	FIELD( id,               "id",          STRING,   NULL )               \
+	FIELD( x_google_task_id, NULL,          STRING,   NULL )               \
+	FIELD( etag,             "etag",        STRING,   NULL )               \
+	FIELD( title,            "title",       STRING,   NULL )               \
+	FIELD( updated,          "updated",     TIME,     NULL )               \
+	FIELD( self_link,        "selfLink",    STRING,   NULL )               \
+	FIELD( parent,           "parent",      INTERNED, NULL )               \
+	FIELD( position,         "position",    STRING,   NULL )               \
+	FIELD( notes,            "notes",       STRING,   NULL )               \
+	FIELD( status,           "status",      INTERNED, NULL )               \
+	FIELD( due,              "due",         TIME,     NULL )               \
+	FIELD( completed,        "completed",   TIME,     NULL )               \
+	FIELD( deleted,          "deleted",     BOOLEAN,  NULL )               \
+	FIELD( hidden,           "hidden",      BOOLEAN,  NULL )               \
+	FIELD( links,            "links",       RECORDS,  &gtask_link_schema )
+
+
 typedef struct
 {
-	gchar     *id;
-	gchar     *title;
-	GDateTime *updated;
+	GTASK_LIST_FIELDS( DECLARE_SCHEMA_MEMBER )
 } gtask_list_t;
 
-
 typedef struct
 {
-	gchar *type;
-	gchar *description;
-	gchar *link;
+	GTASK_LINK_FIELDS( DECLARE_SCHEMA_MEMBER )
 } gtask_link_t;
 
 typedef struct
 {
-	gchar     *id;
-	gchar     *x_google_task_id;
-	gchar     *etag;
-	gchar     *title;
-	GDateTime *updated;
-	gchar     *self_link;
-	gchar     *parent;
-	gchar     *position;
-	gchar     *notes;
-	gchar     *status;
-	GDateTime *due;
-	GDateTime *completed;
-	gboolean  deleted;
-	gboolean  hidden;
-	GSList    *links;
+	GTASK_FIELDS( DECLARE_SCHEMA_MEMBER )
 } gtask_t;
 
 
+/* Schemas of task lists, links, and tasks. */
+extern record_schema_t gtask_list_schema;
+extern record_schema_t gtask_link_schema;
+extern record_schema_t gtask_schema;
+
+
+/* Function that receives each task as soon as it has been decoded. */
+typedef void (*gtask_handler)( gtask_t *task, gpointer user_data );
+
+/* A page of tasks while it is decoded. */
+struct tasks_page_t
+{
+	GSList        *tasks;
+	gchar         *next_page;
+	/* Handler that receives the tasks instead of the tasks list, or
+	   \a NULL. */
+	gtask_handler handler;
+	gpointer      handler_data;
+	/* Pool that the strings of streamed tasks are interned in. */
+	string_pool_t *strings;
+};
+
+
 
 
 /*
  * Read the user's task lists.
  */
-GSList* get_gtasks_lists( CURL *curl, const gchar *access_token );
-gtask_list_t* get_specified_gtasks_list( CURL *curl, const gchar *access_token,
+GSList* get_gtasks_lists( gtasks_session_t *session,
+						  const gchar *access_token );
+gtask_list_t* get_specified_gtasks_list( gtasks_session_t *session,
+										 const gchar *access_token,
 										 const char *task_list_name );
+GSList* get_specified_gtasks_lists( gtasks_session_t *session,
+									const gchar *access_token,
+									const GSList *task_list_ids );
 /*
  * Read tasks from a specified list.
  */
-GSList* get_all_list_tasks( CURL *curl, const gchar *access_token,
+GSList* get_all_list_tasks( gtasks_session_t *session,
+							const gchar *access_token,
 							const char *task_list_id, const char *page_token );
-gtask_t* get_specified_task( CURL *curl, const gchar *access_token,
+void read_list_tasks( gtasks_session_t *session, const gchar *access_token,
+					  const gchar *task_list_id, gtask_handler handler,
+					  gpointer user_data );
+GSList* get_tasks_of_lists( gtasks_session_t *session,
+							const gchar *access_token,
+							const GSList *task_list_ids );
+gtask_t* get_specified_task( gtasks_session_t *session,
+							 const gchar *access_token,
 							 const gchar *task_list_id, const gchar *task_id );
+GSList* get_specified_tasks( gtasks_session_t *session,
+							 const gchar *access_token,
+							 const gchar *task_list_id,
+							 const GSList *task_ids );
 
 
 #endif /* __GTASKS_H */
@@ -27,6 +27,7 @@
 #include <glib-object.h>
 #include <glib/gprintf.h>
 #include "gtasks2ical.h"
+#include "session.h"
 #include "oauth2-google.h"
 #include "gtasks.h"
 
@@ -48,7 +49,7 @@ struct configuration_t global_config;
 int
 main( int argc, char **argv )
 {
-	CURL          *curl;
+	gtasks_session_t *session;
 	gboolean      gmail_login;
 	struct user_code_t user_code;
 	access_code_t *access_code;
@@ -63,20 +64,27 @@ main( int argc, char **argv )
 
 	/* Initialize CURL. */
 	curl_global_init( CURL_GLOBAL_ALL );
-	curl = curl_easy_init( );
-	curl_easy_setopt( curl, CURLOPT_COOKIEFILE, "" );
-	curl_easy_setopt( curl, CURLOPT_COOKIESESSION, 1 );
 
 	/* Setup command-line options and environment variable options. */
     initialize_configuration( &global_config, argc, (const char *const *)argv );
 
+	/* Create the session that is used for all requests to Google. */
+	session = create_gtasks_session( );
+	if( session == NULL )
+	{
+		g_fprintf( stderr, "Error: cannot initialize CURL\n" );
+		exit( EXIT_FAILURE );
+	}
+	/* Connect to Google in the background while the local work is done. */
+	prewarm_session_connections( session );
+
 
 	/* Login to Google. */
 	if( global_config.verbose )
 	{
 		g_printf( "Logging in to Gmail..." );
 	}
-	gmail_login = login_to_gmail( curl, global_config.gmail_username,
+	gmail_login = login_to_gmail( session, global_config.gmail_username,
 								  global_config.gmail_password );
 	if( gmail_login == TRUE )
 	{
@@ -87,14 +95,14 @@ main( int argc, char **argv )
 		}
 
 		/* Now that the user is logged in, obtain a device code. */
-		access_code = authorize_application( curl );
+		access_code = authorize_application( session );
 		if( access_code != NULL )
 		{
 			access_token = access_code->access_token;
-//			get_gtasks_lists( curl, access_token );
-//			get_specified_gtasks_list( curl, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow" );
-//			get_all_list_tasks( curl, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow", NULL );
-			get_specified_task( curl, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow", "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDo3NTAyMDg5OA" );
+//			get_gtasks_lists( session, access_token );
+//			get_specified_gtasks_list( session, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow" );
+//			get_all_list_tasks( session, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow", NULL );
+			get_specified_task( session, access_token, "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDow", "MTUwNDAyNjM4MzYwNTUzNDIyNjU6MDo3NTAyMDg5OA" );
 		}
 	}
 	else
@@ -104,6 +112,7 @@ main( int argc, char **argv )
 				  "credentials are correct.\n" );
 	}
 
+	destroy_gtasks_session( session );
 	curl_global_cleanup( );
 	xmlCleanupParser( );
 
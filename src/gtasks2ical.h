@@ -42,6 +42,81 @@
    directory. */
 #define LOCAL_CONF_FILE_NAME /.gtasks2icalrc
 
+/* Default head start in milliseconds of IPv6 connection attempts before
+   IPv4 is tried as well. */
+#define DEFAULT_HAPPY_EYEBALLS_TIMEOUT 200
+/* Default number of requests to the Tasks API that may be in flight at the
+   same time. */
+#define DEFAULT_PARALLEL_REQUESTS 8
+/* Default largest number of requests in flight when the number is adapted
+   to the server's response. */
+#define DEFAULT_MAX_PARALLEL_REQUESTS 32
+/* Default number of multiplexed streams on an HTTP/2 connection. */
+#define DEFAULT_HTTP2_MAX_STREAMS 100
+/* Default number of requests per second to the Tasks API, and default
+   number of requests that may be sent at once. */
+#define DEFAULT_REQUEST_RATE 10.0
+#define DEFAULT_REQUEST_BURST 20
+/* Default number of times a failed request is repeated, default delay
+   before the first repetition in milliseconds, and default longest delay in
+   seconds. */
+#define DEFAULT_MAX_RETRIES 5
+#define DEFAULT_RETRY_DELAY 500
+#define DEFAULT_MAX_RETRY_DELAY 60
+/* Default size in bytes from which request bodies are compressed. */
+#define DEFAULT_COMPRESSION_THRESHOLD 1024
+/* Default percentile of the observed latencies after which a duplicate of a
+   slow request is sent. */
+#define DEFAULT_HEDGE_PERCENTILE 95.0
+/* Default transfer speed in bytes per second below which a request is
+   considered stalled. */
+#define DEFAULT_LOW_SPEED_LIMIT 100
+/* Default connect, low speed, and total deadlines in seconds for logging in,
+   reading, and writing. */
+#define DEFAULT_LOGIN_DEADLINES { 15, 30, 60 }
+#define DEFAULT_READ_DEADLINES  { 10, 30, 120 }
+#define DEFAULT_WRITE_DEADLINES { 10, 30, 60 }
+/* Default number of consecutive failures after which requests to a server
+   fail without being sent, and default number of seconds until a request is
+   sent to probe the server. */
+#define DEFAULT_CIRCUIT_FAILURES 5
+#define DEFAULT_CIRCUIT_DELAY 30
+
+
+/* Classes of operations that have separate deadlines: logging in and
+   authorizing the application, reading from the Tasks API, and writing to
+   the Tasks API. */
+typedef enum
+{
+	OPERATION_LOGIN,
+	OPERATION_READ,
+	OPERATION_WRITE,
+	OPERATION_CLASSES
+} operation_class_t;
+
+/* Scanners that index the structure of large JSON responses before they
+   are decoded:  the fastest that the processor supports, one that uses
+   AVX2 or SSE4.2 instructions if the processor has them, one that handles a
+   byte at a time, or none. */
+typedef enum
+{
+	JSON_SCANNER_AUTO,
+	JSON_SCANNER_AVX2,
+	JSON_SCANNER_SSE42,
+	JSON_SCANNER_SCALAR,
+	JSON_SCANNER_OFF
+} json_scanner_t;
+
+/* Deadlines of a request in seconds, each of which is disabled if it is 0:
+   the time to connect, the time that the transfer may stay below the low
+   speed limit, and the time for the whole request. */
+struct deadlines_t
+{
+	guint connect;
+	guint low_speed;
+	guint total;
+};
+
 
 /* Define file scope functions as global during testing. */
 #ifdef AUTOTEST
@@ -67,7 +142,37 @@ struct configuration_t
 	gchar    *client_password;
 
 	gboolean verbose;
-	gboolean ipv4_only;
+	guint    happy_eyeballs_timeout;
+	gboolean learn_address_families;
+	guint    parallel_requests;
+	gboolean adaptive_concurrency;
+	guint    max_parallel_requests;
+	gboolean http2;
+	guint    http2_max_streams;
+	guint    batch_requests;
+	gboolean response_cache;
+	gboolean compression;
+	gboolean compress_requests;
+	guint    compression_threshold;
+	gboolean partial_responses;
+	gchar    **omitted_fields;
+	gboolean streaming_json;
+	json_scanner_t json_scanner;
+	gdouble  request_rate;
+	guint    request_burst;
+	guint    max_retries;
+	guint    retry_delay;
+	guint    max_retry_delay;
+	gchar    *latency_file;
+	gboolean hedged_requests;
+	gdouble  hedge_percentile;
+	gboolean prewarm_connections;
+	struct deadlines_t deadlines[ OPERATION_CLASSES ];
+	guint    low_speed_limit;
+	guint    sync_deadline;
+	gboolean multipart_forms;
+	guint    circuit_failures;
+	guint    circuit_delay;
 };
 
 
@@ -72,7 +72,6 @@ print_software_help( const gchar *command_name, gboolean show_options )
 				"      --config=file         riding any settings that were applied by the\n"
                 "                            system-wide configuration file and the local\n"
 				"                            configuration file.\n"
-				"      -4, --ipv4only        Force IPv4, disabling IPv6.\n"
 				"\n"
 				"      -h, --help            Print this help and exit\n"
 				"      -V, --version         Print version and exit\n"
@@ -110,6 +109,10 @@ print_software_license( const gchar *command_name )
 static void
 reset_configuration( struct configuration_t *configuration )
 {
+	const struct deadlines_t login_deadlines = DEFAULT_LOGIN_DEADLINES;
+	const struct deadlines_t read_deadlines  = DEFAULT_READ_DEADLINES;
+	const struct deadlines_t write_deadlines = DEFAULT_WRITE_DEADLINES;
+
 	/* Set default options. */
 	configuration->listname            = NULL;
 	configuration->ical_filename       = NULL;
@@ -121,7 +124,39 @@ reset_configuration( struct configuration_t *configuration )
 	configuration->client_id           = NULL;
 	configuration->client_password     = NULL;
 	configuration->verbose             = FALSE;
-	configuration->ipv4_only           = FALSE;
+	configuration->happy_eyeballs_timeout = DEFAULT_HAPPY_EYEBALLS_TIMEOUT;
+	configuration->learn_address_families = TRUE;
+	configuration->parallel_requests   = DEFAULT_PARALLEL_REQUESTS;
+	configuration->adaptive_concurrency  = TRUE;
+	configuration->max_parallel_requests = DEFAULT_MAX_PARALLEL_REQUESTS;
+	configuration->http2               = FALSE;
+	configuration->http2_max_streams   = DEFAULT_HTTP2_MAX_STREAMS;
+	configuration->batch_requests      = 0;
+	configuration->response_cache      = TRUE;
+	configuration->compression         = TRUE;
+	configuration->compress_requests     = TRUE;
+	configuration->compression_threshold = DEFAULT_COMPRESSION_THRESHOLD;
+	configuration->partial_responses   = TRUE;
+	configuration->omitted_fields      = NULL;
+	configuration->streaming_json      = TRUE;
+	configuration->json_scanner        = JSON_SCANNER_AUTO;
+	configuration->request_rate        = DEFAULT_REQUEST_RATE;
+	configuration->request_burst       = DEFAULT_REQUEST_BURST;
+	configuration->max_retries         = DEFAULT_MAX_RETRIES;
+	configuration->retry_delay         = DEFAULT_RETRY_DELAY;
+	configuration->max_retry_delay     = DEFAULT_MAX_RETRY_DELAY;
+	configuration->latency_file        = NULL;
+	configuration->hedged_requests     = FALSE;
+	configuration->hedge_percentile    = DEFAULT_HEDGE_PERCENTILE;
+	configuration->prewarm_connections = TRUE;
+	configuration->deadlines[ OPERATION_LOGIN ] = login_deadlines;
+	configuration->deadlines[ OPERATION_READ ]  = read_deadlines;
+	configuration->deadlines[ OPERATION_WRITE ] = write_deadlines;
+	configuration->low_speed_limit     = DEFAULT_LOW_SPEED_LIMIT;
+	configuration->sync_deadline       = 0;
+	configuration->multipart_forms     = FALSE;
+	configuration->circuit_failures    = DEFAULT_CIRCUIT_FAILURES;
+	configuration->circuit_delay       = DEFAULT_CIRCUIT_DELAY;
 	configuration->configuration_file  = NULL;
 }
 
@@ -162,6 +197,8 @@ destroy_configuration( struct configuration_t *configuration )
 	g_free( configuration->configuration_file );
 	g_slist_foreach( configuration->tasks, destroy_config_task, NULL );
 	g_free( configuration->tasks );
+	g_strfreev( configuration->omitted_fields );
+	g_free( configuration->latency_file );
 }
 
 
@@ -191,7 +228,6 @@ decode_commandline(
         { "version",    no_argument,       NULL, (int)'V' },
         { "license",    no_argument,       NULL, (int)'L' },
         { "verbose",    no_argument,       NULL, (int)'v' },
-        { "ipv4only",   no_argument,       NULL, (int)'4' },
 		{ NULL, 0, NULL, 0 }
     };
     int      option_character;
@@ -202,7 +238,7 @@ decode_commandline(
 
     /* Decode the command-line switches. */
     while( ( option_character = getopt_long( argc, (char * const *) argv,
-											 "hVLvdut:c:4", long_options,
+											 "hVLvdut:c:", long_options,
 											 &option_index ) ) != -1 )
     {
         switch( option_character )
@@ -241,11 +277,6 @@ decode_commandline(
 			configuration->force_download = TRUE;
 			break;
 
-		/* Disable IPv6. */
-		case '4':
-			configuration->ipv4_only = TRUE;
-			break;
-
 		/* Specify specific task to be synchronized. */
 		case 't':
 			configuration->tasks = g_slist_append( configuration->tasks,
@@ -317,6 +348,97 @@ decode_commandline(
 
 
 
+/**
+ * Determine which operation class a deadlines key sets.
+ * @param key_name [in] Name of the key.
+ * @return Operation class, or \a OPERATION_CLASSES if the key does not set
+ *         deadlines.
+ */
+static operation_class_t
+get_operation_class( const gchar *key_name )
+{
+	if( g_strcmp0( key_name, "login deadlines" ) == 0 )
+	{
+		return( OPERATION_LOGIN );
+	}
+	else if( g_strcmp0( key_name, "read deadlines" ) == 0 )
+	{
+		return( OPERATION_READ );
+	}
+	else if( g_strcmp0( key_name, "write deadlines" ) == 0 )
+	{
+		return( OPERATION_WRITE );
+	}
+	return( OPERATION_CLASSES );
+}
+
+
+
+/**
+ * Determine which structural scanner a "json scanner" value selects.
+ * @param value [in] Value of the key.
+ * @param scanner [out] Selected scanner, which is left unchanged if the value
+ *        is invalid.
+ * @return Nothing.
+ */
+static void
+get_json_scanner_value( const gchar *value, json_scanner_t *scanner )
+{
+	if( g_strcmp0( value, "auto" ) == 0 )
+	{
+		*scanner = JSON_SCANNER_AUTO;
+	}
+	else if( g_strcmp0( value, "avx2" ) == 0 )
+	{
+		*scanner = JSON_SCANNER_AVX2;
+	}
+	else if( g_strcmp0( value, "sse4.2" ) == 0 )
+	{
+		*scanner = JSON_SCANNER_SSE42;
+	}
+	else if( g_strcmp0( value, "scalar" ) == 0 )
+	{
+		*scanner = JSON_SCANNER_SCALAR;
+	}
+	else if( g_strcmp0( value, "off" ) == 0 )
+	{
+		*scanner = JSON_SCANNER_OFF;
+	}
+}
+
+
+
+/**
+ * Read the connect, low speed, and total deadlines of an operation class
+ * from a semicolon-separated list of seconds.
+ * @param key_file [in] Configuration file.
+ * @param key_group [in] Group of the key.
+ * @param key_name [in] Name of the key.
+ * @param deadlines [out] Deadlines, which are left unchanged if the list is
+ *        invalid.
+ * @return Nothing.
+ */
+static void
+read_deadlines( GKeyFile *key_file, const gchar *key_group,
+				const gchar *key_name, struct deadlines_t *deadlines )
+{
+	gint  *seconds;
+	gsize length;
+
+	seconds = g_key_file_get_integer_list( key_file, key_group, key_name,
+										   &length, NULL );
+	if( ( seconds != NULL ) && ( length == 3 ) && ( seconds[ 0 ] >= 0 ) &&
+		( seconds[ 1 ] >= 0 ) && ( seconds[ 2 ] >= 0 ) )
+	{
+		deadlines->connect   = seconds[ 0 ];
+		deadlines->low_speed = seconds[ 1 ];
+		deadlines->total     = seconds[ 2 ];
+	}
+	g_free( seconds );
+}
+
+
+
 /**
  * Initialize the configuration based on the specified configuration file.
  * @param configuration [out] Configuration that is initialized based on the
@@ -341,7 +463,37 @@ apply_one_configuration_file( const gchar            *configuration_file,
 	gchar       *client_password;
 	gchar       *username;
 	gchar       *password;
-	gboolean    ipv4_only;
+	gint        happy_eyeballs_timeout;
+	gboolean    learn_address_families;
+	gint        parallel_requests;
+	gboolean    adaptive_concurrency;
+	gint        max_parallel_requests;
+	gboolean    http2;
+	gint        http2_max_streams;
+	gint        batch_requests;
+	gboolean    response_cache;
+	gboolean    compression;
+	gboolean    compress_requests;
+	gint        compression_threshold;
+	gboolean    partial_responses;
+	gchar       **omitted_fields;
+	gboolean    streaming_json;
+	gchar       *json_scanner;
+	gdouble     request_rate;
+	gint        request_burst;
+	gint        max_retries;
+	gint        retry_delay;
+	gchar       *latency_file;
+	gboolean    hedged_requests;
+	gdouble     hedge_percentile;
+	gboolean    prewarm_connections;
+	gint        sync_deadline;
+	gint        low_speed_limit;
+	gboolean    multipart_forms;
+	gint        circuit_failures;
+	gint        circuit_delay;
+	operation_class_t operation;
+	gint        max_retry_delay;
 
 	/* Return reporting success if the configuration file is not specified. */
 	if( configuration_file == NULL )
@@ -408,12 +560,330 @@ apply_one_configuration_file( const gchar            *configuration_file,
 						configuration->gmail_password = password;
 					}
 				}
-				/* Enable or disable IPv6. */
-				else if( g_strcmp0( key_name, "ipv4 only" ) == 0 )
+				/* Set the head start of IPv6 connection attempts. */
+				else if( g_strcmp0( key_name, "happy eyeballs timeout" ) == 0 )
+				{
+					happy_eyeballs_timeout = g_key_file_get_integer(
+						key_file, key_group, key_name, NULL );
+					if( happy_eyeballs_timeout >= 0 )
+					{
+						configuration->happy_eyeballs_timeout =
+							happy_eyeballs_timeout;
+					}
+				}
+				/* Enable or disable learning the faster address family. */
+				else if( g_strcmp0( key_name, "learn address families" ) == 0 )
+				{
+					learn_address_families = g_key_file_get_boolean(
+						key_file, key_group, key_name, NULL );
+					configuration->learn_address_families =
+						learn_address_families;
+				}
+				/* Set the number of simultaneous requests. */
+				else if( g_strcmp0( key_name, "parallel requests" ) == 0 )
+				{
+					parallel_requests = g_key_file_get_integer( key_file,
+																key_group,
+																key_name,
+																NULL );
+					if( parallel_requests > 0 )
+					{
+						configuration->parallel_requests = parallel_requests;
+					}
+				}
+				/* Enable or disable adapting the number of simultaneous
+				   requests. */
+				else if( g_strcmp0( key_name, "adaptive concurrency" ) == 0 )
+				{
+					adaptive_concurrency = g_key_file_get_boolean( key_file,
+																   key_group,
+																   key_name,
+																   NULL );
+					configuration->adaptive_concurrency = adaptive_concurrency;
+				}
+				/* Set the largest number of simultaneous requests. */
+				else if( g_strcmp0( key_name, "max parallel requests" ) == 0 )
+				{
+					max_parallel_requests = g_key_file_get_integer( key_file,
+																	key_group,
+																	key_name,
+																	NULL );
+					if( max_parallel_requests > 0 )
+					{
+						configuration->max_parallel_requests =
+							max_parallel_requests;
+					}
+				}
+				/* Enable or disable HTTP/2 multiplexing. */
+				else if( g_strcmp0( key_name, "http2" ) == 0 )
+				{
+					http2 = g_key_file_get_boolean( key_file, key_group,
+													key_name, NULL );
+					configuration->http2 = http2;
+				}
+				/* Set the number of streams on the HTTP/2 connection. */
+				else if( g_strcmp0( key_name, "http2 max streams" ) == 0 )
+				{
+					http2_max_streams = g_key_file_get_integer( key_file,
+																key_group,
+																key_name,
+																NULL );
+					if( http2_max_streams > 0 )
+					{
+						configuration->http2_max_streams = http2_max_streams;
+					}
+				}
+				/* Set the number of requests in a batch request. */
+				else if( g_strcmp0( key_name, "batch requests" ) == 0 )
+				{
+					batch_requests = g_key_file_get_integer( key_file,
+															 key_group,
+															 key_name, NULL );
+					if( batch_requests >= 0 )
+					{
+						configuration->batch_requests = batch_requests;
+					}
+				}
+				/* Enable or disable the response cache. */
+				else if( g_strcmp0( key_name, "response cache" ) == 0 )
 				{
-					ipv4_only = g_key_file_get_boolean( key_file, key_group,
-														key_name, NULL );
-					configuration->ipv4_only = ipv4_only;
+					response_cache = g_key_file_get_boolean( key_file,
+															 key_group,
+															 key_name, NULL );
+					configuration->response_cache = response_cache;
+				}
+				/* Enable or disable compressed responses. */
+				else if( g_strcmp0( key_name, "compression" ) == 0 )
+				{
+					compression = g_key_file_get_boolean( key_file, key_group,
+														  key_name, NULL );
+					configuration->compression = compression;
+				}
+				/* Enable or disable compressed request bodies. */
+				else if( g_strcmp0( key_name, "compress requests" ) == 0 )
+				{
+					compress_requests = g_key_file_get_boolean( key_file,
+																key_group,
+																key_name,
+																NULL );
+					configuration->compress_requests = compress_requests;
+				}
+				/* Set the size from which request bodies are compressed. */
+				else if( g_strcmp0( key_name, "compression threshold" ) == 0 )
+				{
+					compression_threshold = g_key_file_get_integer( key_file,
+																	key_group,
+																	key_name,
+																	NULL );
+					if( compression_threshold >= 0 )
+					{
+						configuration->compression_threshold =
+							compression_threshold;
+					}
+				}
+				/* Enable or disable partial responses. */
+				else if( g_strcmp0( key_name, "partial responses" ) == 0 )
+				{
+					partial_responses = g_key_file_get_boolean( key_file,
+																key_group,
+																key_name,
+																NULL );
+					configuration->partial_responses = partial_responses;
+				}
+				/* Set the task members that are not synchronized. */
+				else if( g_strcmp0( key_name, "omit fields" ) == 0 )
+				{
+					omitted_fields = g_key_file_get_string_list( key_file,
+																 key_group,
+																 key_name,
+																 NULL, NULL );
+					if( omitted_fields != NULL )
+					{
+						g_strfreev( configuration->omitted_fields );
+						configuration->omitted_fields = omitted_fields;
+					}
+				}
+				/* Enable or disable decoding tasks while they arrive. */
+				else if( g_strcmp0( key_name, "streaming json" ) == 0 )
+				{
+					streaming_json = g_key_file_get_boolean( key_file,
+															 key_group,
+															 key_name, NULL );
+					configuration->streaming_json = streaming_json;
+				}
+				/* Select the scanner that indexes large responses. */
+				else if( g_strcmp0( key_name, "json scanner" ) == 0 )
+				{
+					json_scanner = g_key_file_get_string( key_file,
+														  key_group,
+														  key_name, NULL );
+					get_json_scanner_value( json_scanner,
+											&configuration->json_scanner );
+					g_free( json_scanner );
+				}
+				/* Set the rate of requests to the Tasks API. */
+				else if( g_strcmp0( key_name, "requests per second" ) == 0 )
+				{
+					request_rate = g_key_file_get_double( key_file, key_group,
+														  key_name, NULL );
+					if( request_rate >= 0.0 )
+					{
+						configuration->request_rate = request_rate;
+					}
+				}
+				/* Set the number of requests that may be sent at once. */
+				else if( g_strcmp0( key_name, "request burst" ) == 0 )
+				{
+					request_burst = g_key_file_get_integer( key_file,
+															key_group,
+															key_name, NULL );
+					if( request_burst > 0 )
+					{
+						configuration->request_burst = request_burst;
+					}
+				}
+				/* Set the number of times a failed request is repeated. */
+				else if( g_strcmp0( key_name, "max retries" ) == 0 )
+				{
+					max_retries = g_key_file_get_integer( key_file, key_group,
+														  key_name, NULL );
+					if( max_retries >= 0 )
+					{
+						configuration->max_retries = max_retries;
+					}
+				}
+				/* Set the delay before the first repetition. */
+				else if( g_strcmp0( key_name, "retry delay" ) == 0 )
+				{
+					retry_delay = g_key_file_get_integer( key_file, key_group,
+														  key_name, NULL );
+					if( retry_delay > 0 )
+					{
+						configuration->retry_delay = retry_delay;
+					}
+				}
+				/* Set the longest delay before a repetition. */
+				else if( g_strcmp0( key_name, "max retry delay" ) == 0 )
+				{
+					max_retry_delay = g_key_file_get_integer( key_file,
+															  key_group,
+															  key_name, NULL );
+					if( max_retry_delay > 0 )
+					{
+						configuration->max_retry_delay = max_retry_delay;
+					}
+				}
+				/* Set the file that the request latencies are written to. */
+				else if( g_strcmp0( key_name, "latency file" ) == 0 )
+				{
+					latency_file = g_key_file_get_string( key_file, key_group,
+														  key_name, NULL );
+					if( latency_file != NULL )
+					{
+						g_free( configuration->latency_file );
+						configuration->latency_file = NULL;
+						if( *latency_file != '\0' )
+						{
+							configuration->latency_file = latency_file;
+						}
+						else
+						{
+							g_free( latency_file );
+						}
+					}
+				}
+				/* Enable or disable hedged requests. */
+				else if( g_strcmp0( key_name, "hedged requests" ) == 0 )
+				{
+					hedged_requests = g_key_file_get_boolean( key_file,
+															  key_group,
+															  key_name, NULL );
+					configuration->hedged_requests = hedged_requests;
+				}
+				/* Set the latency percentile after which a request is
+				   hedged. */
+				else if( g_strcmp0( key_name, "hedge percentile" ) == 0 )
+				{
+					hedge_percentile = g_key_file_get_double( key_file,
+															  key_group,
+															  key_name, NULL );
+					if( ( hedge_percentile > 0.0 ) &&
+						( hedge_percentile < 100.0 ) )
+					{
+						configuration->hedge_percentile = hedge_percentile;
+					}
+				}
+				/* Enable or disable pre-warming the connections. */
+				else if( g_strcmp0( key_name, "prewarm connections" ) == 0 )
+				{
+					prewarm_connections = g_key_file_get_boolean( key_file,
+																  key_group,
+																  key_name,
+																  NULL );
+					configuration->prewarm_connections = prewarm_connections;
+				}
+				/* Set the deadlines of an operation class. */
+				else if( ( operation = get_operation_class( key_name ) )
+						 != OPERATION_CLASSES )
+				{
+					read_deadlines( key_file, key_group, key_name,
+									&configuration->deadlines[ operation ] );
+				}
+				/* Set the transfer speed below which a request stalls. */
+				else if( g_strcmp0( key_name, "low speed limit" ) == 0 )
+				{
+					low_speed_limit = g_key_file_get_integer( key_file,
+															  key_group,
+															  key_name, NULL );
+					if( low_speed_limit > 0 )
+					{
+						configuration->low_speed_limit = low_speed_limit;
+					}
+				}
+				/* Set the deadline of the whole synchronization. */
+				else if( g_strcmp0( key_name, "sync deadline" ) == 0 )
+				{
+					sync_deadline = g_key_file_get_integer( key_file,
+															key_group,
+															key_name, NULL );
+					if( sync_deadline >= 0 )
+					{
+						configuration->sync_deadline = sync_deadline;
+					}
+				}
+				/* Submit forms as multipart/form-data instead of
+				   URL-encoded. */
+				else if( g_strcmp0( key_name, "multipart forms" ) == 0 )
+				{
+					multipart_forms = g_key_file_get_boolean( key_file,
+															  key_group,
+															  key_name, NULL );
+					configuration->multipart_forms = multipart_forms;
+				}
+				/* Set the number of failures that open a server's
+				   circuit. */
+				else if( g_strcmp0( key_name, "circuit breaker failures" )
+						 == 0 )
+				{
+					circuit_failures = g_key_file_get_integer( key_file,
+															   key_group,
+															   key_name,
+															   NULL );
+					if( circuit_failures >= 0 )
+					{
+						configuration->circuit_failures = circuit_failures;
+					}
+				}
+				/* Set the time that a server's circuit stays open. */
+				else if( g_strcmp0( key_name, "circuit breaker delay" ) == 0 )
+				{
+					circuit_delay = g_key_file_get_integer( key_file,
+															key_group,
+															key_name, NULL );
+					if( circuit_delay > 0 )
+					{
+						configuration->circuit_delay = circuit_delay;
+					}
 				}
 			}
 			g_strfreev( keys );
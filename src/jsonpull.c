@@ -0,0 +1,552 @@
+/**
+ * \file jsonpull.c
+ * \brief Pull parser for JSON documents.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "jsonscan.h"
+#include "jsonpull.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Documents of at least this many bytes are indexed before they are
+   decoded. */
+#define JSON_INDEX_THRESHOLD 4096
+
+
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+/**
+ * Begin pulling the tokens of a JSON document.
+ * @param pull [out] Pull parser.
+ * @param json [in] JSON document, which must remain valid while it is
+ *        parsed.
+ * @param length [in] Length of the document.
+ * @return Nothing.
+ */
+void
+init_json_pull( json_pull_t *pull, const gchar *json, gsize length )
+{
+	pull->position        = json;
+	pull->end             = json + length;
+	pull->failed          = FALSE;
+	pull->start           = json;
+	pull->structure       = NULL;
+	pull->structure_count = 0;
+	pull->structure_next  = 0;
+	pull->strings         = NULL;
+}
+
+
+
+/**
+ * Step past a structural character in the document's structural index, if
+ * the document has one.
+ * @param pull [in/out] Pull parser.
+ * @param position [in] Position of the structural character.
+ * @return Nothing.  The parser fails if the character is not the next one
+ *         in the index.
+ */
+STATIC void
+consume_structure( json_pull_t *pull, const gchar *position )
+{
+	if( pull->structure == NULL )
+	{
+		return;
+	}
+	if( ( pull->structure_next < pull->structure_count ) &&
+		( pull->start + pull->structure[ pull->structure_next ] ==
+		  position ) )
+	{
+		pull->structure_next++;
+	}
+	else
+	{
+		pull->failed = TRUE;
+	}
+}
+
+
+
+/**
+ * Find the closing quote of a string in the document's structural index.
+ * @param pull [in/out] Pull parser.
+ * @param position [in] Position of the opening quote.
+ * @param escaped [out] Set to \a TRUE if the string contains escaped
+ *        characters.
+ * @return Pointer to the closing quote, or \a NULL if the string is not
+ *         terminated.
+ */
+STATIC const gchar*
+find_indexed_string_end( json_pull_t *pull, const gchar *position,
+						 gboolean *escaped )
+{
+	const gchar *string_end;
+
+	consume_structure( pull, position );
+	if( ( pull->failed == TRUE ) ||
+		( pull->structure_next >= pull->structure_count ) )
+	{
+		return( NULL );
+	}
+	string_end = pull->start + pull->structure[ pull->structure_next++ ];
+	*escaped = ( memchr( position + 1, '\\', string_end - position - 1 ) !=
+				 NULL );
+
+	return( string_end );
+}
+
+
+
+/**
+ * Find the closing quote of a string.
+ * @param position [in] First character after the opening quote.
+ * @param end [in] End of the document.
+ * @param escaped [out] Set to \a TRUE if the string contains escaped
+ *        characters.
+ * @return Pointer to the closing quote, or \a NULL if the string is not
+ *         terminated.
+ */
+STATIC const gchar*
+find_json_string_end( const gchar *position, const gchar *end,
+					  gboolean *escaped )
+{
+	for( ; position < end; position++ )
+	{
+		if( *position == '"' )
+		{
+			return( position );
+		}
+		else if( *position == '\\' )
+		{
+			*escaped = TRUE;
+			position++;
+		}
+	}
+
+	return( NULL );
+}
+
+
+
+/**
+ * Determine whether a literal is next in a document.
+ * @param position [in] Current position in the document.
+ * @param end [in] End of the document.
+ * @param literal [in] The literal, such as "true".
+ * @return \a TRUE if the literal is next, or \a FALSE otherwise.
+ */
+STATIC gboolean
+is_json_literal( const gchar *position, const gchar *end,
+				 const gchar *literal )
+{
+	gsize length = strlen( literal );
+
+	return( ( (gsize) ( end - position ) >= length ) &&
+			( memcmp( position, literal, length ) == 0 ) );
+}
+
+
+
+/**
+ * Read the next token of a JSON document.  Whitespace, commas, and colons
+ * between the tokens are skipped.
+ * @param pull [in/out] Pull parser.
+ * @param token [out] The token.
+ * @return Type of the token.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+json_token_type_t
+next_json_token( json_pull_t *pull, json_token_t *token )
+{
+	const gchar       *position = pull->position;
+	const gchar       *end      = pull->end;
+	const gchar       *string_end;
+	json_token_type_t type;
+
+	token->escaped = FALSE;
+	token->length  = 0;
+	if( pull->failed == TRUE )
+	{
+		token->start = position;
+		token->type  = JSON_TOKEN_ERROR;
+		return( JSON_TOKEN_ERROR );
+	}
+	for( ; position < end; position++ )
+	{
+		if( ( *position == ',' ) || ( *position == ':' ) )
+		{
+			consume_structure( pull, position );
+		}
+		else if( ( *position != ' ' ) && ( *position != '\t' ) &&
+				 ( *position != '\n' ) && ( *position != '\r' ) )
+		{
+			break;
+		}
+	}
+	token->start = position;
+
+	if( ( position >= end ) || ( *position == '\0' ) )
+	{
+		type = JSON_TOKEN_END;
+	}
+	else
+	{
+		switch( *position )
+		{
+			case '{':
+				type = JSON_TOKEN_OBJECT_BEGIN;
+				consume_structure( pull, position );
+				position++;
+				break;
+			case '}':
+				type = JSON_TOKEN_OBJECT_END;
+				consume_structure( pull, position );
+				position++;
+				break;
+			case '[':
+				type = JSON_TOKEN_ARRAY_BEGIN;
+				consume_structure( pull, position );
+				position++;
+				break;
+			case ']':
+				type = JSON_TOKEN_ARRAY_END;
+				consume_structure( pull, position );
+				position++;
+				break;
+			case '"':
+				if( pull->structure != NULL )
+				{
+					string_end = find_indexed_string_end( pull, position,
+														  &token->escaped );
+				}
+				else
+				{
+					string_end = find_json_string_end( position + 1, end,
+													   &token->escaped );
+				}
+				if( string_end == NULL )
+				{
+					type = JSON_TOKEN_ERROR;
+				}
+				else
+				{
+					type          = JSON_TOKEN_STRING;
+					token->start  = position + 1;
+					token->length = string_end - token->start;
+					position      = string_end + 1;
+				}
+				break;
+			case 't':
+			case 'f':
+			case 'n':
+				if( is_json_literal( position, end, "true" ) )
+				{
+					type = JSON_TOKEN_TRUE;
+					position += 4;
+				}
+				else if( is_json_literal( position, end, "false" ) )
+				{
+					type = JSON_TOKEN_FALSE;
+					position += 5;
+				}
+				else if( is_json_literal( position, end, "null" ) )
+				{
+					type = JSON_TOKEN_NULL;
+					position += 4;
+				}
+				else
+				{
+					type = JSON_TOKEN_ERROR;
+				}
+				break;
+			default:
+				if( ( *position == '-' ) || g_ascii_isdigit( *position ) )
+				{
+					type = JSON_TOKEN_NUMBER;
+					while( ( position < end ) &&
+						   ( ( *position == '-' ) || ( *position == '+' ) ||
+							 ( *position == '.' ) || ( *position == 'e' ) ||
+							 ( *position == 'E' ) ||
+							 g_ascii_isdigit( *position ) ) )
+					{
+						position++;
+					}
+					token->length = position - token->start;
+				}
+				else
+				{
+					type = JSON_TOKEN_ERROR;
+				}
+				break;
+		}
+	}
+
+	if( ( type == JSON_TOKEN_ERROR ) || ( pull->failed == TRUE ) )
+	{
+		type         = JSON_TOKEN_ERROR;
+		pull->failed = TRUE;
+	}
+	else if( type != JSON_TOKEN_STRING && type != JSON_TOKEN_NUMBER )
+	{
+		token->length = position - token->start;
+	}
+	pull->position = position;
+	token->type    = type;
+
+	return( type );
+}
+
+
+
+/**
+ * Skip the rest of a value whose first token has been read.  The tokens of
+ * an object or array are read through its end token.
+ * @param pull [in/out] Pull parser.
+ * @param token [in] First token of the value.
+ * @return \a TRUE if the value was skipped, or \a FALSE if the document
+ *         ended or has a syntax error.
+ */
+gboolean
+skip_json_value( json_pull_t *pull, const json_token_t *token )
+{
+	guint        depth;
+	json_token_t next;
+
+	switch( token->type )
+	{
+		case JSON_TOKEN_OBJECT_BEGIN:
+		case JSON_TOKEN_ARRAY_BEGIN:
+			for( depth = 1; depth > 0; )
+			{
+				switch( next_json_token( pull, &next ) )
+				{
+					case JSON_TOKEN_OBJECT_BEGIN:
+					case JSON_TOKEN_ARRAY_BEGIN:
+						depth++;
+						break;
+					case JSON_TOKEN_OBJECT_END:
+					case JSON_TOKEN_ARRAY_END:
+						depth--;
+						break;
+					case JSON_TOKEN_END:
+					case JSON_TOKEN_ERROR:
+						return( FALSE );
+					default:
+						break;
+				}
+			}
+			return( TRUE );
+
+		case JSON_TOKEN_END:
+		case JSON_TOKEN_ERROR:
+		case JSON_TOKEN_OBJECT_END:
+		case JSON_TOKEN_ARRAY_END:
+			return( FALSE );
+
+		default:
+			return( TRUE );
+	}
+}
+
+
+
+/**
+ * Read the four hexadecimal digits of a \\u escape sequence.
+ * @param digits [in] The digits.
+ * @param end [in] End of the string.
+ * @return The code unit, or -1 if the digits are invalid.
+ */
+STATIC gint
+read_json_code_unit( const gchar *digits, const gchar *end )
+{
+	gint code_unit = 0;
+	gint idx;
+
+	if( end - digits < 4 )
+	{
+		return( -1 );
+	}
+	for( idx = 0; idx < 4; idx++ )
+	{
+		if( g_ascii_isxdigit( digits[ idx ] ) == FALSE )
+		{
+			return( -1 );
+		}
+		code_unit = code_unit * 16 + g_ascii_xdigit_value( digits[ idx ] );
+	}
+
+	return( code_unit );
+}
+
+
+
+/**
+ * Copy a string token, unescaping its characters.  A surrogate pair of \\u
+ * escape sequences is combined to one character; an invalid escape sequence
+ * is copied as it is.
+ * @param token [in] String token.
+ * @return Newly allocated UTF-8 string.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+gchar*
+dup_json_string( const json_token_t *token )
+{
+	GString     *string;
+	const gchar *position;
+	const gchar *end = token->start + token->length;
+	gint        code_unit;
+	gint        low_surrogate;
+
+	if( token->escaped == FALSE )
+	{
+		return( g_strndup( token->start, token->length ) );
+	}
+
+	string = g_string_sized_new( token->length );
+	for( position = token->start; position < end; position++ )
+	{
+		if( ( *position != '\\' ) || ( position + 1 >= end ) )
+		{
+			g_string_append_c( string, *position );
+			continue;
+		}
+		position++;
+		switch( *position )
+		{
+			case 'b':
+				g_string_append_c( string, '\b' );
+				break;
+			case 'f':
+				g_string_append_c( string, '\f' );
+				break;
+			case 'n':
+				g_string_append_c( string, '\n' );
+				break;
+			case 'r':
+				g_string_append_c( string, '\r' );
+				break;
+			case 't':
+				g_string_append_c( string, '\t' );
+				break;
+			case 'u':
+				code_unit = read_json_code_unit( position + 1, end );
+				if( code_unit < 0 )
+				{
+					g_string_append( string, "\\u" );
+					break;
+				}
+				position += 4;
+				/* Combine a surrogate pair. */
+				if( ( code_unit >= 0xd800 ) && ( code_unit < 0xdc00 ) &&
+					( end - position > 6 ) && ( position[ 1 ] == '\\' ) &&
+					( position[ 2 ] == 'u' ) )
+				{
+					low_surrogate = read_json_code_unit( position + 3, end );
+					if( ( low_surrogate >= 0xdc00 ) &&
+						( low_surrogate < 0xe000 ) )
+					{
+						code_unit = 0x10000 + ( ( code_unit - 0xd800 ) << 10 )
+							+ ( low_surrogate - 0xdc00 );
+						position += 6;
+					}
+				}
+				g_string_append_unichar( string, code_unit );
+				break;
+			default:
+				/* Quotes, backslashes, and slashes stand for themselves. */
+				g_string_append_c( string, *position );
+				break;
+		}
+	}
+
+	return( g_string_free( string, FALSE ) );
+}
+
+
+
+/**
+ * Determine whether a string token is a key of a given name.  Keys with
+ * escaped characters are not matched.
+ * @param token [in] String token.
+ * @param name [in] Name of the key.
+ * @return \a TRUE if the token is the key, or \a FALSE otherwise.
+ */
+gboolean
+is_json_key( const json_token_t *token, const gchar *name )
+{
+	return( ( token->type == JSON_TOKEN_STRING ) &&
+			( strncmp( token->start, name, token->length ) == 0 ) &&
+			( name[ token->length ] == '\0' ) );
+}
+
+
+
+/**
+ * Decode a JSON document with a pull decoder, which reads the document's
+ * tokens and fills its own data structures without building a tree of the
+ * document.  A large document is first indexed by the configured structural
+ * scanner, which finds all of its strings in one vectorized pass.
+ * @param json [in] JSON document.
+ * @param length [in] Length of the document.
+ * @param strings [in/out] Pool that repeated strings are interned in, or
+ *        \a NULL to use the default pool.
+ * @param decoder [in] Pull decoder.
+ * @param data [in/out] Data for the decoder.
+ * @return \a TRUE if the decoder decoded the document, or \a FALSE
+ *         otherwise.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+gboolean
+decode_json_pull( const gchar *json, gsize length, string_pool_t *strings,
+				  json_pull_decoder decoder, gpointer data )
+{
+	json_pull_t    pull;
+	json_scanner_t scanner;
+	json_index_t   index;
+	gboolean       decoded;
+
+	init_json_pull( &pull, json, length );
+	pull.strings = strings;
+	scanner = get_json_scanner( global_config.json_scanner );
+	if( ( scanner == JSON_SCANNER_OFF ) || ( length < JSON_INDEX_THRESHOLD ) ||
+		( length >= G_MAXUINT32 ) )
+	{
+		return( decoder( &pull, data ) );
+	}
+
+	if( scan_json_structure( scanner, json, length, &index ) == TRUE )
+	{
+		pull.structure       = index.positions;
+		pull.structure_count = index.count;
+	}
+	decoded = decoder( &pull, data );
+	free_json_index( &index );
+
+	return( decoded );
+}
@@ -0,0 +1,116 @@
+/**
+ * \file jsonpull.h
+ * \brief Definitions for the pull parser for JSON documents.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_JSONPULL_H
+#define __GTASKS_JSONPULL_H
+
+#include <config.h>
+#include <glib.h>
+#include "stringpool.h"
+
+
+/* Tokens of a JSON document.  Commas and colons are skipped, so an object
+   is its begin token, a key string and a value for each member, and its end
+   token. */
+typedef enum
+{
+	JSON_TOKEN_END,
+	JSON_TOKEN_ERROR,
+	JSON_TOKEN_OBJECT_BEGIN,
+	JSON_TOKEN_OBJECT_END,
+	JSON_TOKEN_ARRAY_BEGIN,
+	JSON_TOKEN_ARRAY_END,
+	JSON_TOKEN_STRING,
+	JSON_TOKEN_NUMBER,
+	JSON_TOKEN_TRUE,
+	JSON_TOKEN_FALSE,
+	JSON_TOKEN_NULL
+} json_token_type_t;
+
+/* A token points into the document.  The characters of a string token are
+   those between the quotes, which must be unescaped if \a escaped is
+   TRUE. */
+typedef struct
+{
+	json_token_type_t type;
+	const gchar       *start;
+	gsize             length;
+	gboolean          escaped;
+} json_token_t;
+
+/* A pull parser reads the tokens of a JSON document one at a time, without
+   building a tree of the document.  Once it has met a syntax error, it
+   returns only error tokens.  If the document has a structural index, the
+   end of each string is looked up in the index instead of being searched
+   for; \a structure_next is the index entry of the next structural
+   character.  Strings that repeat across a document, such as statuses,
+   are interned in \a strings, or in the default pool if it is \a NULL. */
+typedef struct
+{
+	const gchar   *position;
+	const gchar   *end;
+	gboolean      failed;
+	const gchar   *start;
+	const guint32 *structure;
+	gsize         structure_count;
+	gsize         structure_next;
+	string_pool_t *strings;
+} json_pull_t;
+
+/* Function that decodes a JSON document from a pull parser. */
+typedef gboolean (*json_pull_decoder) ( json_pull_t *pull, gpointer data );
+
+
+/*
+ * Begin pulling the tokens of a JSON document.
+ */
+void init_json_pull( json_pull_t *pull, const gchar *json, gsize length );
+
+/*
+ * Read the next token of a JSON document.
+ */
+json_token_type_t next_json_token( json_pull_t *pull, json_token_t *token );
+
+/*
+ * Skip the rest of a value whose first token has been read.
+ */
+gboolean skip_json_value( json_pull_t *pull, const json_token_t *token );
+
+/*
+ * Copy a string token, unescaping its characters.
+ */
+gchar *dup_json_string( const json_token_t *token );
+
+/*
+ * Determine whether a string token is a key of a given name.
+ */
+gboolean is_json_key( const json_token_t *token, const gchar *name );
+
+/*
+ * Decode a JSON document with a pull decoder.
+ */
+gboolean decode_json_pull( const gchar *json, gsize length,
+						   string_pool_t *strings, json_pull_decoder decoder,
+						   gpointer data );
+
+
+#endif /* __GTASKS_JSONPULL_H */
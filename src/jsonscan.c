@@ -0,0 +1,376 @@
+/**
+ * \file jsonscan.c
+ * \brief Vectorized structural scanner of JSON documents.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "jsonscan.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define X86_SCANNERS
+#include <immintrin.h>
+#endif
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* The document is scanned in blocks of 64 bytes, one bit per byte. */
+#define SCAN_BLOCK_SIZE 64
+
+/* Bit masks of the quotes, backslashes, and structural characters in a
+   block. */
+struct block_masks_t
+{
+	guint64 quotes;
+	guint64 backslashes;
+	guint64 structurals;
+};
+
+/* Function that classifies the bytes of a block. */
+typedef void (*block_classifier) ( const guint8 *block,
+								   struct block_masks_t *masks );
+
+
+
+/**
+ * Classify the bytes of a block one at a time.
+ * @param block [in] Block of 64 bytes.
+ * @param masks [out] Bit masks of the block.
+ * @return Nothing.
+ */
+STATIC void
+classify_block_scalar( const guint8 *block, struct block_masks_t *masks )
+{
+	guint   idx;
+	guint64 bit;
+
+	masks->quotes      = 0;
+	masks->backslashes = 0;
+	masks->structurals = 0;
+	for( idx = 0; idx < SCAN_BLOCK_SIZE; idx++ )
+	{
+		bit = (guint64) 1 << idx;
+		switch( block[ idx ] )
+		{
+			case '"':
+				masks->quotes |= bit;
+				break;
+			case '\\':
+				masks->backslashes |= bit;
+				break;
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ':':
+			case ',':
+				masks->structurals |= bit;
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+
+
+#ifdef X86_SCANNERS
+/**
+ * Classify the bytes of a block 16 at a time with SSE4.2 instructions.  The
+ * structural characters are found with a single string comparison.
+ * @param block [in] Block of 64 bytes.
+ * @param masks [out] Bit masks of the block.
+ * @return Nothing.
+ */
+__attribute__(( target( "sse4.2" ) ))
+STATIC void
+classify_block_sse42( const guint8 *block, struct block_masks_t *masks )
+{
+	const __m128i quote      = _mm_set1_epi8( '"' );
+	const __m128i backslash  = _mm_set1_epi8( '\\' );
+	const __m128i structural = _mm_setr_epi8( '{', '}', '[', ']', ':', ',',
+											  0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+	__m128i       chunk;
+	__m128i       found;
+	guint         idx;
+
+	masks->quotes      = 0;
+	masks->backslashes = 0;
+	masks->structurals = 0;
+	for( idx = 0; idx < SCAN_BLOCK_SIZE; idx += 16 )
+	{
+		chunk = _mm_loadu_si128( (const __m128i*) ( block + idx ) );
+		masks->quotes |= (guint64) (guint16) _mm_movemask_epi8(
+			_mm_cmpeq_epi8( chunk, quote ) ) << idx;
+		masks->backslashes |= (guint64) (guint16) _mm_movemask_epi8(
+			_mm_cmpeq_epi8( chunk, backslash ) ) << idx;
+		found = _mm_cmpestrm( structural, 6, chunk, 16,
+							  _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+							  _SIDD_BIT_MASK );
+		masks->structurals |=
+			(guint64) (guint16) _mm_cvtsi128_si32( found ) << idx;
+	}
+}
+
+
+
+/**
+ * Classify the bytes of a block 32 at a time with AVX2 instructions.
+ * Braces and brackets are found together, since they differ only in the
+ * 0x20 bit.
+ * @param block [in] Block of 64 bytes.
+ * @param masks [out] Bit masks of the block.
+ * @return Nothing.
+ */
+__attribute__(( target( "avx2" ) ))
+STATIC void
+classify_block_avx2( const guint8 *block, struct block_masks_t *masks )
+{
+	const __m256i quote       = _mm256_set1_epi8( '"' );
+	const __m256i backslash   = _mm256_set1_epi8( '\\' );
+	const __m256i case_bit    = _mm256_set1_epi8( 0x20 );
+	const __m256i open_brace  = _mm256_set1_epi8( '{' );
+	const __m256i close_brace = _mm256_set1_epi8( '}' );
+	const __m256i colon       = _mm256_set1_epi8( ':' );
+	const __m256i comma       = _mm256_set1_epi8( ',' );
+	__m256i       chunk;
+	__m256i       folded;
+	__m256i       found;
+	guint         idx;
+
+	masks->quotes      = 0;
+	masks->backslashes = 0;
+	masks->structurals = 0;
+	for( idx = 0; idx < SCAN_BLOCK_SIZE; idx += 32 )
+	{
+		chunk = _mm256_loadu_si256( (const __m256i*) ( block + idx ) );
+		masks->quotes |= (guint64) (guint32) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8( chunk, quote ) ) << idx;
+		masks->backslashes |= (guint64) (guint32) _mm256_movemask_epi8(
+			_mm256_cmpeq_epi8( chunk, backslash ) ) << idx;
+		folded = _mm256_or_si256( chunk, case_bit );
+		found  = _mm256_or_si256(
+			_mm256_or_si256( _mm256_cmpeq_epi8( folded, open_brace ),
+							 _mm256_cmpeq_epi8( folded, close_brace ) ),
+			_mm256_or_si256( _mm256_cmpeq_epi8( chunk, colon ),
+							 _mm256_cmpeq_epi8( chunk, comma ) ) );
+		masks->structurals |=
+			(guint64) (guint32) _mm256_movemask_epi8( found ) << idx;
+	}
+}
+#endif /* X86_SCANNERS */
+
+
+
+/**
+ * Choose the scanner that is used for a requested scanner on this
+ * processor.  The automatic choice is the fastest scanner that the
+ * processor supports, and a scanner that it does not support is replaced by
+ * the next slower one.
+ * @param requested [in] The requested scanner.
+ * @return The scanner that is used.
+ * Test: unit test (test-gtasks.c: json_scanner).
+ */
+json_scanner_t
+get_json_scanner( json_scanner_t requested )
+{
+#ifdef X86_SCANNERS
+	__builtin_cpu_init( );
+	if( ( requested == JSON_SCANNER_AUTO ) ||
+		( requested == JSON_SCANNER_AVX2 ) )
+	{
+		requested = __builtin_cpu_supports( "avx2" ) ?
+			JSON_SCANNER_AVX2 : JSON_SCANNER_SSE42;
+	}
+	if( ( requested == JSON_SCANNER_SSE42 ) &&
+		( __builtin_cpu_supports( "sse4.2" ) == 0 ) )
+	{
+		requested = JSON_SCANNER_SCALAR;
+	}
+	return( requested );
+#else
+	return( requested == JSON_SCANNER_OFF ?
+			JSON_SCANNER_OFF : JSON_SCANNER_SCALAR );
+#endif
+}
+
+
+
+/**
+ * Find the characters in a block that are escaped by a backslash.  A
+ * backslash that is itself escaped does not escape the next character.
+ * @param backslashes [in] Bit mask of the backslashes in the block.
+ * @param carry [in/out] \a TRUE if the first character of the block is
+ *        escaped by the last character of the previous block; on return,
+ *        \a TRUE if the first character of the next block is escaped.
+ * @return Bit mask of the escaped characters.
+ */
+STATIC guint64
+find_escaped_characters( guint64 backslashes, gboolean *carry )
+{
+	guint64 escaped = 0;
+	guint   position;
+
+	if( *carry == TRUE )
+	{
+		escaped      = 1;
+		backslashes &= ~(guint64) 1;
+	}
+	*carry = FALSE;
+	while( backslashes != 0 )
+	{
+		position = __builtin_ctzll( backslashes );
+		if( position == SCAN_BLOCK_SIZE - 1 )
+		{
+			*carry = TRUE;
+			break;
+		}
+		escaped     |= (guint64) 1 << ( position + 1 );
+		backslashes &= ~( (guint64) 3 << position );
+	}
+
+	return( escaped );
+}
+
+
+
+/**
+ * Compute the running parity of a bit mask, so that every bit from a set
+ * bit up to, but not including, the next set bit is set.
+ * @param bits [in] Bit mask.
+ * @return Prefix XOR of the bits.
+ */
+STATIC guint64
+prefix_xor( guint64 bits )
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+
+	return( bits );
+}
+
+
+
+/**
+ * Build the structural index of a JSON document.  Each block of the
+ * document is classified with the chosen scanner; the unescaped quotes then
+ * determine which bytes are inside strings, and the structural characters
+ * in strings are dropped.
+ * @param scanner [in] Scanner, as chosen by \a get_json_scanner.
+ * @param json [in] JSON document.
+ * @param length [in] Length of the document, which must be less than
+ *        4 GiB.
+ * @param index [out] The structural index, whose offsets must be freed with
+ *        \a free_json_index.
+ * @return \a TRUE if the index was built, or \a FALSE if the document ends
+ *         inside a string.
+ * Test: unit test (test-gtasks.c: json_scanner).
+ */
+gboolean
+scan_json_structure( json_scanner_t scanner, const gchar *json, gsize length,
+					 json_index_t *index )
+{
+	block_classifier     classify = classify_block_scalar;
+	guint8               tail[ SCAN_BLOCK_SIZE ];
+	const guint8         *block;
+	gsize                offset;
+	struct block_masks_t masks;
+	gboolean             carry     = FALSE;
+	guint64              in_string = 0;
+	guint64              quotes;
+	guint64              string_mask;
+	guint64              bits;
+
+#ifdef X86_SCANNERS
+	if( scanner == JSON_SCANNER_AVX2 )
+	{
+		classify = classify_block_avx2;
+	}
+	else if( scanner == JSON_SCANNER_SSE42 )
+	{
+		classify = classify_block_sse42;
+	}
+#endif
+
+	memset( index, 0, sizeof( *index ) );
+	for( offset = 0; offset < length; offset += SCAN_BLOCK_SIZE )
+	{
+		/* The last block is padded with zeros. */
+		if( length - offset >= SCAN_BLOCK_SIZE )
+		{
+			block = (const guint8*) json + offset;
+		}
+		else
+		{
+			memset( tail, 0, sizeof( tail ) );
+			memcpy( tail, json + offset, length - offset );
+			block = tail;
+		}
+		classify( block, &masks );
+
+		quotes = masks.quotes;
+		if( ( masks.backslashes != 0 ) || ( carry == TRUE ) )
+		{
+			quotes &= ~find_escaped_characters( masks.backslashes, &carry );
+		}
+		string_mask = prefix_xor( quotes ) ^ in_string;
+		in_string   = (guint64) ( (gint64) string_mask >> 63 );
+		bits        = ( masks.structurals & ~string_mask ) | quotes;
+
+		if( index->count + SCAN_BLOCK_SIZE > index->allocated )
+		{
+			index->allocated = MAX( 2 * index->allocated,
+									index->count + SCAN_BLOCK_SIZE );
+			index->positions = g_renew( guint32, index->positions,
+										index->allocated );
+		}
+		while( bits != 0 )
+		{
+			index->positions[ index->count++ ] =
+				offset + __builtin_ctzll( bits );
+			bits &= bits - 1;
+		}
+	}
+
+	return( in_string == 0 );
+}
+
+
+
+/**
+ * Free the offsets of a structural index.
+ * @param index [in/out] The structural index.
+ * @return Nothing.
+ */
+void
+free_json_index( json_index_t *index )
+{
+	g_free( index->positions );
+	memset( index, 0, sizeof( *index ) );
+}
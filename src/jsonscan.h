@@ -0,0 +1,60 @@
+/**
+ * \file jsonscan.h
+ * \brief Definitions for the structural scanner of JSON documents.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_JSONSCAN_H
+#define __GTASKS_JSONSCAN_H
+
+#include <config.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+
+
+/* The structural index of a JSON document holds the offsets of the quotes
+   that begin and end its strings and of the braces, brackets, colons, and
+   commas outside its strings, in the order they appear in. */
+typedef struct
+{
+	guint32 *positions;
+	gsize   count;
+	gsize   allocated;
+} json_index_t;
+
+
+/*
+ * Choose the scanner that is used for a requested scanner on this
+ * processor.
+ */
+json_scanner_t get_json_scanner( json_scanner_t requested );
+
+/*
+ * Build the structural index of a JSON document.
+ */
+gboolean scan_json_structure( json_scanner_t scanner, const gchar *json,
+							  gsize length, json_index_t *index );
+
+/*
+ * Free the offsets of a structural index.
+ */
+void free_json_index( json_index_t *index );
+
+
+#endif /* __GTASKS_JSONSCAN_H */
@@ -0,0 +1,252 @@
+/**
+ * \file jsonstream.c
+ * \brief Incremental decoding of JSON responses as they are received.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "jsonstream.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+
+/**
+ * Create a JSON stream that hands the objects of a top-level array to a
+ * handler as soon as each object is complete.
+ * @param array_name [in] Name of the top-level member that holds the array,
+ *        such as "items".
+ * @param handler [in] Function that receives each object in the array.
+ * @param handler_data [in] User data for the handler.
+ * @return New JSON stream.
+ */
+json_stream_t*
+create_json_stream( const gchar *array_name, json_element_handler handler,
+					gpointer handler_data )
+{
+	json_stream_t *stream;
+
+	stream = g_new0( json_stream_t, 1 );
+	stream->array_name   = g_strdup( array_name );
+	stream->handler      = handler;
+	stream->handler_data = handler_data;
+	stream->key          = g_string_new( NULL );
+	stream->element      = g_string_new( NULL );
+	stream->document     = g_string_new( NULL );
+
+	return( stream );
+}
+
+
+
+/**
+ * Destroy a JSON stream.
+ * @param stream [out] The JSON stream that is to be destroyed.
+ * @return Nothing.
+ */
+void
+destroy_json_stream( json_stream_t *stream )
+{
+	if( stream != NULL )
+	{
+		g_free( stream->array_name );
+		g_string_free( stream->key, TRUE );
+		g_string_free( stream->element, TRUE );
+		g_string_free( stream->document, TRUE );
+		g_free( stream );
+	}
+}
+
+
+
+/**
+ * Feed a character inside a JSON string to the stream.
+ * @param stream [in/out] JSON stream.
+ * @param character [in] The character.
+ * @return Nothing.
+ */
+STATIC void
+feed_json_string_character( json_stream_t *stream, gchar character )
+{
+	gboolean end_of_string = FALSE;
+
+	if( stream->escaped == TRUE )
+	{
+		stream->escaped = FALSE;
+	}
+	else if( character == '\\' )
+	{
+		stream->escaped = TRUE;
+	}
+	else if( character == '"' )
+	{
+		end_of_string     = TRUE;
+		stream->in_string = FALSE;
+	}
+
+	if( stream->in_element == TRUE )
+	{
+		g_string_append_c( stream->element, character );
+	}
+	else
+	{
+		if( ( stream->in_key == TRUE ) && ( end_of_string == FALSE ) )
+		{
+			g_string_append_c( stream->key, character );
+		}
+		if( stream->in_array == FALSE )
+		{
+			g_string_append_c( stream->document, character );
+		}
+	}
+	if( end_of_string == TRUE )
+	{
+		stream->in_key = FALSE;
+	}
+}
+
+
+
+/**
+ * Feed a character outside JSON strings to the stream.  Objects in the
+ * streamed array are collected in the element buffer and handed to the
+ * handler when they close; other array elements and the separators between
+ * them are dropped; everything else is kept in the document.
+ * @param stream [in/out] JSON stream.
+ * @param character [in] The character.
+ * @return Nothing.
+ */
+STATIC void
+feed_json_structure_character( json_stream_t *stream, gchar character )
+{
+	switch( character )
+	{
+		case '"':
+			stream->in_string = TRUE;
+			/* A string that follows '{' or ',' in the top-level object is a
+			   member name. */
+			if( ( stream->depth == 1 ) && ( stream->expect_key == TRUE ) )
+			{
+				stream->in_key     = TRUE;
+				stream->expect_key = FALSE;
+				g_string_truncate( stream->key, 0 );
+			}
+			break;
+
+		case '{':
+		case '[':
+			stream->depth++;
+			if( ( stream->depth == 1 ) && ( character == '{' ) )
+			{
+				stream->expect_key = TRUE;
+			}
+			/* The streamed array begins. */
+			else if( ( stream->depth == 2 ) && ( character == '[' ) &&
+					 ( g_strcmp0( stream->key->str,
+								  stream->array_name ) == 0 ) )
+			{
+				g_string_append_c( stream->document, character );
+				stream->in_array = TRUE;
+				return;
+			}
+			/* An object in the streamed array begins. */
+			else if( ( stream->depth == 3 ) && ( character == '{' ) &&
+					 ( stream->in_array == TRUE ) )
+			{
+				stream->in_element = TRUE;
+				g_string_truncate( stream->element, 0 );
+			}
+			break;
+
+		case '}':
+		case ']':
+			if( stream->depth > 0 )
+			{
+				stream->depth--;
+			}
+			/* An object in the streamed array is complete. */
+			if( ( stream->depth == 2 ) && ( stream->in_element == TRUE ) )
+			{
+				g_string_append_c( stream->element, character );
+				stream->in_element = FALSE;
+				stream->handler( stream->element->str, stream->element->len,
+								 stream->handler_data );
+				return;
+			}
+			/* The streamed array ends. */
+			else if( ( stream->depth == 1 ) && ( stream->in_array == TRUE ) )
+			{
+				stream->in_array = FALSE;
+			}
+			break;
+
+		case ',':
+			if( stream->depth == 1 )
+			{
+				stream->expect_key = TRUE;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	if( stream->in_element == TRUE )
+	{
+		g_string_append_c( stream->element, character );
+	}
+	else if( stream->in_array == FALSE )
+	{
+		g_string_append_c( stream->document, character );
+	}
+}
+
+
+
+/**
+ * Feed a chunk of the JSON document to the stream.  The chunks may be split
+ * anywhere in the document.
+ * @param stream [in/out] JSON stream.
+ * @param data [in] Chunk of the document.
+ * @param length [in] Number of bytes in the chunk.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: json_stream).
+ */
+void
+feed_json_stream( json_stream_t *stream, const gchar *data, gsize length )
+{
+	gsize idx;
+
+	for( idx = 0; idx < length; idx++ )
+	{
+		if( stream->in_string == TRUE )
+		{
+			feed_json_string_character( stream, data[ idx ] );
+		}
+		else
+		{
+			feed_json_structure_character( stream, data[ idx ] );
+		}
+	}
+	stream->received += length;
+}
+
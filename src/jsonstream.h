@@ -0,0 +1,80 @@
+/**
+ * \file jsonstream.h
+ * \brief Definitions for incremental decoding of JSON responses.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_JSONSTREAM_H
+#define __GTASKS_JSONSTREAM_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* Function that receives each element of the streamed array as a
+   zero-terminated JSON object. */
+typedef void (*json_element_handler) ( const gchar *element, gsize length,
+									   gpointer user_data );
+
+
+/* A JSON stream splits a JSON document that arrives in chunks.  The objects
+   in one of the document's top-level arrays are handed to a handler as soon
+   as they are complete; the rest of the document is kept with the array
+   left empty. */
+typedef struct
+{
+	gchar                *array_name;
+	json_element_handler handler;
+	gpointer             handler_data;
+
+	guint                depth;
+	gboolean             in_string;
+	gboolean             escaped;
+	gboolean             expect_key;
+	gboolean             in_key;
+	gboolean             in_array;
+	gboolean             in_element;
+	GString              *key;
+	GString              *element;
+	GString              *document;
+	gsize                received;
+} json_stream_t;
+
+
+/*
+ * Create a JSON stream that hands the objects of a top-level array to a
+ * handler.
+ */
+json_stream_t *create_json_stream( const gchar *array_name,
+								   json_element_handler handler,
+								   gpointer handler_data );
+
+/*
+ * Destroy a JSON stream.
+ */
+void destroy_json_stream( json_stream_t *stream );
+
+/*
+ * Feed a chunk of the JSON document to the stream.
+ */
+void feed_json_stream( json_stream_t *stream, const gchar *data,
+					   gsize length );
+
+
+#endif /* __GTASKS_JSONSTREAM_H */
@@ -0,0 +1,453 @@
+/**
+ * \file latency.c
+ * \brief Latency measurements of the requests to Google.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "latency.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Path segments longer than this are IDs, which are left out of the
+   endpoint names. */
+#define MAX_ENDPOINT_SEGMENT_LENGTH 20
+
+
+/* Names of the phases of a request. */
+static const gchar *latency_phase_names[ LATENCY_PHASES ] =
+{
+	"dns", "connect", "tls", "first byte", "total", "decode"
+};
+
+/* Percentiles that are reported for each phase. */
+static const gdouble reported_percentiles[ ] =
+{
+	50.0, 90.0, 99.0, 99.9, 100.0
+};
+
+
+
+/**
+ * Find the bucket of a histogram that counts a value.  Values below
+ * \a HISTOGRAM_SUB_BUCKETS have a bucket each; larger values share buckets
+ * whose width doubles for each power of two, so that each bucket spans less
+ * than 1/32 of its values.
+ * @param value [in] Value in microseconds.
+ * @return Index of the bucket.
+ */
+STATIC guint
+get_histogram_index( guint64 value )
+{
+	guint shift = 0;
+
+	value = MIN( value, HISTOGRAM_MAX_VALUE );
+	while( ( value >> shift ) >= HISTOGRAM_SUB_BUCKETS )
+	{
+		shift++;
+	}
+	if( shift == 0 )
+	{
+		return( (guint) value );
+	}
+
+	return( HISTOGRAM_SUB_BUCKETS + ( shift - 1 ) * HISTOGRAM_SUB_BUCKETS / 2
+			+ (guint) ( value >> shift ) - HISTOGRAM_SUB_BUCKETS / 2 );
+}
+
+
+
+/**
+ * Get the highest value that a histogram bucket counts.
+ * @param index [in] Index of the bucket.
+ * @return Highest value of the bucket in microseconds.
+ */
+STATIC guint64
+get_histogram_bucket_value( guint index )
+{
+	guint shift;
+	guint sub_bucket;
+
+	if( index < HISTOGRAM_SUB_BUCKETS )
+	{
+		return( index );
+	}
+	shift      = ( index - HISTOGRAM_SUB_BUCKETS ) /
+		( HISTOGRAM_SUB_BUCKETS / 2 ) + 1;
+	sub_bucket = ( index - HISTOGRAM_SUB_BUCKETS ) %
+		( HISTOGRAM_SUB_BUCKETS / 2 ) + HISTOGRAM_SUB_BUCKETS / 2;
+
+	return( ( ( (guint64) sub_bucket + 1 ) << shift ) - 1 );
+}
+
+
+
+/**
+ * Count a value in a histogram.
+ * @param histogram [in/out] Histogram.
+ * @param value [in] Value in microseconds.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: latency_histogram).
+ */
+void
+record_histogram_value( latency_histogram_t *histogram, gint64 value )
+{
+	value = MAX( value, 0 );
+	histogram->counts[ get_histogram_index( value ) ]++;
+	if( ( histogram->total_count == 0 ) || ( value < histogram->min ) )
+	{
+		histogram->min = value;
+	}
+	histogram->max = MAX( histogram->max, value );
+	histogram->total_count++;
+}
+
+
+
+/**
+ * Get the value below which a percentage of the values in a histogram lie.
+ * The value is accurate to the width of its bucket.
+ * @param histogram [in] Histogram.
+ * @param percentile [in] Percentage between 0 and 100.
+ * @return Value in microseconds, or 0 if the histogram is empty.
+ * Test: unit test (test-gtasks.c: latency_histogram).
+ */
+gint64
+get_histogram_percentile( const latency_histogram_t *histogram,
+						  gdouble percentile )
+{
+	guint64 target;
+	guint64 count = 0;
+	guint   index;
+
+	if( histogram->total_count == 0 )
+	{
+		return( 0 );
+	}
+	target = (guint64) ( percentile / 100.0 * histogram->total_count + 0.5 );
+	target = CLAMP( target, 1, histogram->total_count );
+	for( index = 0; index < HISTOGRAM_BUCKETS; index++ )
+	{
+		count += histogram->counts[ index ];
+		if( count >= target )
+		{
+			return( CLAMP( (gint64) get_histogram_bucket_value( index ),
+						   histogram->min, histogram->max ) );
+		}
+	}
+
+	return( histogram->max );
+}
+
+
+
+/**
+ * Create an empty set of latency statistics.
+ * @return New latency statistics.
+ */
+latency_stats_t*
+create_latency_stats( void )
+{
+	latency_stats_t *stats;
+
+	stats = g_new( latency_stats_t, 1 );
+	stats->endpoints = g_hash_table_new_full( g_str_hash, g_str_equal,
+											  g_free, g_free );
+
+	return( stats );
+}
+
+
+
+/**
+ * Destroy a set of latency statistics.
+ * @param stats [out] Latency statistics, or \a NULL.
+ * @return Nothing.
+ */
+void
+destroy_latency_stats( latency_stats_t *stats )
+{
+	if( stats != NULL )
+	{
+		g_hash_table_destroy( stats->endpoints );
+		g_free( stats );
+	}
+}
+
+
+
+/**
+ * Name the endpoint of a request after its method, host, and path.  The
+ * query is left out, and so are the IDs in the path, so that, for example,
+ * the requests for the tasks of all task lists share one endpoint.
+ * @param method [in] HTTP method of the request.
+ * @param url [in] URL of the request.
+ * @return Name of the endpoint.
+ * Test: unit test (test-gtasks.c: latency_histogram).
+ */
+gchar*
+get_latency_endpoint_name( const gchar *method, const gchar *url )
+{
+	GString     *name;
+	const gchar *location;
+	const gchar *segment_end;
+
+	name = g_string_new( method );
+	g_string_append_c( name, ' ' );
+	location = strstr( url, "://" );
+	location = ( location != NULL ) ? location + strlen( "://" ) : url;
+	while( ( *location != '\0' ) && ( *location != '?' ) )
+	{
+		segment_end = location + strcspn( location, "/?" );
+		if( segment_end - location > MAX_ENDPOINT_SEGMENT_LENGTH )
+		{
+			g_string_append_c( name, '*' );
+		}
+		else
+		{
+			g_string_append_len( name, location, segment_end - location );
+		}
+		if( *segment_end == '/' )
+		{
+			g_string_append_c( name, '/' );
+			segment_end++;
+		}
+		location = segment_end;
+	}
+
+	return( g_string_free( name, FALSE ) );
+}
+
+
+
+/**
+ * Find the statistics of an endpoint, adding them if they do not exist.
+ * @param stats [in/out] Latency statistics.
+ * @param method [in] HTTP method of the request.
+ * @param url [in] URL of the request.
+ * @return Statistics of the request's endpoint.
+ */
+STATIC latency_endpoint_t*
+get_latency_endpoint( latency_stats_t *stats, const gchar *method,
+					  const gchar *url )
+{
+	gchar              *name;
+	latency_endpoint_t *endpoint;
+
+	name = get_latency_endpoint_name( method, url );
+	endpoint = g_hash_table_lookup( stats->endpoints, name );
+	if( endpoint == NULL )
+	{
+		endpoint = g_new0( latency_endpoint_t, 1 );
+		g_hash_table_insert( stats->endpoints, name, endpoint );
+	}
+	else
+	{
+		g_free( name );
+	}
+
+	return( endpoint );
+}
+
+
+
+/**
+ * Get a percentile of the latencies of a phase of the requests to an
+ * endpoint.
+ * @param stats [in] Latency statistics, or \a NULL.
+ * @param method [in] HTTP method of the request.
+ * @param url [in] URL of the request.
+ * @param phase [in] Phase of the requests.
+ * @param percentile [in] Percentage between 0 and 100.
+ * @param min_count [in] Smallest number of measurements that the percentile
+ *        is based on.
+ * @return Percentile in microseconds, or -1 if there are fewer than
+ *         \a min_count measurements.
+ */
+gint64
+get_endpoint_latency( const latency_stats_t *stats, const gchar *method,
+					  const gchar *url, latency_phase_t phase,
+					  gdouble percentile, guint64 min_count )
+{
+	gchar                    *name;
+	const latency_endpoint_t *endpoint = NULL;
+	gint64                   latency   = -1;
+
+	if( stats != NULL )
+	{
+		name = get_latency_endpoint_name( method, url );
+		endpoint = g_hash_table_lookup( stats->endpoints, name );
+		g_free( name );
+	}
+	if( ( endpoint != NULL ) &&
+		( endpoint->phases[ phase ].total_count >= MAX( min_count, 1 ) ) )
+	{
+		latency = get_histogram_percentile( &endpoint->phases[ phase ],
+											percentile );
+	}
+
+	return( latency );
+}
+
+
+
+/**
+ * Record the latencies of a finished request, as measured by CURL.  The DNS,
+ * connect, and TLS phases are only recorded when they took place, that is,
+ * when the request did not reuse a connection.  The first-byte phase runs
+ * from when the connection is ready until the first byte of the response
+ * arrives, which is mostly the time that Google takes to respond.
+ * @param stats [in/out] Latency statistics, or \a NULL if latencies are not
+ *        recorded.
+ * @param method [in] HTTP method of the request.
+ * @param url [in] URL of the request.
+ * @param curl [in] CURL handle that performed the request.
+ * @return Nothing.
+ */
+void
+record_request_latency( latency_stats_t *stats, const gchar *method,
+						const gchar *url, CURL *curl )
+{
+	latency_endpoint_t *endpoint;
+	curl_off_t         name_lookup    = 0;
+	curl_off_t         connect        = 0;
+	curl_off_t         app_connect    = 0;
+	curl_off_t         start_transfer = 0;
+	curl_off_t         total          = 0;
+
+	if( stats == NULL )
+	{
+		return;
+	}
+	curl_easy_getinfo( curl, CURLINFO_NAMELOOKUP_TIME_T, &name_lookup );
+	curl_easy_getinfo( curl, CURLINFO_CONNECT_TIME_T, &connect );
+	curl_easy_getinfo( curl, CURLINFO_APPCONNECT_TIME_T, &app_connect );
+	curl_easy_getinfo( curl, CURLINFO_STARTTRANSFER_TIME_T, &start_transfer );
+	curl_easy_getinfo( curl, CURLINFO_TOTAL_TIME_T, &total );
+
+	endpoint = get_latency_endpoint( stats, method, url );
+	endpoint->requests++;
+	if( name_lookup > 0 )
+	{
+		record_histogram_value( &endpoint->phases[ LATENCY_DNS ],
+								name_lookup );
+	}
+	if( connect > name_lookup )
+	{
+		record_histogram_value( &endpoint->phases[ LATENCY_CONNECT ],
+								connect - name_lookup );
+	}
+	if( app_connect > connect )
+	{
+		record_histogram_value( &endpoint->phases[ LATENCY_TLS ],
+								app_connect - connect );
+	}
+	if( start_transfer > 0 )
+	{
+		record_histogram_value( &endpoint->phases[ LATENCY_FIRST_BYTE ],
+								start_transfer -
+								MAX( MAX( name_lookup, connect ),
+									 app_connect ) );
+	}
+	record_histogram_value( &endpoint->phases[ LATENCY_TOTAL ], total );
+}
+
+
+
+/**
+ * Record the time spent decoding the response of a request.
+ * @param stats [in/out] Latency statistics, or \a NULL if latencies are not
+ *        recorded.
+ * @param method [in] HTTP method of the request.
+ * @param url [in] URL of the request.
+ * @param decode_time [in] Decoding time in microseconds.
+ * @return Nothing.
+ */
+void
+record_decode_latency( latency_stats_t *stats, const gchar *method,
+					   const gchar *url, gint64 decode_time )
+{
+	latency_endpoint_t *endpoint;
+
+	if( stats != NULL )
+	{
+		endpoint = get_latency_endpoint( stats, method, url );
+		record_histogram_value( &endpoint->phases[ LATENCY_DECODE ],
+								decode_time );
+	}
+}
+
+
+
+/**
+ * Write a table of the latency percentiles of each endpoint.
+ * @param stats [in] Latency statistics.
+ * @param file [in/out] File that the table is written to.
+ * @return Nothing.
+ */
+void
+write_latency_report( const latency_stats_t *stats, FILE *file )
+{
+	GList                     *names;
+	GList                     *name;
+	const latency_endpoint_t  *endpoint;
+	const latency_histogram_t *histogram;
+	guint                     phase;
+	guint                     percentile_idx;
+
+	names = g_list_sort( g_hash_table_get_keys( stats->endpoints ),
+						 (GCompareFunc) g_strcmp0 );
+	for( name = names; name != NULL; name = name->next )
+	{
+		endpoint = g_hash_table_lookup( stats->endpoints, name->data );
+		g_fprintf( file, "%s (%u requests), milliseconds:\n",
+				   (const gchar*) name->data, endpoint->requests );
+		g_fprintf( file, "  %-10s %6s %9s %9s %9s %9s %9s\n", "", "count",
+				   "p50", "p90", "p99", "p99.9", "max" );
+		for( phase = 0; phase < LATENCY_PHASES; phase++ )
+		{
+			histogram = &endpoint->phases[ phase ];
+			if( histogram->total_count == 0 )
+			{
+				continue;
+			}
+			g_fprintf( file, "  %-10s %6u", latency_phase_names[ phase ],
+					   (guint) histogram->total_count );
+			for( percentile_idx = 0;
+				 percentile_idx < G_N_ELEMENTS( reported_percentiles );
+				 percentile_idx++ )
+			{
+				g_fprintf( file, " %9.3f", get_histogram_percentile(
+							   histogram,
+							   reported_percentiles[ percentile_idx ] ) /
+						   1000.0 );
+			}
+			g_fprintf( file, "\n" );
+		}
+	}
+	g_list_free( names );
+}
@@ -0,0 +1,137 @@
+/**
+ * \file ratelimit.c
+ * \brief Definitions for latency measurements of requests.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_LATENCY_H
+#define __GTASKS_LATENCY_H
+
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+#include <curl/curl.h>
+
+
+/* Number of histogram buckets per power of two of the values, which
+   determines the precision of the histograms. */
+#define HISTOGRAM_SUB_BUCKETS 64
+/* Largest value that a histogram distinguishes, about 50 days in
+   microseconds. */
+#define HISTOGRAM_MAX_VALUE ( ( G_GUINT64_CONSTANT( 1 ) << 42 ) - 1 )
+/* Number of buckets in a histogram. */
+#define HISTOGRAM_BUCKETS \
+	( HISTOGRAM_SUB_BUCKETS + 36 * HISTOGRAM_SUB_BUCKETS / 2 )
+
+
+/* A high-dynamic-range histogram of latencies in microseconds.  The buckets
+   are linear up to HISTOGRAM_SUB_BUCKETS and logarithmic above, so the
+   histogram spans microseconds to days with a relative error of about 3%
+   in a fixed amount of memory. */
+typedef struct
+{
+	guint32 counts[ HISTOGRAM_BUCKETS ];
+	guint64 total_count;
+	gint64  min;
+	gint64  max;
+} latency_histogram_t;
+
+
+/* The phases of a request that are measured. */
+typedef enum
+{
+	LATENCY_DNS,
+	LATENCY_CONNECT,
+	LATENCY_TLS,
+	LATENCY_FIRST_BYTE,
+	LATENCY_TOTAL,
+	LATENCY_DECODE,
+	LATENCY_PHASES
+} latency_phase_t;
+
+
+/* The latencies of the requests to one endpoint. */
+typedef struct
+{
+	guint               requests;
+	latency_histogram_t phases[ LATENCY_PHASES ];
+} latency_endpoint_t;
+
+
+/* Latencies of all requests in a session, by endpoint name. */
+typedef struct
+{
+	GHashTable *endpoints;
+} latency_stats_t;
+
+
+/*
+ * Count a value in a histogram.
+ */
+void record_histogram_value( latency_histogram_t *histogram, gint64 value );
+
+/*
+ * Get the value below which a percentage of the values in a histogram lie.
+ */
+gint64 get_histogram_percentile( const latency_histogram_t *histogram,
+								 gdouble percentile );
+
+/*
+ * Create an empty set of latency statistics.
+ */
+latency_stats_t *create_latency_stats( void );
+
+/*
+ * Destroy a set of latency statistics.
+ */
+void destroy_latency_stats( latency_stats_t *stats );
+
+/*
+ * Name the endpoint of a request.
+ */
+gchar *get_latency_endpoint_name( const gchar *method, const gchar *url );
+
+/*
+ * Get a percentile of the latencies of a phase of the requests to an
+ * endpoint.
+ */
+gint64 get_endpoint_latency( const latency_stats_t *stats,
+							 const gchar *method, const gchar *url,
+							 latency_phase_t phase, gdouble percentile,
+							 guint64 min_count );
+
+/*
+ * Record the latencies of a finished request, as measured by CURL.
+ */
+void record_request_latency( latency_stats_t *stats, const gchar *method,
+							 const gchar *url, CURL *curl );
+
+/*
+ * Record the time spent decoding the response of a request.
+ */
+void record_decode_latency( latency_stats_t *stats, const gchar *method,
+							const gchar *url, gint64 decode_time );
+
+/*
+ * Write a table of the latency percentiles of each endpoint.
+ */
+void write_latency_report( const latency_stats_t *stats, FILE *file );
+
+
+#endif /* __GTASKS_LATENCY_H */
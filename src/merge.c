@@ -112,20 +112,6 @@ struct problem_detection_t
 
 
 
-/**
- * Copy the contents of a GDateTime structure to a new one by adding "0" to
- * the old one.
- * @param src [in] Original GDateTime structure.
- * @return New GDateTime structure.
- */
-STATIC GDateTime*
-copy_gdatetime( const GDateTime *src )
-{
-	GDateTime *new_gdatetime = g_date_time_add_years( (GDateTime*) src, 0 );
-	return( new_gdatetime );
-}
-
-
 
 
 
@@ -147,20 +133,18 @@ STATIC void
 copy_google_link( gpointer link_ptr, gpointer list_ptr )
 {
 	GSList       **link_list = list_ptr;
-	gtask_link_t *link       = link_ptr;
-	gtask_link_t *new_link   = g_new( gtask_link_t, 1 );
+	gtask_link_t *new_link;
 
-	new_link->type        = g_strdup( link->type );
-	new_link->description = g_strdup( link->description );
-	new_link->link        = g_strdup( link->link );
-	*link_list = g_slist_append( *link_list, link_ptr );
+	new_link = copy_schema_record( &gtask_link_schema, link_ptr );
+	*link_list = g_slist_append( *link_list, new_link );
 }
 
 
 
 /**
  * Convert a string value with the status of a task in Google-speak to an
- * enumerated value.
+ * enumerated value.  Decoded statuses are interned, so they are compared by
+ * pointer before they are compared by value.
  * @param status_string [in] Status in Google's format.
  * @return Status as enumeration, or \a STATUS_NEEDS_ACTION if the Google
  *         string is unexpected.
@@ -170,11 +154,19 @@ google_string_to_status( const gchar *status_string )
 {
 	enum status_t status;
 
-	if( g_strcmp0( status_string, "needsAction" ) == 0 )
+	if( status_string == google_status_needs_action )
+	{
+	    status = STATUS_NEEDS_ACTION;
+	}
+	else if( status_string == google_status_completed )
+	{
+	    status = STATUS_COMPLETED;
+	}
+	else if( g_strcmp0( status_string, google_status_needs_action ) == 0 )
 	{
 	    status = STATUS_NEEDS_ACTION;
 	}
-	else if( g_strcmp0( status_string, "completed" ) == 0 )
+	else if( g_strcmp0( status_string, google_status_completed ) == 0 )
 	{
 	    status = STATUS_COMPLETED;
 	}
@@ -195,6 +187,9 @@ google_string_to_status( const gchar *status_string )
  * Create a new Google Task structure based on the Google Task information.
  * This includes the initialization of the following fields which are not
  * supported natively by the Google Tasks format:  sequence, organizer.
+ * The link types of the attachments are borrowed from the session's string
+ * pool, like those of the Google Task, so the new task must not outlive the
+ * session that read the Google Task.
  * @param google_task [in] The Google Task information retrieved from the
  *        Google Tasks.
  * @return Initialized unified_task structure.
@@ -216,17 +211,17 @@ create_new_google_task( gtask_t *google_task )
 	/* Copy the URL. */
 	new_task->url = g_strdup( google_task->self_link );
 	/* Copy the update time. */
-	new_task->last_modified = copy_gdatetime( google_task->updated );
+	new_task->last_modified = google_task->updated;
 	/* If a child task, copy the parent. */
 	new_task->related = g_slist_append( new_task->related,
 										g_strdup( google_task->parent ) );
 	/* Copy the position in the list. */
 	new_task->x_google_task_position = g_strdup( google_task->position );
 	/* Copy the due date. */
-	new_task->due = copy_gdatetime( google_task->due );
+	new_task->due = google_task->due;
 	/* Copy the status and completed fields. */
 	new_task->status = google_string_to_status( google_task->status );
-	new_task->completed = copy_gdatetime( google_task->completed );
+	new_task->completed = google_task->completed;
 	/* Copy the link list as attachments. */
 	g_slist_foreach( google_task->links, copy_google_link, &new_task->attach );
 	/* Set "deleted" and "hidden" flags. */
@@ -73,7 +73,9 @@ typedef struct
 	gchar                       *x_google_task_id;
 
 	gint                        seq;
-	GDateTime                   *last_modified;
+	/* Times are microseconds since the Unix epoch in UTC, or
+	   NO_TIMESTAMP. */
+	gint64                      last_modified;
 
 	GSList                      *comment;
 	gchar                       *description;
@@ -88,12 +90,12 @@ typedef struct
 	gchar                       *location;
 	struct geo_location_t       geo;
 
-	GDateTime                   *created;
-	GDateTime                   *dtstamp;
-	GDateTime                   *dtstart;
-	GDateTime                   *due;
+	gint64                      created;
+	gint64                      dtstamp;
+	gint64                      dtstart;
+	gint64                      due;
 	GDateTime                   *duration;
-	GDateTime                   *completed;
+	gint64                      completed;
 
 	GSList                      *related;
 	gchar                       *x_google_task_position;
@@ -0,0 +1,1920 @@
+/**
+ * \file multirequest.c
+ * \brief Run concurrent requests to the Google Tasks API.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include <glib/gprintf.h>
+#include "gtasks2ical.h"
+#include "postform.h"
+#include "session.h"
+#include "multirequest.h"
+#include "batch.h"
+#include "ratelimit.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Longest time to wait for socket activity before checking again, in
+   milliseconds. */
+#define ENGINE_POLL_TIMEOUT 1000
+
+/* Number of requests to an endpoint that must have been measured before
+   the requests to the endpoint are hedged. */
+#define HEDGE_MIN_SAMPLES 20
+
+
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+/* Requests are finished before the function is defined. */
+STATIC void finish_api_request( request_engine_t *engine,
+								api_request_t *request );
+
+
+
+/**
+ * Determine whether the CURL library supports HTTP/2.
+ * @return \a TRUE if HTTP/2 is supported, or \a FALSE otherwise.
+ */
+STATIC gboolean
+is_http2_available( void )
+{
+	curl_version_info_data *version_info;
+
+	version_info = curl_version_info( CURLVERSION_NOW );
+
+	return( ( version_info->features & CURL_VERSION_HTTP2 ) != 0 );
+}
+
+
+
+/**
+ * Set up the multi handle either for multiplexing all requests as streams on
+ * a single HTTP/2 connection, or for spreading the requests over a pool of
+ * HTTP/1.1 connections without pipelining.
+ * @param engine [in/out] Request engine.
+ * @param multiplex [in] \a TRUE for HTTP/2 multiplexing, or \a FALSE for
+ *        HTTP/1.1 connection pooling.
+ * @return Nothing.
+ */
+STATIC void
+set_engine_transport( request_engine_t *engine, gboolean multiplex )
+{
+	engine->multiplex = multiplex;
+	if( multiplex == TRUE )
+	{
+		curl_multi_setopt( engine->multi, CURLMOPT_PIPELINING,
+						   CURLPIPE_MULTIPLEX );
+		curl_multi_setopt( engine->multi, CURLMOPT_MAX_CONCURRENT_STREAMS,
+						   (long) global_config.http2_max_streams );
+		curl_multi_setopt( engine->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+						   1L );
+	}
+	else
+	{
+		curl_multi_setopt( engine->multi, CURLMOPT_PIPELINING,
+						   CURLPIPE_NOTHING );
+		curl_multi_setopt( engine->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+						   (long) ( engine->concurrency != NULL ?
+									engine->concurrency->max_limit :
+									engine->max_in_flight ) );
+	}
+}
+
+
+
+/**
+ * Get the name of the file that keeps the adapted number of requests in
+ * flight for the Gmail user between runs.  Like the response cache, the
+ * file is in the user's cache directory.
+ * @return Newly allocated file name, or \a NULL if the cache directory
+ *         cannot be created.
+ */
+STATIC gchar*
+get_concurrency_file_name( void )
+{
+	gchar *directory;
+	gchar *hash;
+	gchar *base_name;
+	gchar *file_name = NULL;
+
+	directory = g_build_filename( g_get_user_cache_dir( ), "gtasks2ical",
+								  NULL );
+	if( g_mkdir_with_parents( directory, 0700 ) == 0 )
+	{
+		hash = g_compute_checksum_for_string(
+			G_CHECKSUM_SHA1, global_config.gmail_username != NULL ?
+			global_config.gmail_username : "", -1 );
+		base_name = g_strconcat( "concurrency-", hash, NULL );
+		file_name = g_build_filename( directory, base_name, NULL );
+		g_free( base_name );
+		g_free( hash );
+	}
+	g_free( directory );
+
+	return( file_name );
+}
+
+
+
+/**
+ * Create a request engine for a session.
+ * @param session [in] Session whose share and options the engine's CURL
+ *        handles use.
+ * @param max_in_flight [in] Largest number of simultaneous requests.
+ * @return New request engine, or \a NULL if CURL could not be initialized.
+ */
+request_engine_t*
+create_request_engine( gtasks_session_t *session, guint max_in_flight )
+{
+	request_engine_t *engine;
+	gchar            *cache_directory;
+	gchar            *concurrency_file;
+
+	engine = g_new0( request_engine_t, 1 );
+	engine->multi = curl_multi_init( );
+	if( engine->multi == NULL )
+	{
+		g_free( engine );
+		engine = NULL;
+	}
+	else
+	{
+		engine->session       = session;
+		engine->max_in_flight = MAX( max_in_flight, 1 );
+		/* Resume from the number of requests in flight that was learned
+		   for the account in the previous run. */
+		if( global_config.adaptive_concurrency == TRUE )
+		{
+			concurrency_file = get_concurrency_file_name( );
+			engine->concurrency = create_concurrency_limiter(
+				engine->max_in_flight, global_config.max_parallel_requests,
+				concurrency_file );
+			g_free( concurrency_file );
+			engine->max_in_flight =
+				get_concurrency_limit( engine->concurrency );
+		}
+		g_queue_init( &engine->pending );
+		g_queue_init( &engine->active );
+		g_queue_init( &engine->completed );
+		engine->buffers   = create_buffer_pool(
+			( engine->concurrency != NULL ?
+			  engine->concurrency->max_limit : engine->max_in_flight ) + 1 );
+		engine->limiter   = create_rate_limiter( global_config.request_rate,
+												 global_config.request_burst );
+		engine->max_batch = MIN( global_config.batch_requests,
+								 MAX_BATCH_REQUESTS );
+		/* Keep the responses in the user's cache directory. */
+		if( global_config.response_cache == TRUE )
+		{
+			cache_directory = g_build_filename( g_get_user_cache_dir( ),
+												"gtasks2ical", NULL );
+			engine->cache = create_response_cache( cache_directory );
+			g_free( cache_directory );
+		}
+		/* Multiplex the requests if HTTP/2 is enabled and supported. */
+		if( ( global_config.http2 == TRUE ) &&
+			( is_http2_available( ) == FALSE ) &&
+			( global_config.verbose == TRUE ) )
+		{
+			printf( "HTTP/2 is not supported; using HTTP/1.1\n" );
+		}
+		set_engine_transport( engine, ( global_config.http2 == TRUE ) &&
+							  ( is_http2_available( ) == TRUE ) );
+	}
+
+	return( engine );
+}
+
+
+
+/**
+ * Auxiliary function used by \a destroy_request_engine to release an idle
+ * CURL handle.
+ * @param curl_ptr [in] CURL handle.
+ * @param user_data [in] Unused.
+ * @return Nothing.
+ */
+STATIC void
+destroy_idle_handle( gpointer curl_ptr, gpointer user_data )
+{
+	curl_easy_cleanup( (CURL*) curl_ptr );
+}
+
+
+
+/**
+ * Free a request that has been collected from the engine.
+ * @param request [out] The request that is to be destroyed.
+ * @return Nothing.
+ */
+void
+destroy_api_request( api_request_t *request )
+{
+	if( request != NULL )
+	{
+		g_free( request->method );
+		g_free( request->url );
+		g_free( request->body );
+		curl_slist_free_all( request->own_headers );
+		release_pooled_buffer( request->pool, &request->response );
+		g_free( request->cached_etag );
+		g_free( request->cached_body );
+		curl_slist_free_all( request->conditional_headers );
+		g_free( request->compressed_body );
+		curl_slist_free_all( request->body_headers );
+		g_free( request->etag );
+		destroy_json_stream( request->stream );
+		end_cached_response( request->cache_writer, FALSE );
+		g_slist_free_full( request->parts,
+						   (GDestroyNotify) destroy_api_request );
+		g_slist_free_full( request->followers,
+						   (GDestroyNotify) destroy_api_request );
+		g_free( request );
+	}
+}
+
+
+
+/**
+ * Auxiliary function used by \a destroy_request_engine to cancel a request
+ * that is still in the multi handle.
+ * @param request_ptr [in] Pointer to the request.
+ * @param engine_ptr [in] Pointer to the request engine.
+ * @return Nothing.
+ */
+STATIC void
+cancel_api_request( gpointer request_ptr, gpointer engine_ptr )
+{
+	api_request_t    *request = request_ptr;
+	request_engine_t *engine  = engine_ptr;
+
+	if( request->curl != NULL )
+	{
+		curl_multi_remove_handle( engine->multi, request->curl );
+		curl_easy_cleanup( request->curl );
+	}
+	destroy_api_request( request );
+}
+
+
+
+/**
+ * Destroy a request engine.  Requests that have not been collected are
+ * cancelled and freed.
+ * @param engine [out] The engine that is to be destroyed.
+ * @return Nothing.
+ */
+void
+destroy_request_engine( request_engine_t *engine )
+{
+	if( engine != NULL )
+	{
+		g_queue_foreach( &engine->active, cancel_api_request, engine );
+		g_queue_foreach( &engine->pending, cancel_api_request, engine );
+		g_queue_foreach( &engine->completed, cancel_api_request, engine );
+		g_queue_clear( &engine->active );
+		g_queue_clear( &engine->pending );
+		g_queue_clear( &engine->completed );
+
+		g_slist_foreach( engine->idle_handles, destroy_idle_handle, NULL );
+		g_slist_free( engine->idle_handles );
+		curl_multi_cleanup( engine->multi );
+		destroy_response_cache( engine->cache );
+		/* Report how well the response buffers were reused. */
+		if( global_config.verbose == TRUE )
+		{
+			printf( "Response buffers: %u reused, %u allocated\n",
+					engine->buffers->hits, engine->buffers->misses );
+			printf( "Requests repeated: %u\n", engine->retries );
+			printf( "Requests hedged: %u, of which %u were faster\n",
+					engine->hedges, engine->hedge_wins );
+			printf( "Requests that shared a response: %u\n",
+					engine->coalesced );
+			if( engine->concurrency != NULL )
+			{
+				printf( "Requests in flight: at most %u\n",
+						engine->max_in_flight );
+			}
+		}
+		destroy_concurrency_limiter( engine->concurrency );
+		destroy_buffer_pool( engine->buffers );
+		destroy_rate_limiter( engine->limiter );
+		g_free( engine );
+	}
+}
+
+
+
+/**
+ * Find a request in the pending or active queue that an identical GET
+ * request can share a response with.  A streamed request can only share its
+ * response until it begins to receive it.
+ * @param engine [in] Request engine.
+ * @param method [in] HTTP method of the new request.
+ * @param url [in] URL of the new request.
+ * @param headers [in] Request headers of the new request.
+ * @return The request to share the response of, or \a NULL if there is
+ *         none.
+ */
+STATIC api_request_t*
+find_coalescing_leader( const request_engine_t *engine, const gchar *method,
+						const gchar *url, const struct curl_slist *headers )
+{
+	const GList   *queued[ 2 ];
+	const GList   *link;
+	api_request_t *request;
+	guint         queue_idx;
+
+	if( g_strcmp0( method, "GET" ) != 0 )
+	{
+		return( NULL );
+	}
+	queued[ 0 ] = engine->pending.head;
+	queued[ 1 ] = engine->active.head;
+	for( queue_idx = 0; queue_idx < G_N_ELEMENTS( queued ); queue_idx++ )
+	{
+		for( link = queued[ queue_idx ]; link != NULL; link = link->next )
+		{
+			request = link->data;
+			if( ( request->parts == NULL ) && ( request->hedged == NULL ) &&
+				( request->headers == headers ) &&
+				( g_strcmp0( request->method, method ) == 0 ) &&
+				( g_strcmp0( request->url, url ) == 0 ) &&
+				( ( request->stream == NULL ) ||
+				  ( request->stream->received == 0 ) ) )
+			{
+				return( request );
+			}
+		}
+	}
+
+	return( NULL );
+}
+
+
+
+/**
+ * Submit a request to the engine.  The request is queued and started as soon
+ * as the number of requests in flight allows it.  A GET request that is
+ * identical to a request that is already queued or in flight is not sent;
+ * it shares the other request's response and is decoded with its own
+ * decoder.
+ * @param engine [in/out] Request engine.
+ * @param method [in] HTTP method (GET, POST, etc...).
+ * @param url [in] Complete URL of the request.
+ * @param headers [in] Request headers, which must remain valid until the
+ *        request completes.
+ * @param body [in] Body message, or \a NULL.
+ * @param decoder [in] JSON decoder function for the response, or \a NULL
+ *        if the response should not be decoded.
+ * @param decoder_data [in] User data for the decoder function.
+ * @return The submitted request, which remains owned by the engine until it
+ *         is collected.
+ */
+api_request_t*
+submit_api_request( request_engine_t *engine, const gchar *method,
+					const gchar *url, struct curl_slist *headers,
+					const gchar *body, json_decoder_function decoder,
+					gpointer decoder_data )
+{
+	api_request_t *request;
+	api_request_t *leader;
+
+	request = g_new0( api_request_t, 1 );
+	request->method       = g_strdup( method );
+	request->url          = g_strdup( url );
+	request->body         = g_strdup( body );
+	request->headers      = headers;
+	request->decoder      = decoder;
+	request->decoder_data = decoder_data;
+	request->result       = CURLE_OK;
+	request->pool         = engine->buffers;
+	request->strings      = engine->session->strings;
+	/* Ask for the resource only if it differs from the cached response. */
+	if( ( engine->cache != NULL ) && ( g_strcmp0( method, "GET" ) == 0 ) )
+	{
+		request->cache = engine->cache;
+		read_cached_response( engine->cache, url, &request->cached_etag,
+							  &request->cached_body );
+	}
+
+	leader = find_coalescing_leader( engine, method, url, headers );
+	if( leader != NULL )
+	{
+		request->leader   = leader;
+		request->cache    = NULL;
+		leader->followers = g_slist_append( leader->followers, request );
+		engine->coalesced++;
+	}
+	else
+	{
+		g_queue_push_tail( &engine->pending, request );
+	}
+
+	return( request );
+}
+
+
+
+/**
+ * Decode a request's response while it is received.  The objects in one of
+ * the response's top-level arrays are handed to a handler as soon as each
+ * object is complete, and the remainder of the response is decoded with the
+ * request's decoder when the request completes.  The response is never
+ * held in memory as a whole.
+ * @param request [in/out] Request that has been submitted but not started.
+ * @param array_name [in] Name of the array whose objects are streamed.
+ * @param handler [in] Function that receives each object in the array.
+ * @param handler_data [in] User data for the handler.
+ * @return Nothing.
+ */
+void
+stream_api_request( api_request_t *request, const gchar *array_name,
+					json_element_handler handler, gpointer handler_data )
+{
+	destroy_json_stream( request->stream );
+	request->stream = create_json_stream( array_name, handler,
+										  handler_data );
+}
+
+
+
+/**
+ * Decode a request's response with a pull decoder, which fills the
+ * decoder data directly from the tokens of the response, instead of with
+ * the request's decoder, which walks a JSON tree of the response.  The
+ * request may have been submitted without a decoder.
+ * @param request [in/out] Request that has been submitted but not started.
+ * @param decoder [in] Pull decoder, or \a NULL to use the request's decoder.
+ * @return Nothing.
+ */
+void
+pull_api_request( api_request_t *request, json_pull_decoder decoder )
+{
+	request->pull_decoder = decoder;
+}
+
+
+
+/**
+ * Decode a response for the caller, with the request's pull decoder if it
+ * has one.
+ * @param request [in] The request.
+ * @param data [in] Zero-terminated response.
+ * @param length [in] Length of the response.
+ * @return Nothing.
+ */
+STATIC void
+decode_api_response( const api_request_t *request, const gchar *data,
+					 gsize length )
+{
+	if( request->pull_decoder != NULL )
+	{
+		decode_json_pull( data, length, request->strings,
+						  request->pull_decoder, request->decoder_data );
+	}
+	else
+	{
+		decode_json_reply( data, request->decoder, request->decoder_data );
+	}
+}
+
+
+
+/**
+ * Hand a chunk of a response to a request that shares the response.  The
+ * chunk is fed to the request's JSON stream, or added to its response
+ * buffer if the request is not streamed.
+ * @param follower [in/out] Request that shares the response.
+ * @param data [in] Chunk of the response.
+ * @param length [in] Length of the chunk.
+ * @return Nothing.
+ */
+STATIC void
+deliver_to_follower( api_request_t *follower, const gchar *data,
+					 gsize length )
+{
+	if( follower->stream != NULL )
+	{
+		feed_json_stream( follower->stream, data, length );
+	}
+	else
+	{
+		receive_curl_response( data, 1, length, &follower->response );
+	}
+}
+
+
+
+/**
+ * Callback function for a CURL write of a streamed request.  The data is fed
+ * to the request's JSON stream and to the requests that share the response,
+ * and, if the response is cacheable, copied to the response cache.
+ * @param ptr [in] Source of the data from CURL.
+ * @param size [in] The size of each data block.
+ * @param nmemb [in] Number of data blocks.
+ * @param request_ptr [in/out] Pointer to the request.
+ * @return Number of bytes consumed from \a ptr.
+ */
+STATIC size_t
+receive_streamed_response( const char *ptr, size_t size, size_t nmemb,
+						   void *request_ptr )
+{
+	api_request_t *request = request_ptr;
+	gsize         length   = size * nmemb;
+	long          http_status;
+	gint64        decode_start;
+	GSList        *follower;
+
+	/* Error responses are buffered rather than streamed, so that a request
+	   that is repeated has not handed anything to the caller. */
+	curl_easy_getinfo( request->curl, CURLINFO_RESPONSE_CODE, &http_status );
+	if( http_status >= 300 )
+	{
+		return( receive_curl_response( ptr, size, nmemb,
+									   &request->response ) );
+	}
+
+	/* Begin caching the response with the first chunk. */
+	if( ( request->stream->received == 0 ) && ( request->cache != NULL ) &&
+		( request->etag != NULL ) && ( http_status == 200 ) )
+	{
+		request->cache_writer = begin_cached_response( request->cache,
+														request->url,
+														request->etag );
+	}
+	write_cached_response( request->cache_writer, ptr, length );
+	decode_start = g_get_monotonic_time( );
+	feed_json_stream( request->stream, ptr, length );
+	request->decode_time += g_get_monotonic_time( ) - decode_start;
+	for( follower = request->followers; follower != NULL;
+		 follower = follower->next )
+	{
+		deliver_to_follower( follower->data, ptr, length );
+	}
+
+	return( length );
+}
+
+
+
+/**
+ * Callback function for the response headers of a request.  The ETag and the
+ * Retry-After delay of the response are kept in the request, and the
+ * response buffer is enlarged to hold the Content-Length of the response.
+ * @param buffer [in] A complete header line.
+ * @param size [in] The size of each data block.
+ * @param nitems [in] Number of data blocks.
+ * @param request_ptr [in/out] Pointer to the request.
+ * @return Number of bytes in the header line.
+ */
+STATIC size_t
+receive_response_header( const char *buffer, size_t size, size_t nitems,
+						 void *request_ptr )
+{
+	api_request_t *request = request_ptr;
+	gsize         length   = size * nitems;
+	guint64       content_length;
+	gchar         *retry_after;
+
+	if( ( length > strlen( "ETag:" ) ) &&
+		( g_ascii_strncasecmp( buffer, "ETag:", strlen( "ETag:" ) ) == 0 ) )
+	{
+		g_free( request->etag );
+		request->etag = g_strndup( buffer + strlen( "ETag:" ),
+								   length - strlen( "ETag:" ) );
+		g_strstrip( request->etag );
+	}
+	else if( ( length > strlen( "Retry-After:" ) ) &&
+			 ( g_ascii_strncasecmp( buffer, "Retry-After:",
+									strlen( "Retry-After:" ) ) == 0 ) )
+	{
+		retry_after = g_strndup( buffer + strlen( "Retry-After:" ),
+								 length - strlen( "Retry-After:" ) );
+		request->retry_after = MAX( parse_retry_after( retry_after ), 0 );
+		g_free( retry_after );
+	}
+	else if( ( length > strlen( "Content-Length:" ) ) &&
+			 ( g_ascii_strncasecmp( buffer, "Content-Length:",
+									strlen( "Content-Length:" ) ) == 0 ) )
+	{
+		content_length = g_ascii_strtoull(
+			buffer + strlen( "Content-Length:" ), NULL, 10 );
+		if( ( content_length <= MAX_POOL_BUFFER_SIZE ) &&
+			( request->stream == NULL ) )
+		{
+			reserve_write_buffer( &request->response,
+								  request->response.size + content_length );
+		}
+	}
+
+	return( length );
+}
+
+
+
+/**
+ * Determine when a duplicate of a request is sent if the request has not
+ * completed.  Only plain GET requests are hedged, and only once the
+ * latencies of enough requests to the endpoint are known.
+ * @param engine [in] Request engine.
+ * @param request [in] Request that is being started.
+ * @return Monotonic time in microseconds, or 0 if the request is not
+ *         hedged.
+ */
+STATIC gint64
+get_hedge_time( const request_engine_t *engine, const api_request_t *request )
+{
+	gint64 latency;
+
+	if( ( global_config.hedged_requests == FALSE ) ||
+		( g_strcmp0( request->method, "GET" ) != 0 ) ||
+		( request->parts != NULL ) || ( request->hedged != NULL ) )
+	{
+		return( 0 );
+	}
+	latency = get_endpoint_latency( engine->session->latency,
+									request->method, request->url,
+									LATENCY_TOTAL,
+									global_config.hedge_percentile,
+									HEDGE_MIN_SAMPLES );
+
+	return( ( latency >= 0 ) ? request->started + latency : 0 );
+}
+
+
+
+/**
+ * Determine the operation class of a request, whose deadlines apply to it.
+ * GET requests read, and so does a batch request whose parts all read;
+ * other requests write.
+ * @param request [in] The request.
+ * @return \a OPERATION_READ or \a OPERATION_WRITE.
+ */
+STATIC operation_class_t
+get_request_operation( const api_request_t *request )
+{
+	const GSList *part;
+
+	if( request->parts == NULL )
+	{
+		return( g_strcmp0( request->method, "GET" ) == 0 ?
+				OPERATION_READ : OPERATION_WRITE );
+	}
+	for( part = request->parts; part != NULL; part = part->next )
+	{
+		if( g_strcmp0( ( (const api_request_t*) part->data )->method, "GET" )
+			!= 0 )
+		{
+			return( OPERATION_WRITE );
+		}
+	}
+	return( OPERATION_READ );
+}
+
+
+
+/**
+ * Determine whether a request body is sent compressed.  Bodies below the
+ * compression threshold are not worth compressing.  Until the server has
+ * accepted a compressed body, only one request at a time probes it with a
+ * compressed body, and no bodies are compressed once it has refused one.
+ * @param engine [in] Request engine.
+ * @param request [in] Request with a body.
+ * @param length [in] Length of the body in bytes.
+ * @return \a TRUE if the body should be compressed, or \a FALSE otherwise.
+ */
+STATIC gboolean
+is_request_compressible( const request_engine_t *engine,
+						 const api_request_t *request, gsize length )
+{
+	if( ( global_config.compress_requests == FALSE ) ||
+		( length < global_config.compression_threshold ) )
+	{
+		return( FALSE );
+	}
+	switch( engine->compression )
+	{
+		case COMPRESSION_ACCEPTED:
+			return( TRUE );
+		case COMPRESSION_UNKNOWN:
+			return( ( engine->compression_probe == NULL ) ||
+					( engine->compression_probe == request ) );
+		default:
+			return( FALSE );
+	}
+}
+
+
+
+/**
+ * Set a request's body on its CURL handle along with the headers that
+ * describe it.  A large body is compressed with gzip if the server accepts
+ * compressed bodies or if the request probes whether it does.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] Request with a body.
+ * @param curl [in/out] CURL handle of the request.
+ * @return Nothing.
+ */
+STATIC void
+set_request_body( request_engine_t *engine, api_request_t *request,
+				  CURL *curl )
+{
+	gsize             length;
+	struct curl_slist *header;
+
+	length = strlen( request->body );
+	request->compressed = FALSE;
+	if( is_request_compressible( engine, request, length ) == TRUE )
+	{
+		if( request->compressed_body == NULL )
+		{
+			request->compressed_body = compress_request_body(
+				request->body, length, &request->compressed_length );
+		}
+		request->compressed = ( request->compressed_body != NULL );
+	}
+	if( request->compressed == TRUE )
+	{
+		if( engine->compression == COMPRESSION_UNKNOWN )
+		{
+			engine->compression_probe = request;
+		}
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDS, request->compressed_body );
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDSIZE,
+						  (long) request->compressed_length );
+	}
+	else
+	{
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDS, request->body );
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDSIZE, (long) length );
+	}
+
+	/* The headers of a batch request already hold its Content-Type. */
+	curl_slist_free_all( request->body_headers );
+	request->body_headers = NULL;
+	for( header = request->headers; header != NULL; header = header->next )
+	{
+		request->body_headers = curl_slist_append( request->body_headers,
+												   header->data );
+	}
+	if( request->parts == NULL )
+	{
+		request->body_headers = curl_slist_append(
+			request->body_headers, "Content-Type: application/json" );
+	}
+	if( request->compressed == TRUE )
+	{
+		request->body_headers = curl_slist_append( request->body_headers,
+												   "Content-Encoding: gzip" );
+	}
+	curl_easy_setopt( curl, CURLOPT_HTTPHEADER, request->body_headers );
+}
+
+
+
+/**
+ * Set up a CURL handle for a request and add it to the multi handle.  Idle
+ * handles are reused so that the session options are set only once.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The request that is started.
+ * @return Nothing.
+ */
+STATIC void
+start_api_request( request_engine_t *engine, api_request_t *request )
+{
+	CURL              *curl;
+	struct curl_slist *header;
+	gchar             *if_none_match;
+	GSList            *part;
+
+	request->attempts++;
+	request->started    = g_get_monotonic_time( );
+	request->hedge_time = get_hedge_time( engine, request );
+	for( part = request->parts; part != NULL; part = part->next )
+	{
+		( (api_request_t*) part->data )->attempts++;
+	}
+
+	/* Reuse an idle handle, or create a new one. */
+	if( engine->idle_handles != NULL )
+	{
+		curl = engine->idle_handles->data;
+		engine->idle_handles = g_slist_delete_link( engine->idle_handles,
+													engine->idle_handles );
+	}
+	else
+	{
+		curl = curl_easy_init( );
+		configure_session_handle( engine->session, curl );
+	}
+	request->curl = curl;
+	/* Receive the response into a buffer or feed it to the JSON stream. */
+	if( request->stream != NULL )
+	{
+		curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION,
+						  receive_streamed_response );
+		curl_easy_setopt( curl, CURLOPT_WRITEDATA, request );
+	}
+	else
+	{
+		if( request->response.data == NULL )
+		{
+			acquire_pooled_buffer( request->pool, &request->response );
+		}
+		curl_easy_setopt( curl, CURLOPT_WRITEDATA, &request->response );
+	}
+
+	curl_easy_setopt( curl, CURLOPT_PRIVATE, request );
+	curl_easy_setopt( curl, CURLOPT_CUSTOMREQUEST, request->method );
+	curl_easy_setopt( curl, CURLOPT_HTTPHEADER, request->headers );
+	curl_easy_setopt( curl, CURLOPT_URL, request->url );
+	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, receive_response_header );
+	curl_easy_setopt( curl, CURLOPT_HEADERDATA, request );
+	apply_operation_deadlines( engine->session, curl,
+							   get_request_operation( request ) );
+	apply_address_family( engine->session, curl, request->url );
+	/* Make the request conditional if the response is cached. */
+	if( request->cached_etag != NULL )
+	{
+		for( header = request->headers; header != NULL; header = header->next )
+		{
+			request->conditional_headers = curl_slist_append(
+				request->conditional_headers, header->data );
+		}
+		if_none_match = g_strconcat( "If-None-Match: ", request->cached_etag,
+									 NULL );
+		request->conditional_headers = curl_slist_append(
+			request->conditional_headers, if_none_match );
+		g_free( if_none_match );
+		curl_easy_setopt( curl, CURLOPT_HTTPHEADER,
+						  request->conditional_headers );
+	}
+	/* Send the request body; a batch request posts its parts. */
+	if( request->body != NULL )
+	{
+		set_request_body( engine, request, curl );
+	}
+	/* When multiplexing, wait for the HTTP/2 connection rather than opening
+	   another connection. */
+	if( engine->multiplex == TRUE )
+	{
+		curl_easy_setopt( curl, CURLOPT_HTTP_VERSION,
+						  (long) CURL_HTTP_VERSION_2TLS );
+		curl_easy_setopt( curl, CURLOPT_PIPEWAIT, 1L );
+	}
+	else
+	{
+		curl_easy_setopt( curl, CURLOPT_HTTP_VERSION,
+						  (long) CURL_HTTP_VERSION_1_1 );
+		curl_easy_setopt( curl, CURLOPT_PIPEWAIT, 0L );
+	}
+
+	curl_multi_add_handle( engine->multi, curl );
+	g_queue_push_tail( &engine->active, request );
+	engine->in_flight++;
+}
+
+
+
+/**
+ * Pack a request and the pending requests that may share a batch request
+ * with it into one batch request.  The requests are removed from the pending
+ * queue and become parts of the batch request.
+ * Requests that wait to be repeated are left in the queue.
+ * @param engine [in/out] Request engine.
+ * @param first [in] Request that has been removed from the pending queue.
+ * @param max_parts [in] Largest number of requests in the batch request.
+ * @param now [in] Current monotonic time in microseconds.
+ * @return The batch request, or \a first if no other requests could be
+ *         packed with it.
+ */
+STATIC api_request_t*
+pack_batch_request( request_engine_t *engine, api_request_t *first,
+					guint max_parts, gint64 now )
+{
+	GSList            *parts;
+	guint             part_count = 1;
+	GList             *pending;
+	GList             *next_pending;
+	api_request_t     *request;
+	api_request_t     *batch;
+	gchar             *boundary;
+	struct curl_slist *header;
+	gchar             *content_type;
+
+	/* Collect the pending requests that go to the same batch endpoint with
+	   the same headers. */
+	parts = g_slist_prepend( NULL, first );
+	max_parts = MIN( max_parts, engine->max_batch );
+	for( pending = engine->pending.head;
+		 ( pending != NULL ) && ( part_count < max_parts );
+		 pending = next_pending )
+	{
+		next_pending = pending->next;
+		request      = pending->data;
+		if( ( g_strcmp0( request->batch_url, first->batch_url ) == 0 ) &&
+			( request->headers == first->headers ) &&
+			( request->not_before <= now ) )
+		{
+			g_queue_delete_link( &engine->pending, pending );
+			parts = g_slist_prepend( parts, request );
+			part_count++;
+		}
+	}
+	if( part_count == 1 )
+	{
+		g_slist_free( parts );
+		return( first );
+	}
+	parts = g_slist_reverse( parts );
+
+	/* Create a multipart/mixed request.  The headers of the batch request
+	   apply to all the parts. */
+	boundary = g_strdup_printf( "batch_gtasks2ical_%08x", g_random_int( ) );
+	batch = g_new0( api_request_t, 1 );
+	batch->method = g_strdup( "POST" );
+	batch->url    = g_strdup( first->batch_url );
+	batch->body   = build_batch_body( parts, boundary );
+	batch->parts  = parts;
+	batch->result = CURLE_OK;
+	batch->pool   = engine->buffers;
+	for( header = first->headers; header != NULL; header = header->next )
+	{
+		batch->own_headers = curl_slist_append( batch->own_headers,
+												header->data );
+	}
+	content_type = g_strconcat( "Content-Type: multipart/mixed; boundary=",
+								boundary, NULL );
+	batch->own_headers = curl_slist_append( batch->own_headers,
+											content_type );
+	batch->headers = batch->own_headers;
+	g_free( content_type );
+	g_free( boundary );
+
+	return( batch );
+}
+
+
+
+/**
+ * Make the engine wake up no later than at a specified time to start a
+ * request that is held back.
+ * @param engine [in/out] Request engine.
+ * @param wake_time [in] Monotonic time in microseconds.
+ * @return Nothing.
+ */
+STATIC void
+set_engine_wake_time( request_engine_t *engine, gint64 wake_time )
+{
+	if( ( engine->wake_time == 0 ) || ( wake_time < engine->wake_time ) )
+	{
+		engine->wake_time = wake_time;
+	}
+}
+
+
+
+/**
+ * Start as many pending requests as the in-flight window and the rate
+ * limiter allow.  Requests that wait to be repeated are skipped, and
+ * requests to a server whose circuit is open fail without being sent.
+ * @param engine [in/out] Request engine.
+ * @return Nothing.
+ */
+STATIC void
+start_pending_requests( request_engine_t *engine )
+{
+	GList         *pending;
+	api_request_t *request;
+	gint64        now;
+	gint64        wait;
+	guint         max_parts;
+
+	now = g_get_monotonic_time( );
+	engine->wake_time = 0;
+	pending = engine->pending.head;
+	while( ( pending != NULL ) &&
+		   ( engine->in_flight < engine->max_in_flight ) )
+	{
+		request = pending->data;
+		if( request->not_before > now )
+		{
+			set_engine_wake_time( engine, request->not_before );
+			pending = pending->next;
+			continue;
+		}
+		/* Fail the request right away if its server's circuit is open. */
+		if( allow_circuit_request( engine->session->breakers, request->url,
+								   now ) == FALSE )
+		{
+			g_queue_delete_link( &engine->pending, pending );
+			request->result = CURLE_COULDNT_CONNECT;
+			finish_api_request( engine, request );
+			pending = engine->pending.head;
+			continue;
+		}
+		wait = take_rate_limiter_tokens( engine->limiter, 1, now );
+		if( wait > 0 )
+		{
+			set_engine_wake_time( engine, now + wait );
+			break;
+		}
+
+		g_queue_delete_link( &engine->pending, pending );
+		if( ( engine->max_batch > 1 ) && ( request->batch_url != NULL ) )
+		{
+			/* Each part of a batch request counts against the quota. */
+			max_parts = 1 + count_rate_limiter_tokens( engine->limiter, now );
+			request = pack_batch_request( engine, request, max_parts, now );
+			if( request->parts != NULL )
+			{
+				take_rate_limiter_tokens( engine->limiter,
+										  g_slist_length( request->parts ) - 1,
+										  now );
+			}
+		}
+		start_api_request( engine, request );
+		/* Packing may have removed any of the pending requests. */
+		pending = engine->pending.head;
+	}
+}
+
+
+
+/**
+ * Discard the response of a failed request and queue the request again.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The failed request.
+ * @param not_before [in] Monotonic time before which the request must not
+ *        be sent.
+ * @return Nothing.
+ */
+STATIC void
+requeue_api_request( request_engine_t *engine, api_request_t *request,
+					 gint64 not_before )
+{
+	release_pooled_buffer( request->pool, &request->response );
+	end_cached_response( request->cache_writer, FALSE );
+	request->cache_writer = NULL;
+	curl_slist_free_all( request->conditional_headers );
+	request->conditional_headers = NULL;
+	g_free( request->etag );
+	request->etag        = NULL;
+	request->retry_after = 0;
+	request->http_status = 0;
+	request->result      = CURLE_OK;
+	request->not_before  = not_before;
+	g_queue_push_tail( &engine->pending, request );
+}
+
+
+
+/**
+ * Queue a failed request to be sent again after a delay if the failure is
+ * transient and the request has not been repeated too often.  The delay is
+ * the longer of the jittered exponential backoff and the server's
+ * Retry-After delay.  A request is not repeated if the server asks for a
+ * longer delay than the longest retry delay.  If the server reports that the
+ * quota is exceeded, no requests are sent until the delay has passed.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The failed request.
+ * @return \a TRUE if the request is repeated, or \a FALSE otherwise.
+ */
+STATIC gboolean
+retry_api_request( request_engine_t *engine, api_request_t *request )
+{
+	gint64 now;
+	gint64 delay;
+	gint64 max_delay;
+
+	if( ( request->attempts > global_config.max_retries ) ||
+		( is_retryable_request( request->method, request->result,
+								request->http_status ) == FALSE ) ||
+		( ( request->stream != NULL ) && ( request->stream->received > 0 ) ) )
+	{
+		return( FALSE );
+	}
+
+	now       = g_get_monotonic_time( );
+	max_delay = (gint64) global_config.max_retry_delay * G_USEC_PER_SEC;
+	delay     = get_retry_after_delay(
+		get_retry_delay( request->attempts,
+						 (gint64) global_config.retry_delay * 1000,
+						 max_delay ),
+		request->retry_after, max_delay );
+	if( delay < 0 )
+	{
+		if( global_config.verbose == TRUE )
+		{
+			printf( "Not repeating request: server asks to wait %.0f "
+					"seconds\n",
+					(gdouble) request->retry_after / G_USEC_PER_SEC );
+		}
+		return( FALSE );
+	}
+	/* Don't repeat a request that could not be sent before the
+	   synchronization deadline. */
+	if( ( engine->session->deadline != 0 ) &&
+		( now + delay >= engine->session->deadline ) )
+	{
+		return( FALSE );
+	}
+	if( request->http_status == 429 )
+	{
+		pause_rate_limiter( engine->limiter, now + delay );
+	}
+	if( global_config.verbose == TRUE )
+	{
+		printf( "Repeating request in %.1f seconds (HTTP status %ld)\n",
+				(gdouble) delay / G_USEC_PER_SEC, request->http_status );
+	}
+
+	requeue_api_request( engine, request, now + delay );
+	engine->retries++;
+
+	return( TRUE );
+}
+
+
+
+/**
+ * Determine whether a request has received a successful response.  Requests
+ * that are not sent over HTTP, such as file:// requests, have no status.
+ * @param request [in] The finished request.
+ * @return \a TRUE if the request succeeded, or \a FALSE otherwise.
+ */
+STATIC gboolean
+is_api_request_successful( const api_request_t *request )
+{
+	return( ( request->result == CURLE_OK ) &&
+			( ( request->http_status == 0 ) ||
+			  ( ( request->http_status >= 200 ) &&
+				( request->http_status < 300 ) ) ||
+			  ( request->http_status == 304 ) ) );
+}
+
+
+
+/**
+ * Determine whether the server refused a request's compressed body.  If it
+ * did, no more bodies are compressed, and the request is queued again to be
+ * sent uncompressed.  A batch request is not repeated; its parts fall back
+ * to being sent on their own, without compression.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The finished request.
+ * @return \a TRUE if the request was queued again, or \a FALSE otherwise.
+ */
+STATIC gboolean
+settle_request_compression( request_engine_t *engine, api_request_t *request )
+{
+	if( engine->compression_probe == request )
+	{
+		engine->compression_probe = NULL;
+	}
+	if( request->compressed == FALSE )
+	{
+		return( FALSE );
+	}
+
+	if( ( request->http_status == 400 ) || ( request->http_status == 415 ) )
+	{
+		if( global_config.verbose == TRUE )
+		{
+			printf( "Server refuses compressed requests; "
+					"sending them uncompressed\n" );
+		}
+		engine->compression = COMPRESSION_REFUSED;
+		if( request->parts == NULL )
+		{
+			request->attempts--;
+			requeue_api_request( engine, request, 0 );
+			return( TRUE );
+		}
+	}
+	else if( ( engine->compression == COMPRESSION_UNKNOWN ) &&
+			 ( is_api_request_successful( request ) == TRUE ) )
+	{
+		engine->compression = COMPRESSION_ACCEPTED;
+	}
+
+	return( FALSE );
+}
+
+
+
+/**
+ * Complete the decoding of a streamed response.  Responses that were not
+ * streamed, because they are served from the cache or arrived as part of a
+ * batch response, are fed to the stream first.  The remainder of the
+ * response, without the streamed objects, is then decoded with the request's
+ * decoder.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The finished request.
+ * @return Nothing.
+ */
+STATIC void
+finish_streamed_request( request_engine_t *engine, api_request_t *request )
+{
+	gint64 decode_start;
+
+	decode_start = g_get_monotonic_time( );
+	if( ( request->http_status == 304 ) && ( request->cached_body != NULL ) )
+	{
+		feed_json_stream( request->stream, request->cached_body,
+						  strlen( request->cached_body ) );
+	}
+	else if( ( request->response.size > 0 ) &&
+			 ( is_api_request_successful( request ) == TRUE ) )
+	{
+		if( ( request->http_status == 200 ) && ( request->etag != NULL ) )
+		{
+			store_cached_response( request->cache, request->url,
+								   request->etag, request->response.data );
+		}
+		feed_json_stream( request->stream, request->response.data,
+						  request->response.size );
+	}
+	release_pooled_buffer( request->pool, &request->response );
+	end_cached_response( request->cache_writer,
+						 ( request->result == CURLE_OK ) &&
+						 ( request->http_status == 200 ) );
+	request->cache_writer = NULL;
+
+	request->answered = ( is_api_request_successful( request ) == TRUE ) &&
+		( request->stream->received > 0 );
+	if( ( request->answered == TRUE ) &&
+		( ( request->decoder != NULL ) || ( request->pull_decoder != NULL ) ) )
+	{
+		decode_api_response( request, request->stream->document->str,
+							 request->stream->document->len );
+	}
+	request->decode_time += g_get_monotonic_time( ) - decode_start;
+}
+
+
+
+/**
+ * Decode the buffered response of a finished request.  A "304 Not Modified"
+ * response is replaced by the cached response.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The finished request.
+ * @return Nothing.
+ */
+STATIC void
+finish_buffered_request( request_engine_t *engine, api_request_t *request )
+{
+	gint64 decode_start;
+
+	/* Serve an unchanged resource from the cache, or cache a new version of
+	   the resource.  A request that shares another request's response has
+	   no cache, since the other request caches the response. */
+	if( ( request->http_status == 304 ) && ( request->cached_body != NULL ) )
+	{
+		release_pooled_buffer( request->pool, &request->response );
+		request->response.data      = request->cached_body;
+		request->response.size      = strlen( request->cached_body );
+		request->response.allocated = request->response.size + 1;
+		request->cached_body        = NULL;
+	}
+	else if( ( request->http_status == 200 ) && ( request->etag != NULL ) &&
+			 ( g_strcmp0( request->method, "GET" ) == 0 ) )
+	{
+		store_cached_response( request->cache, request->url, request->etag,
+							   request->response.data );
+	}
+
+	/* Decode the response for the caller and return the buffer to the
+	   pool.  Error responses are not decoded. */
+	request->answered = ( is_api_request_successful( request ) == TRUE ) &&
+		( request->response.size > 0 );
+	if( ( request->answered == TRUE ) &&
+		( ( request->decoder != NULL ) || ( request->pull_decoder != NULL ) ) )
+	{
+		decode_start = g_get_monotonic_time( );
+		decode_api_response( request, request->response.data,
+							 request->response.size );
+		request->decode_time += g_get_monotonic_time( ) - decode_start;
+		release_pooled_buffer( request->pool, &request->response );
+	}
+}
+
+
+
+/**
+ * Give the requests that share the response of a finished request its result
+ * and, unless it was streamed to them as it arrived, its response.
+ * @param request [in/out] The finished request.
+ * @return Nothing.
+ */
+STATIC void
+share_response_with_followers( api_request_t *request )
+{
+	GSList        *link;
+	api_request_t *follower;
+
+	for( link = request->followers; link != NULL; link = link->next )
+	{
+		follower = link->data;
+		follower->result      = request->result;
+		follower->http_status = request->http_status;
+		g_free( follower->etag );
+		follower->etag = g_strdup( request->etag );
+		if( ( is_api_request_successful( request ) == TRUE ) &&
+			( request->response.size > 0 ) )
+		{
+			deliver_to_follower( follower, request->response.data,
+								 request->response.size );
+		}
+	}
+}
+
+
+
+/**
+ * Decode the response of a finished request and move the request, and the
+ * requests that share its response, to the completed queue.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The finished request.
+ * @return Nothing.
+ */
+STATIC void
+finish_api_request( request_engine_t *engine, api_request_t *request )
+{
+	GSList *followers;
+	GSList *follower;
+
+	share_response_with_followers( request );
+	if( request->stream != NULL )
+	{
+		finish_streamed_request( engine, request );
+	}
+	else
+	{
+		finish_buffered_request( engine, request );
+	}
+	record_decode_latency( engine->session->latency, request->method,
+						   request->url, request->decode_time );
+
+	request->completed = TRUE;
+	g_queue_push_tail( &engine->completed, request );
+
+	followers = request->followers;
+	request->followers = NULL;
+	for( follower = followers; follower != NULL; follower = follower->next )
+	{
+		finish_api_request( engine, follower->data );
+	}
+	g_slist_free( followers );
+}
+
+
+
+/**
+ * Hand the responses in a finished batch request to its parts.  Parts that
+ * were refused are repeated.  Parts that were not answered, or all parts if
+ * the batch request failed, are queued again to be sent on their own, unless
+ * the batch request was refused as a whole, in which case its parts are
+ * repeated in a new batch request.
+ * @param engine [in/out] Request engine.
+ * @param batch [in] The finished batch request, which is destroyed.
+ * @param content_type [in] Content-Type of the batch response.
+ * @return Nothing.
+ */
+STATIC void
+complete_batch_request( request_engine_t *engine, api_request_t *batch,
+						const gchar *content_type )
+{
+	GSList        *parts = batch->parts;
+	GSList        *part;
+	api_request_t *request;
+	gboolean      demultiplexed = FALSE;
+
+	batch->parts = NULL;
+	if( ( batch->result == CURLE_OK ) && ( batch->http_status == 200 ) )
+	{
+		demultiplexed = demultiplex_batch_response( content_type,
+													batch->response.data,
+													parts );
+	}
+	if( ( demultiplexed == FALSE ) && ( global_config.verbose == TRUE ) )
+	{
+		printf( "Batch request failed; sending the requests one by one\n" );
+	}
+
+	for( part = parts; part != NULL; part = part->next )
+	{
+		request = part->data;
+		if( ( demultiplexed == TRUE ) && ( request->response.data != NULL ) )
+		{
+			/* Repeat the parts that were refused. */
+			request->result = CURLE_OK;
+			if( retry_api_request( engine, request ) == FALSE )
+			{
+				finish_api_request( engine, request );
+			}
+		}
+		else
+		{
+			/* Repeat the parts of a batch request that was refused as a
+			   whole in a new batch request, or send them one by one. */
+			request->result      = batch->result;
+			request->http_status = batch->http_status;
+			request->retry_after = batch->retry_after;
+			if( ( demultiplexed == TRUE ) ||
+				( retry_api_request( engine, request ) == FALSE ) )
+			{
+				request->batch_url   = NULL;
+				request->result      = CURLE_OK;
+				request->http_status = 0;
+				request->retry_after = 0;
+				g_queue_push_tail( &engine->pending, request );
+			}
+		}
+	}
+	g_slist_free( parts );
+	destroy_api_request( batch );
+}
+
+
+
+/**
+ * Remove a request from the multi handle and return its CURL handle to the
+ * idle handles.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] Request that is in the multi handle.
+ * @return Nothing.
+ */
+STATIC void
+release_request_handle( request_engine_t *engine, api_request_t *request )
+{
+	CURL *curl = request->curl;
+
+	curl_multi_remove_handle( engine->multi, curl );
+	g_queue_remove( &engine->active, request );
+	engine->in_flight--;
+	reset_session_handle( curl );
+	curl_easy_setopt( curl, CURLOPT_PRIVATE, NULL );
+	engine->idle_handles = g_slist_prepend( engine->idle_handles, curl );
+	request->curl = NULL;
+}
+
+
+
+/**
+ * Send a duplicate of each request that has taken longer than the hedge
+ * percentile of the earlier requests to its endpoint, as far as the
+ * in-flight window and the rate limiter allow.
+ * @param engine [in/out] Request engine.
+ * @return Nothing.
+ */
+STATIC void
+hedge_slow_requests( request_engine_t *engine )
+{
+	GList         *active;
+	api_request_t *request;
+	api_request_t *hedge;
+	gint64        now;
+
+	now = g_get_monotonic_time( );
+	for( active = engine->active.head; active != NULL; active = active->next )
+	{
+		request = active->data;
+		if( ( request->hedge_time == 0 ) || ( request->hedge != NULL ) )
+		{
+			continue;
+		}
+		/* A streamed request that has begun to receive its response keeps
+		   it, so a duplicate could never win. */
+		if( ( request->stream != NULL ) && ( request->stream->received > 0 ) )
+		{
+			request->hedge_time = 0;
+			continue;
+		}
+		if( request->hedge_time > now )
+		{
+			set_engine_wake_time( engine, request->hedge_time );
+			continue;
+		}
+		if( ( engine->in_flight >= engine->max_in_flight ) ||
+			( take_rate_limiter_tokens( engine->limiter, 1, now ) > 0 ) )
+		{
+			break;
+		}
+
+		/* The duplicate buffers its response, which replaces the response
+		   of the original request if the duplicate completes first. */
+		hedge = g_new0( api_request_t, 1 );
+		hedge->method      = g_strdup( request->method );
+		hedge->url         = g_strdup( request->url );
+		hedge->headers     = request->headers;
+		hedge->cached_etag = g_strdup( request->cached_etag );
+		hedge->result      = CURLE_OK;
+		hedge->pool        = request->pool;
+		hedge->hedged      = request;
+		request->hedge     = hedge;
+		/* A request is duplicated only once per attempt, even if the
+		   duplicate fails. */
+		request->hedge_time = 0;
+		start_api_request( engine, hedge );
+		engine->hedges++;
+	}
+}
+
+
+
+/**
+ * Cancel the duplicate of a request, if it has one.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The request whose duplicate is cancelled.
+ * @return Nothing.
+ */
+STATIC void
+cancel_hedge_request( request_engine_t *engine, api_request_t *request )
+{
+	if( request->hedge != NULL )
+	{
+		release_request_handle( engine, request->hedge );
+		destroy_api_request( request->hedge );
+		request->hedge = NULL;
+	}
+}
+
+
+
+/**
+ * Complete the duplicate of a request.  If the duplicate succeeded, the
+ * original request is cancelled and completed with the duplicate's
+ * response.  A streamed request that has begun to receive its own response
+ * keeps it.
+ * @param engine [in/out] Request engine.
+ * @param hedge [in] The finished duplicate, which is destroyed.
+ * @return Nothing.
+ */
+STATIC void
+complete_hedge_request( request_engine_t *engine, api_request_t *hedge )
+{
+	api_request_t *request = hedge->hedged;
+	gchar         *etag;
+
+	request->hedge = NULL;
+	if( ( is_api_request_successful( hedge ) == TRUE ) &&
+		( ( request->stream == NULL ) ||
+		  ( request->stream->received == 0 ) ) )
+	{
+		release_request_handle( engine, request );
+		release_pooled_buffer( request->pool, &request->response );
+		request->response = hedge->response;
+		memset( &hedge->response, 0, sizeof( hedge->response ) );
+		etag                 = request->etag;
+		request->etag        = hedge->etag;
+		hedge->etag          = etag;
+		request->result      = hedge->result;
+		request->http_status = hedge->http_status;
+		end_cached_response( request->cache_writer, FALSE );
+		request->cache_writer = NULL;
+		engine->hedge_wins++;
+		finish_api_request( engine, request );
+	}
+	destroy_api_request( hedge );
+}
+
+
+
+/**
+ * Adapt the number of requests in flight to the outcome of a finished
+ * request.  Requests that Google refused for exceeding the quota, and
+ * requests that timed out, indicate that the server is overloaded.  The
+ * latency of a batch request depends on its number of parts, so it is not
+ * compared with the latencies of the other requests.
+ * @param engine [in/out] Request engine.
+ * @param request [in] The finished request.
+ * @return Nothing.
+ */
+STATIC void
+adapt_engine_concurrency( request_engine_t *engine,
+						  const api_request_t *request )
+{
+	gint64   now;
+	gboolean overloaded;
+
+	if( engine->concurrency != NULL )
+	{
+		now = g_get_monotonic_time( );
+		overloaded = ( request->http_status == 429 ) ||
+			( request->http_status == 503 ) ||
+			( request->result == CURLE_OPERATION_TIMEDOUT );
+		record_concurrency_sample( engine->concurrency,
+								   request->parts == NULL ?
+								   now - request->started : 0,
+								   overloaded, now );
+		engine->max_in_flight = get_concurrency_limit( engine->concurrency );
+	}
+}
+
+
+
+/**
+ * Remove a finished request from the multi handle, decode its response, and
+ * move it to the completed queue, or queue it again if it is repeated.  The
+ * request's CURL handle is returned to the idle handles.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The finished request.
+ * @param result [in] CURL result of the transfer.
+ * @return Nothing.
+ */
+STATIC void
+complete_api_request( request_engine_t *engine, api_request_t *request,
+					  CURLcode result )
+{
+	CURL  *curl = request->curl;
+	long  http_version;
+	char  *content_type;
+	gchar *batch_content_type = NULL;
+
+	request->result = result;
+	curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &request->http_status );
+
+	/* Fall back to a pool of HTTP/1.1 connections if the server did not
+	   agree to HTTP/2. */
+	if( ( engine->multiplex == TRUE ) && ( result == CURLE_OK ) &&
+		( request->http_status != 0 ) )
+	{
+		curl_easy_getinfo( curl, CURLINFO_HTTP_VERSION, &http_version );
+		if( http_version != CURL_HTTP_VERSION_2_0 )
+		{
+			if( global_config.verbose == TRUE )
+			{
+				printf( "Server does not support HTTP/2; using HTTP/1.1\n" );
+			}
+			set_engine_transport( engine, FALSE );
+		}
+	}
+
+	/* Keep the batch response's content type, which holds the boundary. */
+	if( request->parts != NULL )
+	{
+		content_type = NULL;
+		curl_easy_getinfo( curl, CURLINFO_CONTENT_TYPE, &content_type );
+		batch_content_type = g_strdup( content_type );
+	}
+
+	record_request_latency( engine->session->latency, request->method,
+							request->url, curl );
+	record_circuit_result( engine->session->breakers, request->url,
+						   request->result, request->http_status,
+						   g_get_monotonic_time( ) );
+	learn_address_family( engine->session, curl, request->url );
+	release_request_handle( engine, request );
+	adapt_engine_concurrency( engine, request );
+	if( settle_request_compression( engine, request ) == TRUE )
+	{
+		return;
+	}
+
+	/* The first response to a hedged request wins. */
+	if( request->hedged != NULL )
+	{
+		complete_hedge_request( engine, request );
+		return;
+	}
+	cancel_hedge_request( engine, request );
+
+	if( request->parts != NULL )
+	{
+		complete_batch_request( engine, request, batch_content_type );
+		g_free( batch_content_type );
+	}
+	else if( retry_api_request( engine, request ) == FALSE )
+	{
+		finish_api_request( engine, request );
+	}
+}
+
+
+
+/**
+ * Cancel all outstanding requests because the synchronization deadline has
+ * passed.  The requests complete with a timeout and without a response.
+ * @param engine [in/out] Request engine.
+ * @return Nothing.
+ */
+STATIC void
+expire_api_requests( request_engine_t *engine )
+{
+	api_request_t *request;
+	GSList        *part;
+
+	if( ( global_config.verbose == TRUE ) &&
+		( ( engine->in_flight > 0 ) ||
+		  ( g_queue_is_empty( &engine->pending ) == FALSE ) ) )
+	{
+		printf( "Synchronization deadline passed; cancelling %u requests\n",
+				engine->in_flight + g_queue_get_length( &engine->pending ) );
+	}
+
+	while( ( request = g_queue_pop_head( &engine->pending ) ) != NULL )
+	{
+		request->result = CURLE_OPERATION_TIMEDOUT;
+		finish_api_request( engine, request );
+	}
+
+	/* Duplicates are cancelled along with the requests that they
+	   duplicate. */
+	while( ( request = g_queue_peek_head( &engine->active ) ) != NULL )
+	{
+		if( request->hedged != NULL )
+		{
+			request = request->hedged;
+		}
+		cancel_hedge_request( engine, request );
+		release_request_handle( engine, request );
+		request->result = CURLE_OPERATION_TIMEDOUT;
+		if( request->parts != NULL )
+		{
+			for( part = request->parts; part != NULL; part = part->next )
+			{
+				( (api_request_t*) part->data )->result =
+					CURLE_OPERATION_TIMEDOUT;
+				finish_api_request( engine, part->data );
+			}
+			g_slist_free( request->parts );
+			request->parts = NULL;
+			destroy_api_request( request );
+		}
+		else
+		{
+			finish_api_request( engine, request );
+		}
+	}
+}
+
+
+
+/**
+ * Let CURL transfer data for the requests in flight, waiting for socket
+ * activity or for a request that is held back if necessary, and complete
+ * the requests that have finished.
+ * @param engine [in/out] Request engine.
+ * @return Nothing.
+ */
+STATIC void
+run_request_engine( request_engine_t *engine )
+{
+	int           running;
+	int           messages;
+	CURLMsg       *message;
+	api_request_t *request;
+	gint64        timeout;
+
+	if( is_session_expired( engine->session ) == TRUE )
+	{
+		expire_api_requests( engine );
+		return;
+	}
+
+	start_pending_requests( engine );
+	hedge_slow_requests( engine );
+
+	/* Wait no longer than until a request that is held back may be
+	   sent. */
+	timeout = ENGINE_POLL_TIMEOUT;
+	if( engine->wake_time != 0 )
+	{
+		timeout = CLAMP( ( engine->wake_time - g_get_monotonic_time( ) + 999 )
+						 / 1000, 0, ENGINE_POLL_TIMEOUT );
+	}
+
+	curl_multi_perform( engine->multi, &running );
+	if( running > 0 )
+	{
+		curl_multi_wait( engine->multi, NULL, 0, timeout, NULL );
+		curl_multi_perform( engine->multi, &running );
+	}
+	else if( ( engine->in_flight == 0 ) && ( engine->wake_time != 0 ) )
+	{
+		g_usleep( timeout * 1000 );
+	}
+
+	while( ( message = curl_multi_info_read( engine->multi, &messages ) )
+		   != NULL )
+	{
+		if( message->msg == CURLMSG_DONE )
+		{
+			request = NULL;
+			curl_easy_getinfo( message->easy_handle, CURLINFO_PRIVATE,
+							   (char**) &request );
+			complete_api_request( engine, request, message->data.result );
+		}
+	}
+}
+
+
+
+/**
+ * Wait for the next request to complete.  Its response has been decoded
+ * with the request's decoder function when it is returned.
+ * @param engine [in/out] Request engine.
+ * @return The completed request, which must be freed with
+ *         \a destroy_api_request, or \a NULL if no requests are outstanding.
+ */
+api_request_t*
+collect_api_request( request_engine_t *engine )
+{
+	while( g_queue_is_empty( &engine->completed ) &&
+		   ( ( engine->in_flight > 0 ) ||
+			 ( g_queue_is_empty( &engine->pending ) == FALSE ) ) )
+	{
+		run_request_engine( engine );
+	}
+
+	return( g_queue_pop_head( &engine->completed ) );
+}
+
+
+
+/**
+ * Wait for a specific request to complete.  Other requests that complete in
+ * the meantime remain available to \a collect_api_request.
+ * @param engine [in/out] Request engine.
+ * @param request [in/out] The request to wait for.  It is owned by the
+ *        caller once the function returns.
+ * @return Nothing.
+ */
+void
+wait_for_api_request( request_engine_t *engine, api_request_t *request )
+{
+	while( request->completed == FALSE )
+	{
+		run_request_engine( engine );
+	}
+	g_queue_remove( &engine->completed, request );
+}
+
+
+
+/**
+ * Wait for the first of several requests to complete.  Other requests that
+ * complete in the meantime remain available to \a collect_api_request.
+ * @param engine [in/out] Request engine.
+ * @param requests [in/out] List of the requests to wait for.  The completed
+ *        request is removed from the list.
+ * @return The completed request, which is owned by the caller, or \a NULL
+ *         if the list is empty.
+ */
+api_request_t*
+wait_for_any_api_request( request_engine_t *engine, GSList **requests )
+{
+	GSList        *link = NULL;
+	api_request_t *request;
+
+	while( ( *requests != NULL ) && ( link == NULL ) )
+	{
+		for( link = *requests; link != NULL; link = link->next )
+		{
+			request = link->data;
+			if( request->completed == TRUE )
+			{
+				break;
+			}
+		}
+		if( link == NULL )
+		{
+			run_request_engine( engine );
+		}
+	}
+	if( link == NULL )
+	{
+		return( NULL );
+	}
+	request = link->data;
+	*requests = g_slist_delete_link( *requests, link );
+	g_queue_remove( &engine->completed, request );
+
+	return( request );
+}
@@ -0,0 +1,237 @@
+/**
+ * \file multirequest.h
+ * \brief Definitions for concurrent requests to the Google Tasks API.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_MULTIREQUEST_H
+#define __GTASKS_MULTIREQUEST_H
+
+#include <config.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include "postform.h"
+#include "session.h"
+#include "responsecache.h"
+#include "bufferpool.h"
+#include "jsonstream.h"
+#include "jsonpull.h"
+#include "ratelimit.h"
+#include "concurrency.h"
+#include "compressbody.h"
+
+
+/* A request that is submitted to the request engine.  When the request
+   completes, the response is decoded with the request's decoder function
+   before the request is handed back to the caller. */
+typedef struct api_request_t
+{
+	gchar                      *method;
+	gchar                      *url;
+	gchar                      *body;
+	struct curl_slist          *headers;
+	struct curl_slist          *own_headers;
+	json_decoder_function      decoder;
+	gpointer                   decoder_data;
+	/* Pull decoder that decodes the response in place of \a decoder
+	   without building a JSON tree, or \a NULL. */
+	json_pull_decoder          pull_decoder;
+	/* Pool that the decoder interns repeated strings in. */
+	string_pool_t              *strings;
+	/* Arbitrary data for the caller. */
+	gpointer                   user_data;
+	/* URL of the batch endpoint that the request may be packed into, or
+	   \a NULL if the request must be sent on its own. */
+	const gchar                *batch_url;
+	/* Requests that are packed into this batch request, or \a NULL. */
+	GSList                     *parts;
+	/* ETag and body of the cached response to a GET request, and the
+	   request headers with the If-None-Match header that asks for the
+	   resource only if it has changed. */
+	gchar                      *cached_etag;
+	gchar                      *cached_body;
+	struct curl_slist          *conditional_headers;
+	/* The request body compressed with gzip, or \a NULL, and the request
+	   headers with the body's Content-Type and Content-Encoding.
+	   \a compressed is TRUE if the compressed body was sent. */
+	gchar                      *compressed_body;
+	gsize                      compressed_length;
+	struct curl_slist          *body_headers;
+	gboolean                   compressed;
+	/* ETag of the response. */
+	gchar                      *etag;
+	/* Response cache for GET requests, or \a NULL. */
+	response_cache_t           *cache;
+	/* JSON stream that the response is fed to as it is received instead
+	   of being buffered, or \a NULL, and the writer that copies the
+	   streamed response to the cache. */
+	json_stream_t              *stream;
+	cached_response_writer_t   *cache_writer;
+
+	CURL                       *curl;
+	/* The response is received into a buffer from the pool. */
+	buffer_pool_t              *pool;
+	struct curl_write_buffer_t response;
+	/* TRUE if a response body was received. */
+	gboolean                   answered;
+	CURLcode                   result;
+	long                       http_status;
+	gboolean                   completed;
+	/* Number of times the request has been sent, the monotonic time before
+	   which it must not be sent again, and the delay that the server asked
+	   for in a Retry-After header, in microseconds. */
+	guint                      attempts;
+	gint64                     not_before;
+	gint64                     retry_after;
+	/* Time spent decoding the response, in microseconds. */
+	gint64                     decode_time;
+	/* Monotonic time when the request was started, and when a duplicate of
+	   the request is sent if it has not completed by then, or 0 if the
+	   request is not hedged. */
+	gint64                     started;
+	gint64                     hedge_time;
+	/* The duplicate of the request, or the request that this request
+	   duplicates. */
+	struct api_request_t       *hedge;
+	struct api_request_t       *hedged;
+	/* Identical requests that share this request's response instead of
+	   being sent, or the request whose response this request shares. */
+	GSList                     *followers;
+	struct api_request_t       *leader;
+} api_request_t;
+
+
+/* Whether the server accepts compressed request bodies. */
+typedef enum
+{
+	COMPRESSION_UNKNOWN,
+	COMPRESSION_ACCEPTED,
+	COMPRESSION_REFUSED
+} request_compression_t;
+
+
+/* The request engine runs any number of submitted requests on a CURL multi
+   handle while keeping at most \a max_in_flight requests active. */
+struct request_engine_t
+{
+	gtasks_session_t *session;
+	CURLM            *multi;
+	guint            max_in_flight;
+	guint            in_flight;
+	/* Controller that adapts \a max_in_flight to the server, or \a NULL if
+	   the number of requests in flight is fixed. */
+	concurrency_limiter_t *concurrency;
+	/* TRUE if the requests are multiplexed on one HTTP/2 connection, or
+	   FALSE if they use a pool of HTTP/1.1 connections. */
+	gboolean         multiplex;
+	/* Largest number of requests in a batch request; batching is disabled
+	   if it is less than 2. */
+	guint            max_batch;
+	/* On-disk cache of GET responses, or \a NULL if caching is disabled. */
+	response_cache_t *cache;
+	/* Response buffers that are reused by the requests. */
+	buffer_pool_t    *buffers;
+	/* Limit on the rate of requests, or \a NULL if the rate is unlimited,
+	   and the monotonic time when a request that is held back by the
+	   limiter or by its retry delay may be sent, or 0. */
+	rate_limiter_t   *limiter;
+	gint64           wake_time;
+	/* Number of requests that have been repeated, number of duplicates of
+	   slow requests that have been sent, and number of duplicates that
+	   completed first. */
+	guint            retries;
+	guint            hedges;
+	guint            hedge_wins;
+	/* Number of requests that shared the response of an identical
+	   request. */
+	guint            coalesced;
+	/* Whether the server accepts compressed request bodies, and the request
+	   that probes it while this is unknown. */
+	request_compression_t compression;
+	api_request_t    *compression_probe;
+	/* Submitted requests that have not been started yet. */
+	GQueue           pending;
+	/* Requests in the multi handle. */
+	GQueue           active;
+	/* Completed requests that have not been collected yet. */
+	GQueue           completed;
+	/* Configured CURL handles that are ready for the next request. */
+	GSList           *idle_handles;
+};
+typedef struct request_engine_t request_engine_t;
+
+
+/*
+ * Create a request engine for a session.
+ */
+request_engine_t *create_request_engine( gtasks_session_t *session,
+										 guint max_in_flight );
+
+/*
+ * Destroy a request engine, cancelling any requests that are still active.
+ */
+void destroy_request_engine( request_engine_t *engine );
+
+/*
+ * Submit a request to the engine.  The request is started as soon as the
+ * in-flight window allows it.
+ */
+api_request_t *submit_api_request( request_engine_t *engine,
+								   const gchar *method, const gchar *url,
+								   struct curl_slist *headers,
+								   const gchar *body,
+								   json_decoder_function decoder,
+								   gpointer decoder_data );
+
+/*
+ * Decode a request's response while it is received.
+ */
+void stream_api_request( api_request_t *request, const gchar *array_name,
+						 json_element_handler handler,
+						 gpointer handler_data );
+
+/*
+ * Decode a request's response with a pull decoder.
+ */
+void pull_api_request( api_request_t *request, json_pull_decoder decoder );
+
+/*
+ * Wait for the next request to complete and return it with its response
+ * decoded.
+ */
+api_request_t *collect_api_request( request_engine_t *engine );
+
+/*
+ * Wait for a specific request to complete.
+ */
+void wait_for_api_request( request_engine_t *engine, api_request_t *request );
+
+/*
+ * Wait for the first of several requests to complete.
+ */
+api_request_t *wait_for_any_api_request( request_engine_t *engine,
+										 GSList **requests );
+
+/*
+ * Free a request that has been collected from the engine.
+ */
+void destroy_api_request( api_request_t *request );
+
+
+#endif /* __GTASKS_MULTIREQUEST_H */
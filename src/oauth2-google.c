@@ -31,6 +31,7 @@
 #include <glib/gprintf.h>
 #include "gtasks2ical.h"
 #include "postform.h"
+#include "session.h"
 #include "oauth2-google.h"
 
 
@@ -409,40 +410,30 @@ find_form( const gchar *raw_html_page, const gchar *form_action,
 
 /**
  * Retrieve the HTML body of the page at the specified URL.
- * @param curl [in/out] CURL handle.
+ * @param session [in/out] Session for the request.
  * @param url [in] URL of the HTML page.
  * @return Raw HTML body of the page, or \a NULL if the page couldn't be read.
  * Test: unit test (test-oauth2.c: read_url).
  */
 STATIC gchar*
-read_url( CURL *curl, const gchar *url )
+read_url( gtasks_session_t *session, const gchar *url )
 {
+	CURL                       *curl = session->curl;
 	struct curl_write_buffer_t html_body = { NULL, 0 };
-	CURLcode errcode;
+	CURLcode                   errcode;
 
 	/* Receive the HTML body only, using receive_curl_response to store it
 	   in html_body. */
 	curl_easy_setopt( curl, CURLOPT_WRITEDATA, &html_body );
-	curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, receive_curl_response );
-	curl_easy_setopt( curl, CURLOPT_HEADERDATA, NULL );
-	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, NULL );
-	if( global_config.ipv4_only == TRUE )
-	{
-		curl_easy_setopt( curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4 );
-	}
-	/* We'll probably be redirected. */
-	curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1 );
-	curl_easy_setopt( curl, CURLOPT_UNRESTRICTED_AUTH, 1 );
 	/* Set the URL. */
 	curl_easy_setopt( curl, CURLOPT_URL, url );
 	/* Send the request, receiving the response in html_body. */
-	errcode = curl_easy_perform( curl );
+	errcode = perform_session_request( session, "GET", url );
 	if( errcode != CURLE_OK )
 	{
 		g_fprintf( stderr, "Could not receive web page" );
 //		exit( EXIT_FAILURE );
 	}
-	curl_easy_reset( curl );
 	return( html_body.data );
 }
 
@@ -451,7 +442,7 @@ read_url( CURL *curl, const gchar *url )
 /**
  * Read a HTML page from a specified URL, and locate a form on the page
  * based on the form action and some of the names of its input elements.
- * @param curl [in/out] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param url [in] URL for the HTML page.
  * @param form_action [in] The form action.
  * @param input_names [in] List of names of input elements in the form.
@@ -459,14 +450,14 @@ read_url( CURL *curl, const gchar *url )
  * Test: unit test (test-oauth2.c: get_form_from_url).
  */
 STATIC form_field_t*
-get_form_from_url( CURL* curl, const gchar *url, const gchar *form_action,
-				   const gchar *const *input_names )
+get_form_from_url( gtasks_session_t *session, const gchar *url,
+				   const gchar *form_action, const gchar *const *input_names )
 {
 	gchar        *raw_html;
 	form_field_t *form;
 
 	/* Get the HTML page. */
-	raw_html = read_url( curl, url );
+	raw_html = read_url( session, url );
 	/* Get the form and its input elements. */
 	form = find_form( raw_html, form_action, input_names );
 	g_free( raw_html );
@@ -544,7 +535,8 @@ modify_form( form_field_t *form, const GSList *inputs_to_modify )
  * Test: manual (via non-automated test).
  */
 gboolean
-login_to_gmail( CURL *curl, const gchar *username, const gchar *password )
+login_to_gmail( gtasks_session_t *session, const gchar *username,
+				const gchar *password )
 {
 	static const gchar *login_url =
 		GOOGLE_GMAIL_LOGIN "?"
@@ -560,7 +552,7 @@ login_to_gmail( CURL *curl, const gchar *username, const gchar *password )
 	gboolean           logged_in;
 
 	/* Get the original login form. */
-	login_form = get_form_from_url( curl, login_url,
+	login_form = get_form_from_url( session, login_url,
 									login_action, login_inputs );
 	/* Modify login form. */
 	inputs_to_modify = g_slist_append( NULL, &input_email );
@@ -568,7 +560,7 @@ login_to_gmail( CURL *curl, const gchar *username, const gchar *password )
 	modify_form( login_form, inputs_to_modify );
 	g_slist_free( inputs_to_modify );
 	/* Submit the login form. */
-	login_response = post_form( curl, login_form, NULL );
+	login_response = post_form( session, login_form, NULL );
 	destroy_form( login_form );
 
 	#ifdef AUTOTEST
@@ -630,16 +622,16 @@ parse_tokens_json( const gchar *member_name,
 
 
 /**
- * Obtain a device code for device access.  The CURL session must include the
+ * Obtain a device code for device access.  The session must include the
  * user's login to Google, which may be obtained by calling \a login_to_gmail
  * with the user's credentials.
- * @param curl [in] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param client_id [in] Google Developer Client ID.
  * @return Device code or \a NULL if an error occurred.
  * Test: manual (via non-automated test).
  */
 struct user_code_t*
-obtain_device_code( CURL *curl, const gchar *client_id )
+obtain_device_code( gtasks_session_t *session, const gchar *client_id )
 {
 	static const gchar *endpoint     = GOOGLE_OAUTH2_DEVICECODE;
 	static const gchar *redirect_uri = "urn:ietf:wg:oauth:2.0:oob";
@@ -660,13 +652,14 @@ obtain_device_code( CURL *curl, const gchar *client_id )
 							   client_id, "&scope=", scope,
 							   "&redirect_uri=", redirect_uri, NULL );
 	/* Retrieve the data access authoriziation form. */
-	authorization_form = get_form_from_url( curl, request_url, auth_form_action,
+	authorization_form = get_form_from_url( session, request_url,
+											auth_form_action,
 											auth_input_names );
 	g_free( request_url );
 	/* Submit the form to pretend the user has authorized the application. */
 	if( authorization_form != NULL )
 	{
-		auth_response = post_form( curl, authorization_form, NULL );
+		auth_response = post_form( session, authorization_form, NULL );
 		/* Grep the authorization code from the title. */
 		code_regex = g_regex_new(
 			"<title>\\s*[^=]+=\\s*([a-zA-Z0-9_/-]+)", 0, 0, NULL );
@@ -695,7 +688,7 @@ obtain_device_code( CURL *curl, const gchar *client_id )
 /**
  * Request access and refresh tokens.  If the device_code does not include
  * a redirection URL then request the tokens as an application.
- * @param curl [in/out] CURL handle.
+ * @param session [in/out] Session for the requests.
  * @param device_code [in] Device code.
  * @param client_id [in] Application/device Client ID.
  * @param client_id [in] Application/device Client secret.
@@ -706,7 +699,7 @@ obtain_device_code( CURL *curl, const gchar *client_id )
  *         token timeout timestamp.
  */
 STATIC access_code_t*
-obtain_access_code( CURL *curl, const gchar *device_code,
+obtain_access_code( gtasks_session_t *session, const gchar *device_code,
 					const gchar *client_id, const gchar *client_secret,
 					gboolean is_device_request )
 {
@@ -738,7 +731,7 @@ obtain_access_code( CURL *curl, const gchar *device_code,
 	}
 
 	/* Request the authorization code. */
-	token_response = post_form( curl, &request_form, NULL );
+	token_response = post_form( session, &request_form, NULL );
 	destroy_form_inputs( &request_form );
 	/* Decode the JSON response. */
 	access_code = g_new0( access_code_t, 1 );
@@ -762,14 +755,14 @@ obtain_access_code( CURL *curl, const gchar *device_code,
 
 /**
  * Authorize the application to access the user's Google data.  This function
- * requires the user to have been logged in to Google already via the CURL
- * handle that is passed to the function.
- * @param curl [in] CURL handle of a CURL session that includes a Google login.
+ * requires the user to have been logged in to Google already via the
+ * session that is passed to the function.
+ * @param session [in/out] Session that includes a Google login.
  * @return An \a access_token_t structure with access and refresh tokens, and
  *         their timeout timestamp.
  */
 access_code_t*
-authorize_application( CURL *curl )
+authorize_application( gtasks_session_t *session )
 {
 	struct user_code_t *user_code;
 	form_field_t       *user_code_form;
@@ -785,7 +778,7 @@ authorize_application( CURL *curl )
 	access_code = NULL;
 
 	/* Obtain a device code, a user code, and the verification URL. */
-	user_code = obtain_device_code( curl, global_config.client_id );
+	user_code = obtain_device_code( session, global_config.client_id );
 	if( user_code != NULL )
 	{
 		success = TRUE;
@@ -807,7 +800,7 @@ authorize_application( CURL *curl )
 	{
 		/* The device is now approved and may request an access token and
 		   a refresh token. */
-		access_code = obtain_access_code( curl,
+		access_code = obtain_access_code( session,
 										  user_code->device_code,
 										  global_config.client_id,
 										  global_config.client_password,
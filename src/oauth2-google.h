@@ -25,6 +25,7 @@
 
 #include <config.h>
 #include <glib.h>
+#include "session.h"
 
 
 /* URLs for submitting requests.. */
@@ -63,12 +64,12 @@ typedef struct
 } access_code_t;
 
 
-/* Login to the user's Gmail account, keeping the login state in the CURL
+/* Login to the user's Gmail account, keeping the login state in the
    session. */
-gboolean login_to_gmail( CURL *curl, const gchar *username,
+gboolean login_to_gmail( gtasks_session_t *session, const gchar *username,
 						 const gchar *password );
 /* Authorize the application to access the user's Google Tasks. */
-access_code_t *authorize_application( CURL *curl );
+access_code_t *authorize_application( gtasks_session_t *session );
 
 
 
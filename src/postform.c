@@ -31,6 +31,7 @@
 #include <glib/gprintf.h>
 #include "gtasks2ical.h"
 #include "postform.h"
+#include "session.h"
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #pragma GCC diagnostic ignored "-Wunused-variable"
@@ -41,9 +42,37 @@ extern struct configuration_t global_config;
 
 
 
+/**
+ * Make room for a number of bytes plus a zero terminator in a response
+ * buffer.  The buffer grows geometrically so that a response that arrives
+ * in many chunks is only copied a few times.
+ * @param write_buffer [in/out] Response buffer.
+ * @param size [in] Total number of bytes that the buffer should hold.
+ * @return Nothing.
+ * Test: implied (test-oauth2.c: receive_curl_response).
+ */
+void
+reserve_write_buffer( struct curl_write_buffer_t *write_buffer, gsize size )
+{
+	gsize to_allocate;
+
+	if( size + sizeof( gchar ) > write_buffer->allocated )
+	{
+		to_allocate = MAX( write_buffer->allocated * 2,
+						   size + sizeof( gchar ) );
+		write_buffer->data = g_realloc( write_buffer->data, to_allocate );
+		write_buffer->allocated = to_allocate;
+	}
+}
+
+
+
 /**
  * Callback function for a CURL write.  The function maintains a dynamically
  * expanding buffer that may be filled successively by multiple callbacks.
+ * Compressed responses are decompressed by CURL while they are received, so
+ * the data is always decompressed and the compressed body is never
+ * buffered.
  * @param ptr [in] Source of the data from CURL.
  * @param size [in] The size of each data block.
  * @param nmemb [in] Number of data blocks.
@@ -59,22 +88,14 @@ receive_curl_response( const char *ptr, size_t size, size_t nmemb,
 {
     struct curl_write_buffer_t *write_buffer = state_data;
     gsize                      to_copy       = size * nmemb;
-    gchar                      *dest_buffer;
-    int                        i;
-    gsize                      to_allocate;
 
 	/* Expand the buffer to receive the data. */
-	to_allocate = write_buffer->size + to_copy + sizeof( gchar );
-	write_buffer->data = g_realloc( write_buffer->data, to_allocate );
-	dest_buffer = &( (gchar*) write_buffer->data )[ write_buffer->size ];
+	reserve_write_buffer( write_buffer, write_buffer->size + to_copy );
 
     /* Receive the data and zero-terminate the buffer so far. */
-    for( i = 0; i < to_copy; i++ )
-    {
-		*dest_buffer++ = *ptr++;
-    }
-    *dest_buffer = '\0';
+	memcpy( &write_buffer->data[ write_buffer->size ], ptr, to_copy );
     write_buffer->size = write_buffer->size + to_copy;
+	write_buffer->data[ write_buffer->size ] = '\0';
 
 	/* Return the number of bytes received. */
     return( to_copy );
@@ -104,82 +125,225 @@ add_input_to_form( form_field_t *form, const gchar *name, const gchar *value )
 
 /**
  * Auxiliary function that adds an input element name and value to a CURL
- * post form.
+ * MIME form as a new part.
  * @param input_field_ptr [in] Pointer to an input_field_t structure with
  *        input name and value.
- * @param form_vars_ptr [in/out] Pointer to a curl_form_vars_t structure with
- *        form parameters.
+ * @param mime_ptr [in/out] Pointer to the curl_mime form.
  * @return Nothing.
  */
 void
-fill_form_with_input( gpointer input_field_ptr, gpointer form_vars_ptr )
+fill_form_with_input( gpointer input_field_ptr, gpointer mime_ptr )
+{
+	input_field_t *input_field = input_field_ptr;
+	curl_mime     *mime        = mime_ptr;
+	curl_mimepart *part;
+
+	part = curl_mime_addpart( mime );
+	curl_mime_name( part, input_field->name );
+	curl_mime_data( part, input_field->value, CURL_ZERO_TERMINATED );
+}
+
+
+
+/**
+ * Determine whether a character is sent as itself in a URL-encoded form.
+ * @param character [in] The character.
+ * @return \a TRUE if the character is sent as itself, or \a FALSE if it is
+ *         escaped.
+ */
+STATIC gboolean
+is_form_character_unreserved( gchar character )
 {
-	input_field_t        *input_field = input_field_ptr;
-	struct curl_httppost **form_post  = form_vars_ptr;
-	const gchar *name;
-	const gchar *value;
-
-	name  = input_field->name;
-	value = input_field->value;
-	curl_formadd( &form_post[ 0 ], &form_post[ 1 ],
-				  CURLFORM_COPYNAME, name,
-				  CURLFORM_COPYCONTENTS, value,
-				  CURLFORM_END );
+	return( g_ascii_isalnum( character ) || ( character == '*' ) ||
+			( character == '-' ) || ( character == '.' ) ||
+			( character == '_' ) );
+}
+
+
+
+/**
+ * Determine the length of a name or value in a URL-encoded form.
+ * @param text [in] Name or value, or \a NULL for an empty string.
+ * @return Number of characters of the URL-encoded text.
+ */
+STATIC gsize
+get_urlencoded_length( const gchar *text )
+{
+	gsize length = 0;
+
+	if( text != NULL )
+	{
+		for( ; *text != '\0'; text++ )
+		{
+			length += ( ( *text == ' ' ) ||
+						is_form_character_unreserved( *text ) ) ? 1 : 3;
+		}
+	}
+	return( length );
+}
+
+
+
+/**
+ * URL-encode a name or value into a buffer that has room for it.  Spaces
+ * become '+', and all other reserved characters are percent-encoded.
+ * @param destination [out] Buffer that receives the encoded text.
+ * @param text [in] Name or value, or \a NULL for an empty string.
+ * @return Position in \a destination after the encoded text.
+ */
+STATIC gchar*
+append_urlencoded( gchar *destination, const gchar *text )
+{
+	static const gchar hex_digits[ ] = "0123456789ABCDEF";
+	guchar             character;
+
+	if( text != NULL )
+	{
+		for( ; *text != '\0'; text++ )
+		{
+			character = (guchar) *text;
+			if( is_form_character_unreserved( character ) )
+			{
+				*destination++ = character;
+			}
+			else if( character == ' ' )
+			{
+				*destination++ = '+';
+			}
+			else
+			{
+				*destination++ = '%';
+				*destination++ = hex_digits[ character >> 4 ];
+				*destination++ = hex_digits[ character & 0x0f ];
+			}
+		}
+	}
+	return( destination );
+}
+
+
+
+/**
+ * Encode a form's name and value and its input elements as an
+ * application/x-www-form-urlencoded request body.  The length of the body
+ * is determined first, so the body is built in a single allocation without
+ * copying the names and values.
+ * @param form [in] The form that is encoded.
+ * @param length [out] Length of the body, or \a NULL.
+ * @return The zero-terminated request body, which must be freed with
+ *         \a g_free.
+ * Test: unit test (test-oauth2.c: encode_form).
+ */
+gchar*
+encode_form( const form_field_t *form, gsize *length )
+{
+	const GSList        *inputs;
+	const input_field_t *input;
+	gsize               body_length = 0;
+	gchar               *body;
+	gchar               *position;
+
+	/* Measure the name=value pairs and the separators between them. */
+	if( form->name != NULL )
+	{
+		body_length += get_urlencoded_length( form->name ) + 1 +
+			get_urlencoded_length( form->value ) + 1;
+	}
+	for( inputs = form->input_fields; inputs != NULL; inputs = inputs->next )
+	{
+		input = inputs->data;
+		body_length += get_urlencoded_length( input->name ) + 1 +
+			get_urlencoded_length( input->value ) + 1;
+	}
+
+	/* Encode the pairs into the body, separating them with '&'. */
+	body     = g_malloc( body_length + 1 );
+	position = body;
+	if( form->name != NULL )
+	{
+		position    = append_urlencoded( position, form->name );
+		*position++ = '=';
+		position    = append_urlencoded( position, form->value );
+		*position++ = '&';
+	}
+	for( inputs = form->input_fields; inputs != NULL; inputs = inputs->next )
+	{
+		input       = inputs->data;
+		position    = append_urlencoded( position, input->name );
+		*position++ = '=';
+		position    = append_urlencoded( position, input->value );
+		*position++ = '&';
+	}
+	/* Replace the last separator with the terminator. */
+	if( position > body )
+	{
+		position--;
+	}
+	*position = '\0';
+
+	if( length != NULL )
+	{
+		*length = position - body;
+	}
+	return( body );
 }
 
 
 
 /**
  * Submit a form according to its \a action attribute and return the response
- * from the host.
- * @param curl [in/out] CURL handle.
+ * from the host.  The form is sent URL-encoded unless multipart forms are
+ * configured.
+ * @param session [in/out] Session for the request.
  * @param form [in] Form that should be submitted.
  * @return Raw HTML response, or \a NULL if the form could not be submitted.
  * Test: smoke test (test-oauth2.c: post_form) and implied (by testing the
  *       \a login_to_google function outside of the test suite).
  */
 gchar*
-post_form( CURL *curl, const form_field_t *form,
+post_form( gtasks_session_t *session, const form_field_t *form,
 		   struct curl_slist *curl_headers )
 {
+	CURL                       *curl = session->curl;
 	const gchar                *form_name;
 	const gchar                *form_value;
 	const gchar                *form_action;
 
-	struct curl_httppost       *form_post[ 2 ] = { NULL, NULL };
+	curl_mime                  *mime           = NULL;
+	curl_mimepart              *part;
+	gchar                      *form_body      = NULL;
+	gsize                      form_length;
 	struct curl_write_buffer_t html_response   = { .data = NULL, .size = 0 };
 
 	form_name   = form->name;
 	form_value  = form->value;
 	form_action = form->action;
 
-	/*  Post the form using receive_curl_response to store the reply. */
-    /*
-	curl_easy_setopt( curl, CURLOPT_VERBOSE, 1 );
-	*/
-	if( global_config.ipv4_only == TRUE )
-	{
-		curl_easy_setopt( curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4 );
-	}
-
 	/* Prepare for posting a form. */
 	curl_easy_setopt( curl, CURLOPT_POST, 1 );
 
-	/* Copy the form. */
-	if( form_name != NULL )
+	if( global_config.multipart_forms == TRUE )
+	{
+		/* Copy the form. */
+		mime = curl_mime_init( curl );
+		if( form_name != NULL )
+		{
+			part = curl_mime_addpart( mime );
+			curl_mime_name( part, form_name );
+			curl_mime_data( part, form_value, CURL_ZERO_TERMINATED );
+		}
+		/* Copy the form's input elements. */
+		g_slist_foreach( form->input_fields, fill_form_with_input, mime );
+		/* Enter the form in CURL. */
+		curl_easy_setopt( curl, CURLOPT_MIMEPOST, mime );
+	}
+	else
 	{
-		curl_formadd( &form_post[ 0 ], &form_post[ 1 ],
-					  CURLFORM_COPYNAME, form_name,
-					  CURLFORM_COPYCONTENTS, form_value,
-					  CURLFORM_END );
+		/* Send the URL-encoded form, which CURL does not copy. */
+		form_body = encode_form( form, &form_length );
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDS, form_body );
+		curl_easy_setopt( curl, CURLOPT_POSTFIELDSIZE, (long) form_length );
 	}
-	/* Copy the form's input elements. */
-	g_slist_foreach( form->input_fields, fill_form_with_input, form_post );
-	/* Enter the form in CURL. */
-	curl_easy_setopt( curl, CURLOPT_HTTPPOST, form_post[ 0 ] );
-	/* We may be redirected several times. */
-	curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1 );
-	curl_easy_setopt( curl, CURLOPT_UNRESTRICTED_AUTH, 1 );
 	/* Set the URL. */
 	curl_easy_setopt( curl, CURLOPT_URL, form_action );
 	/* "Expect: 100-continue" is unwanted. */
@@ -187,14 +351,11 @@ post_form( CURL *curl, const form_field_t *form,
 	curl_easy_setopt( curl, CURLOPT_HTTPHEADER, curl_headers );
 	/* Send the request, receiving the response in html_response. */
 	curl_easy_setopt( curl, CURLOPT_WRITEDATA, &html_response );
-	curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, receive_curl_response );
-	curl_easy_setopt( curl, CURLOPT_HEADERDATA, NULL );
-	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, NULL );
-	curl_easy_perform( curl );
+	perform_session_request( session, "POST", form_action );
 
 	curl_slist_free_all( curl_headers );
-	curl_formfree( form_post[ 0 ] );
-	curl_easy_reset( curl );
+	curl_mime_free( mime );
+	g_free( form_body );
 
 	return( html_response.data );
 }
@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <json-glib/json-glib.h>
 #include <curl/curl.h>
+#include "session.h"
 
 
 #ifndef STRINGIFY
@@ -84,6 +85,8 @@ struct curl_write_buffer_t
 {
 	gchar *data;
 	gsize size;
+	/* Number of bytes allocated for \a data. */
+	gsize allocated;
 };
 
 
@@ -94,6 +97,12 @@ struct curl_write_buffer_t
 size_t receive_curl_response( const char *ptr, size_t size, size_t nmemb,
 							  void *state_data );
 
+/*
+ * Make room for a number of bytes in a response buffer.
+ */
+void reserve_write_buffer( struct curl_write_buffer_t *write_buffer,
+						   gsize size );
+
 /**
  * Create an input field and add it to a form.
  */
@@ -102,15 +111,20 @@ void add_input_to_form( form_field_t *form, const gchar *name,
 
 /*
  * Auxiliary function that adds an input element name and value to a CURL
- * post form.
+ * MIME form.
+ */
+void fill_form_with_input( gpointer input_field_ptr, gpointer mime_ptr );
+
+/*
+ * Encode a form as an application/x-www-form-urlencoded request body.
  */
-void fill_form_with_input( gpointer input_field_ptr, gpointer form_vars_ptr );
+gchar *encode_form( const form_field_t *form, gsize *length );
 
 /*
  * Submit a form according to its \a action attribute and return the response
  * from the host.
  */
-gchar *post_form( CURL *curl, const form_field_t *form,
+gchar *post_form( gtasks_session_t *session, const form_field_t *form,
 				  struct curl_slist *headers );
 
 /*
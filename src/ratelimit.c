@@ -0,0 +1,336 @@
+/**
+ * \file ratelimit.c
+ * \brief Request rate limiting and retry policy for the Tasks API.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "ratelimit.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+
+/**
+ * Create a token-bucket rate limiter.  The bucket starts out full.
+ * @param rate [in] Number of requests per second that may be sent.
+ * @param burst [in] Number of requests that may be sent at once.
+ * @return New rate limiter, or \a NULL if \a rate is not positive, which
+ *         disables rate limiting.
+ */
+rate_limiter_t*
+create_rate_limiter( gdouble rate, guint burst )
+{
+	rate_limiter_t *limiter;
+
+	if( rate <= 0.0 )
+	{
+		return( NULL );
+	}
+	limiter = g_new0( rate_limiter_t, 1 );
+	limiter->rate     = rate;
+	limiter->capacity = MAX( burst, 1 );
+	limiter->tokens   = limiter->capacity;
+	limiter->refilled = g_get_monotonic_time( );
+
+	return( limiter );
+}
+
+
+
+/**
+ * Destroy a rate limiter.
+ * @param limiter [out] Rate limiter, or \a NULL.
+ * @return Nothing.
+ */
+void
+destroy_rate_limiter( rate_limiter_t *limiter )
+{
+	g_free( limiter );
+}
+
+
+
+/**
+ * Add the tokens that have accumulated since the bucket was last refilled.
+ * @param limiter [in/out] Rate limiter.
+ * @param now [in] Current monotonic time in microseconds.
+ * @return Nothing.
+ */
+STATIC void
+refill_rate_limiter( rate_limiter_t *limiter, gint64 now )
+{
+	if( now > limiter->refilled )
+	{
+		limiter->tokens += limiter->rate *
+			( now - limiter->refilled ) / G_USEC_PER_SEC;
+		limiter->tokens   = MIN( limiter->tokens, limiter->capacity );
+		limiter->refilled = now;
+	}
+}
+
+
+
+/**
+ * Count the requests that may be sent right away.
+ * @param limiter [in/out] Rate limiter, or \a NULL.
+ * @param now [in] Current monotonic time in microseconds.
+ * @return Number of available tokens.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+guint
+count_rate_limiter_tokens( rate_limiter_t *limiter, gint64 now )
+{
+	if( limiter == NULL )
+	{
+		return( G_MAXUINT );
+	}
+	if( now < limiter->paused_until )
+	{
+		return( 0 );
+	}
+	refill_rate_limiter( limiter, now );
+
+	return( (guint) limiter->tokens );
+}
+
+
+
+/**
+ * Take tokens for a number of requests from the bucket if they are
+ * available.
+ * @param limiter [in/out] Rate limiter, or \a NULL.
+ * @param count [in] Number of requests that are to be sent.
+ * @param now [in] Current monotonic time in microseconds.
+ * @return 0 if the tokens were taken, or the number of microseconds until
+ *         they are available.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+gint64
+take_rate_limiter_tokens( rate_limiter_t *limiter, guint count, gint64 now )
+{
+	gdouble needed;
+
+	if( limiter == NULL )
+	{
+		return( 0 );
+	}
+	if( now < limiter->paused_until )
+	{
+		return( limiter->paused_until - now );
+	}
+	refill_rate_limiter( limiter, now );
+
+	/* A request for more tokens than the bucket holds is let through when
+	   the bucket is full. */
+	needed = MIN( count, limiter->capacity );
+	if( limiter->tokens < needed )
+	{
+		return( (gint64) ( ( needed - limiter->tokens ) * G_USEC_PER_SEC /
+						   limiter->rate ) + 1 );
+	}
+	limiter->tokens -= count;
+
+	return( 0 );
+}
+
+
+
+/**
+ * Stop sending requests until a specified time, such as when the server
+ * has asked the client to back off.  The bucket is emptied so that the
+ * requests resume at the sustained rate rather than in a burst.
+ * @param limiter [in/out] Rate limiter, or \a NULL.
+ * @param until [in] Monotonic time in microseconds when requests may be sent
+ *        again.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+void
+pause_rate_limiter( rate_limiter_t *limiter, gint64 until )
+{
+	if( ( limiter != NULL ) && ( until > limiter->paused_until ) )
+	{
+		limiter->paused_until = until;
+		limiter->tokens       = 0.0;
+		limiter->refilled     = until;
+	}
+}
+
+
+
+/**
+ * Determine whether a failed request should be sent again.  Requests that
+ * the server refused because of load or quota are always repeated, whereas
+ * requests that may have been carried out are repeated only if they are
+ * idempotent.
+ * @param method [in] HTTP method of the request.
+ * @param result [in] CURL result of the transfer.
+ * @param http_status [in] HTTP status of the response.
+ * @return \a TRUE if the request may be repeated, or \a FALSE otherwise.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+gboolean
+is_retryable_request( const gchar *method, CURLcode result, long http_status )
+{
+	gboolean idempotent;
+
+	idempotent = ( g_strcmp0( method, "POST" ) != 0 ) &&
+		( g_strcmp0( method, "PATCH" ) != 0 );
+
+	switch( result )
+	{
+		case CURLE_OK:
+			break;
+		case CURLE_COULDNT_RESOLVE_HOST:
+		case CURLE_COULDNT_CONNECT:
+			/* Nothing has been sent. */
+			return( TRUE );
+		case CURLE_OPERATION_TIMEDOUT:
+		case CURLE_SEND_ERROR:
+		case CURLE_RECV_ERROR:
+		case CURLE_GOT_NOTHING:
+		case CURLE_PARTIAL_FILE:
+		case CURLE_HTTP2:
+		case CURLE_HTTP2_STREAM:
+			return( idempotent );
+		default:
+			return( FALSE );
+	}
+
+	switch( http_status )
+	{
+		case 429:
+		case 503:
+			return( TRUE );
+		case 500:
+		case 502:
+		case 504:
+			return( idempotent );
+		default:
+			return( FALSE );
+	}
+}
+
+
+
+/**
+ * Compute the delay before a request is repeated, using jittered exponential
+ * backoff: the delay doubles with each attempt, and is drawn at random
+ * between half of and the full doubled delay so that requests that failed
+ * together are not repeated together.
+ * @param attempt [in] Number of times the request has been sent.
+ * @param base_delay [in] Delay after the first attempt in microseconds.
+ * @param max_delay [in] Longest delay in microseconds.
+ * @return Delay in microseconds.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+gint64
+get_retry_delay( guint attempt, gint64 base_delay, gint64 max_delay )
+{
+	gint64 delay = base_delay;
+	guint  doubling;
+
+	for( doubling = 1; ( doubling < attempt ) && ( delay < max_delay );
+		 doubling++ )
+	{
+		delay *= 2;
+	}
+	delay = MIN( delay, max_delay );
+
+	return( delay / 2 +
+			(gint64) ( g_random_double( ) * ( delay - delay / 2 ) ) );
+}
+
+
+
+/**
+ * Combine the backoff before a request is repeated with the delay that the
+ * server asked for in a Retry-After header.  The request is not repeated if
+ * the server asks for a longer delay than the longest retry delay, so that a
+ * distant Retry-After does not stall the synchronization.
+ * @param backoff [in] Jittered exponential backoff in microseconds.
+ * @param retry_after [in] Delay from the Retry-After header in microseconds,
+ *        or 0 if the server did not ask for one.
+ * @param max_delay [in] Longest delay in microseconds.
+ * @return Delay in microseconds, or -1 if the request is not repeated.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+gint64
+get_retry_after_delay( gint64 backoff, gint64 retry_after, gint64 max_delay )
+{
+	if( retry_after > max_delay )
+	{
+		return( -1 );
+	}
+
+	return( MAX( backoff, retry_after ) );
+}
+
+
+
+/**
+ * Parse the value of a Retry-After header, which is either a number of
+ * seconds or an HTTP date.
+ * @param value [in] Header value.
+ * @return Number of microseconds to wait, or -1 if the value is invalid.
+ * Test: unit test (test-gtasks.c: rate_limiter).
+ */
+gint64
+parse_retry_after( const gchar *value )
+{
+	gchar  *end;
+	guint64 seconds;
+	time_t  date;
+
+	while( g_ascii_isspace( *value ) )
+	{
+		value++;
+	}
+	if( g_ascii_isdigit( *value ) )
+	{
+		seconds = g_ascii_strtoull( value, &end, 10 );
+		while( g_ascii_isspace( *end ) )
+		{
+			end++;
+		}
+		if( *end != '\0' )
+		{
+			return( -1 );
+		}
+		return( (gint64) MIN( seconds, G_MAXINT32 ) * G_USEC_PER_SEC );
+	}
+
+	date = curl_getdate( value, NULL );
+	if( date == -1 )
+	{
+		return( -1 );
+	}
+	if( date <= time( NULL ) )
+	{
+		return( 0 );
+	}
+	return( (gint64) ( date - time( NULL ) ) * G_USEC_PER_SEC );
+}
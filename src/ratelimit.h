@@ -0,0 +1,95 @@
+/**
+ * \file ratelimit.h
+ * \brief Definitions for request rate limiting and retry policy.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_RATELIMIT_H
+#define __GTASKS_RATELIMIT_H
+
+#include <config.h>
+#include <glib.h>
+#include <curl/curl.h>
+
+
+/* A token bucket that limits the rate at which requests are sent.  Tokens
+   accumulate at \a rate per second up to \a capacity, and each request
+   takes one token.  Times are monotonic times in microseconds. */
+typedef struct
+{
+	gdouble rate;
+	gdouble capacity;
+	gdouble tokens;
+	gint64  refilled;
+	/* No requests are sent before this time. */
+	gint64  paused_until;
+} rate_limiter_t;
+
+
+/*
+ * Create a token-bucket rate limiter.
+ */
+rate_limiter_t *create_rate_limiter( gdouble rate, guint burst );
+
+/*
+ * Destroy a rate limiter.
+ */
+void destroy_rate_limiter( rate_limiter_t *limiter );
+
+/*
+ * Count the requests that may be sent right away.
+ */
+guint count_rate_limiter_tokens( rate_limiter_t *limiter, gint64 now );
+
+/*
+ * Take tokens for a number of requests, or determine how long to wait for
+ * them.
+ */
+gint64 take_rate_limiter_tokens( rate_limiter_t *limiter, guint count,
+								 gint64 now );
+
+/*
+ * Stop sending requests until a specified time.
+ */
+void pause_rate_limiter( rate_limiter_t *limiter, gint64 until );
+
+/*
+ * Determine whether a failed request should be sent again.
+ */
+gboolean is_retryable_request( const gchar *method, CURLcode result,
+							   long http_status );
+
+/*
+ * Compute the jittered exponential backoff before a request is repeated.
+ */
+gint64 get_retry_delay( guint attempt, gint64 base_delay, gint64 max_delay );
+
+/*
+ * Combine the backoff with the server's Retry-After delay.
+ */
+gint64 get_retry_after_delay( gint64 backoff, gint64 retry_after,
+							  gint64 max_delay );
+
+/*
+ * Parse the value of a Retry-After header.
+ */
+gint64 parse_retry_after( const gchar *value );
+
+
+#endif /* __GTASKS_RATELIMIT_H */
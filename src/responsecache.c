@@ -0,0 +1,271 @@
+/**
+ * \file responsecache.c
+ * \brief On-disk cache of API responses for conditional requests.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gtasks2ical.h"
+#include "responsecache.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+
+/**
+ * Open the response cache in a directory, creating the directory if
+ * necessary.
+ * @param directory [in] Directory that holds the cached responses.
+ * @return New response cache, or \a NULL if the directory cannot be created.
+ */
+response_cache_t*
+create_response_cache( const gchar *directory )
+{
+	response_cache_t *cache;
+
+	if( g_mkdir_with_parents( directory, 0700 ) != 0 )
+	{
+		cache = NULL;
+	}
+	else
+	{
+		cache = g_new0( response_cache_t, 1 );
+		cache->directory = g_strdup( directory );
+	}
+
+	return( cache );
+}
+
+
+
+/**
+ * Close a response cache.  The cached responses remain on disk.
+ * @param cache [out] The response cache that is to be closed.
+ * @return Nothing.
+ */
+void
+destroy_response_cache( response_cache_t *cache )
+{
+	if( cache != NULL )
+	{
+		g_free( cache->directory );
+		g_free( cache );
+	}
+}
+
+
+
+/**
+ * Get the name of the file that caches the response for a URI.  The file
+ * name is a hash of the Gmail user and the URI, so that users who share the
+ * cache directory do not see each other's responses.
+ * @param cache [in] Response cache.
+ * @param uri [in] Request URI.
+ * @return Newly allocated file name.
+ */
+STATIC gchar*
+get_cache_file_name( const response_cache_t *cache, const gchar *uri )
+{
+	gchar *key;
+	gchar *hash;
+	gchar *file_name;
+
+	key = g_strconcat( global_config.gmail_username != NULL ?
+					   global_config.gmail_username : "", " ", uri, NULL );
+	hash = g_compute_checksum_for_string( G_CHECKSUM_SHA1, key, -1 );
+	file_name = g_build_filename( cache->directory, hash, NULL );
+	g_free( hash );
+	g_free( key );
+
+	return( file_name );
+}
+
+
+
+/**
+ * Look up the cached response for a URI.  The cache file holds the ETag on
+ * the first line followed by the response body.
+ * @param cache [in] Response cache.
+ * @param uri [in] Request URI.
+ * @param etag [out] ETag of the cached response, which must be freed.
+ * @param body [out] Body of the cached response, which must be freed.
+ * @return \a TRUE if a response for the URI is cached, or \a FALSE otherwise.
+ * Test: unit test (test-gtasks.c: response_cache).
+ */
+gboolean
+read_cached_response( const response_cache_t *cache, const gchar *uri,
+					  gchar **etag, gchar **body )
+{
+	gchar    *file_name;
+	gchar    *contents;
+	gchar    *end_of_etag;
+	gboolean found = FALSE;
+
+	*etag = NULL;
+	*body = NULL;
+	if( cache == NULL )
+	{
+		return( FALSE );
+	}
+	file_name = get_cache_file_name( cache, uri );
+	if( g_file_get_contents( file_name, &contents, NULL, NULL ) == TRUE )
+	{
+		end_of_etag = strchr( contents, '\n' );
+		if( ( end_of_etag != NULL ) && ( end_of_etag != contents ) )
+		{
+			*etag = g_strndup( contents, end_of_etag - contents );
+			*body = g_strdup( end_of_etag + 1 );
+			found = TRUE;
+		}
+		g_free( contents );
+	}
+	g_free( file_name );
+
+	return( found );
+}
+
+
+
+/**
+ * Store the response for a URI in the cache, replacing any previous
+ * response.
+ * @param cache [in] Response cache.
+ * @param uri [in] Request URI.
+ * @param etag [in] ETag of the response.
+ * @param body [in] Body of the response.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: response_cache).
+ */
+void
+store_cached_response( const response_cache_t *cache, const gchar *uri,
+					   const gchar *etag, const gchar *body )
+{
+	gchar *file_name;
+	gchar *contents;
+
+	if( ( cache == NULL ) || ( etag == NULL ) || ( body == NULL ) ||
+		( strchr( etag, '\n' ) != NULL ) )
+	{
+		return;
+	}
+	file_name = get_cache_file_name( cache, uri );
+	contents  = g_strconcat( etag, "\n", body, NULL );
+	g_file_set_contents( file_name, contents, -1, NULL );
+	g_free( contents );
+	g_free( file_name );
+}
+
+
+
+/**
+ * Begin writing the response for a URI to the cache while it is received.
+ * The response is written to a temporary file that replaces the cached
+ * response when the writer is ended.
+ * @param cache [in] Response cache.
+ * @param uri [in] Request URI.
+ * @param etag [in] ETag of the response.
+ * @return New writer, or \a NULL if the response cannot be cached.
+ */
+cached_response_writer_t*
+begin_cached_response( const response_cache_t *cache, const gchar *uri,
+					   const gchar *etag )
+{
+	cached_response_writer_t *writer;
+	FILE                     *file;
+	gchar                    *file_name;
+	gchar                    *temporary_file_name;
+
+	if( ( cache == NULL ) || ( etag == NULL ) ||
+		( strchr( etag, '\n' ) != NULL ) )
+	{
+		return( NULL );
+	}
+	file_name           = get_cache_file_name( cache, uri );
+	temporary_file_name = g_strconcat( file_name, ".new", NULL );
+	file = fopen( temporary_file_name, "w" );
+	if( file == NULL )
+	{
+		g_free( temporary_file_name );
+		g_free( file_name );
+		return( NULL );
+	}
+	fprintf( file, "%s\n", etag );
+
+	writer = g_new( cached_response_writer_t, 1 );
+	writer->file_name           = file_name;
+	writer->temporary_file_name = temporary_file_name;
+	writer->file                = file;
+
+	return( writer );
+}
+
+
+
+/**
+ * Write a chunk of a response to the cache.
+ * @param writer [in/out] Cached response writer.
+ * @param data [in] Chunk of the response body.
+ * @param length [in] Number of bytes in the chunk.
+ * @return Nothing.
+ */
+void
+write_cached_response( cached_response_writer_t *writer, const gchar *data,
+					   gsize length )
+{
+	if( writer != NULL )
+	{
+		fwrite( data, 1, length, writer->file );
+	}
+}
+
+
+
+/**
+ * Finish writing a response to the cache.  A kept response replaces the
+ * previously cached response for the URI; a discarded response is deleted.
+ * @param writer [out] Cached response writer, which is destroyed.
+ * @param keep [in] \a TRUE if the response is complete and should be kept.
+ * @return Nothing.
+ */
+void
+end_cached_response( cached_response_writer_t *writer, gboolean keep )
+{
+	if( writer != NULL )
+	{
+		if( ( fclose( writer->file ) != 0 ) || ( keep == FALSE ) ||
+			( g_rename( writer->temporary_file_name,
+						writer->file_name ) != 0 ) )
+		{
+			g_unlink( writer->temporary_file_name );
+		}
+		g_free( writer->temporary_file_name );
+		g_free( writer->file_name );
+		g_free( writer );
+	}
+}
+
@@ -0,0 +1,90 @@
+/**
+ * \file responsecache.h
+ * \brief Definitions for the on-disk cache of API responses.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_RESPONSECACHE_H
+#define __GTASKS_RESPONSECACHE_H
+
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+
+
+/* The response cache keeps the body and the ETag of API responses on disk,
+   keyed by the request URI, so that unchanged resources can be requested
+   conditionally with If-None-Match. */
+typedef struct
+{
+	gchar *directory;
+} response_cache_t;
+
+
+/* A response that is written to the cache while it is received. */
+typedef struct
+{
+	gchar *file_name;
+	gchar *temporary_file_name;
+	FILE  *file;
+} cached_response_writer_t;
+
+
+/*
+ * Open the response cache in the user's cache directory.
+ */
+response_cache_t *create_response_cache( const gchar *directory );
+
+/*
+ * Close a response cache.
+ */
+void destroy_response_cache( response_cache_t *cache );
+
+/*
+ * Look up the cached response for a URI.
+ */
+gboolean read_cached_response( const response_cache_t *cache,
+							   const gchar *uri, gchar **etag, gchar **body );
+
+/*
+ * Store the response for a URI in the cache.
+ */
+void store_cached_response( const response_cache_t *cache, const gchar *uri,
+							const gchar *etag, const gchar *body );
+
+/*
+ * Begin writing the response for a URI to the cache while it is received.
+ */
+cached_response_writer_t *begin_cached_response( const response_cache_t *cache,
+												 const gchar *uri,
+												 const gchar *etag );
+
+/*
+ * Write a chunk of a response to the cache.
+ */
+void write_cached_response( cached_response_writer_t *writer,
+							const gchar *data, gsize length );
+
+/*
+ * Finish writing a response to the cache, either keeping or discarding it.
+ */
+void end_cached_response( cached_response_writer_t *writer, gboolean keep );
+
+
+#endif /* __GTASKS_RESPONSECACHE_H */
@@ -0,0 +1,707 @@
+/**
+ * \file session.c
+ * \brief Persistent HTTP sessions shared by all requests to Google.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "postform.h"
+#include "session.h"
+#include "multirequest.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Global configuration data. */
+extern struct configuration_t global_config;
+
+
+/* Servers that the connections are pre-warmed to: the login server, and the
+   Tasks API server, which is used with the request engine's HTTP
+   version.  Both are pre-warmed in parallel. */
+#define PREWARM_LOGIN_URL "https://accounts.google.com/"
+#define PREWARM_API_URL   "https://www.googleapis.com/"
+
+/* Head start in milliseconds of IPv6 connection attempts to a host that
+   IPv4 connected to first. */
+#define IPV4_PREFERRED_HEAD_START 1
+
+/* Longest time in milliseconds that the pre-warming thread waits for
+   activity on its connections before it checks them again. */
+#define PREWARM_POLL_TIMEOUT 100
+
+
+
+/**
+ * Callback function that locks data in a session's CURL share.
+ * @param handle [in] CURL handle that accesses the data.
+ * @param data [in] The data that is locked.
+ * @param access [in] Shared or exclusive access.
+ * @param session_ptr [in/out] Pointer to the session.
+ * @return Nothing.
+ */
+STATIC void
+lock_session_share( CURL *handle, curl_lock_data data,
+					curl_lock_access access, void *session_ptr )
+{
+	gtasks_session_t *session = session_ptr;
+
+	g_mutex_lock( &session->share_locks[ data ] );
+}
+
+
+
+/**
+ * Callback function that unlocks data in a session's CURL share.
+ * @param handle [in] CURL handle that accessed the data.
+ * @param data [in] The data that is unlocked.
+ * @param session_ptr [in/out] Pointer to the session.
+ * @return Nothing.
+ */
+STATIC void
+unlock_session_share( CURL *handle, curl_lock_data data, void *session_ptr )
+{
+	gtasks_session_t *session = session_ptr;
+
+	g_mutex_unlock( &session->share_locks[ data ] );
+}
+
+
+
+/**
+ * Create a session with a CURL handle that is configured with the options
+ * that are common to all requests, and a CURL share that lets all handles
+ * in the session reuse DNS lookups and TLS sessions.
+ * @return New session, or \a NULL if CURL or the request engine could not
+ *         be initialized.
+ */
+gtasks_session_t*
+create_gtasks_session( void )
+{
+	gtasks_session_t *session;
+	guint            lock_idx;
+	gchar            *cache_directory;
+	gchar            *families_file;
+
+	session = g_new0( gtasks_session_t, 1 );
+	if( global_config.sync_deadline > 0 )
+	{
+		session->deadline = g_get_monotonic_time( ) +
+			(gint64) global_config.sync_deadline * G_USEC_PER_SEC;
+	}
+	for( lock_idx = 0; lock_idx < CURL_LOCK_DATA_LAST; lock_idx++ )
+	{
+		g_mutex_init( &session->share_locks[ lock_idx ] );
+	}
+
+	/* Measure the latencies if they are reported or used for hedging. */
+	if( ( global_config.verbose == TRUE ) ||
+		( global_config.latency_file != NULL ) ||
+		( global_config.hedged_requests == TRUE ) )
+	{
+		session->latency = create_latency_stats( );
+	}
+
+	/* Keep the address families in the user's cache directory. */
+	if( global_config.learn_address_families == TRUE )
+	{
+		cache_directory = g_build_filename( g_get_user_cache_dir( ),
+											"gtasks2ical", NULL );
+		if( g_mkdir_with_parents( cache_directory, 0700 ) == 0 )
+		{
+			families_file = g_build_filename( cache_directory,
+											  "address-families", NULL );
+			session->families = create_address_family_cache( families_file );
+			g_free( families_file );
+		}
+		g_free( cache_directory );
+	}
+
+	session->breakers = create_circuit_breakers(
+		global_config.circuit_failures,
+		(gint64) global_config.circuit_delay * G_USEC_PER_SEC );
+
+	session->strings = create_string_pool( );
+
+	/* Share DNS lookups and TLS sessions between all the handles of the
+	   session.  The share is also used by the pre-warming thread while the
+	   session's own handle is in use, and CURL does not support sharing
+	   cookies or connections between handles in different threads, so
+	   those stay with each handle and with the engine's multi handle. */
+	session->share = curl_share_init( );
+	if( session->share != NULL )
+	{
+		curl_share_setopt( session->share, CURLSHOPT_LOCKFUNC,
+						   lock_session_share );
+		curl_share_setopt( session->share, CURLSHOPT_UNLOCKFUNC,
+						   unlock_session_share );
+		curl_share_setopt( session->share, CURLSHOPT_USERDATA, session );
+		curl_share_setopt( session->share, CURLSHOPT_SHARE,
+						   CURL_LOCK_DATA_DNS );
+		curl_share_setopt( session->share, CURLSHOPT_SHARE,
+						   CURL_LOCK_DATA_SSL_SESSION );
+	}
+
+	/* Create the session's own handle. */
+	session->curl = curl_easy_init( );
+	if( session->curl == NULL )
+	{
+		if( session->share != NULL )
+		{
+			curl_share_cleanup( session->share );
+		}
+		for( lock_idx = 0; lock_idx < CURL_LOCK_DATA_LAST; lock_idx++ )
+		{
+			g_mutex_clear( &session->share_locks[ lock_idx ] );
+		}
+		destroy_address_family_cache( session->families );
+		destroy_circuit_breakers( session->breakers );
+		destroy_string_pool( session->strings );
+		if( session->latency != NULL )
+		{
+			destroy_latency_stats( session->latency );
+		}
+		g_free( session );
+		session = NULL;
+	}
+	else
+	{
+		configure_session_handle( session, session->curl );
+		/* Start a new cookie session. */
+		curl_easy_setopt( session->curl, CURLOPT_COOKIESESSION, 1 );
+		/* Create the engine that runs the Tasks API requests. */
+		session->engine = create_request_engine(
+			session, global_config.parallel_requests );
+		if( session->engine == NULL )
+		{
+			/* There are no latencies to report. */
+			if( session->latency != NULL )
+			{
+				destroy_latency_stats( session->latency );
+				session->latency = NULL;
+			}
+			destroy_gtasks_session( session );
+			session = NULL;
+		}
+	}
+
+	return( session );
+}
+
+
+
+/**
+ * Report the latencies of a session's requests on the console if verbose
+ * output is enabled, and in the latency file if one is configured.
+ * @param latency [in] Latency statistics of the session.
+ * @return Nothing.
+ */
+STATIC void
+report_session_latency( const latency_stats_t *latency )
+{
+	FILE *latency_file;
+
+	if( global_config.verbose == TRUE )
+	{
+		printf( "Request latencies:\n" );
+		write_latency_report( latency, stdout );
+	}
+	if( global_config.latency_file != NULL )
+	{
+		latency_file = fopen( global_config.latency_file, "w" );
+		if( latency_file != NULL )
+		{
+			write_latency_report( latency, latency_file );
+			fclose( latency_file );
+		}
+		else
+		{
+			g_fprintf( stderr, "Could not write latencies to %s\n",
+					   global_config.latency_file );
+		}
+	}
+}
+
+
+
+/**
+ * Release a session and all of its CURL resources.
+ * @param session [out] The session that is to be destroyed.
+ * @return Nothing.
+ */
+void
+destroy_gtasks_session( gtasks_session_t *session )
+{
+	guint lock_idx;
+
+	if( session != NULL )
+	{
+		/* The handles must be released before the share they use. */
+		if( session->prewarm_thread != NULL )
+		{
+			g_thread_join( session->prewarm_thread );
+		}
+		destroy_request_engine( session->engine );
+		destroy_address_family_cache( session->families );
+		if( session->latency != NULL )
+		{
+			report_session_latency( session->latency );
+			destroy_latency_stats( session->latency );
+		}
+		curl_easy_cleanup( session->curl );
+		if( session->share != NULL )
+		{
+			curl_share_cleanup( session->share );
+		}
+		curl_slist_free_all( session->api_headers );
+		g_free( session->access_token );
+		destroy_circuit_breakers( session->breakers );
+		destroy_string_pool( session->strings );
+		for( lock_idx = 0; lock_idx < CURL_LOCK_DATA_LAST; lock_idx++ )
+		{
+			g_mutex_clear( &session->share_locks[ lock_idx ] );
+		}
+		g_free( session );
+	}
+}
+
+
+
+/**
+ * Determine whether CURL can decompress gzip and deflate encoded responses.
+ * @return \a TRUE if compressed responses are supported, or \a FALSE
+ *         otherwise.
+ */
+STATIC gboolean
+is_compression_available( void )
+{
+	curl_version_info_data *version_info;
+
+	version_info = curl_version_info( CURLVERSION_NOW );
+
+	return( ( version_info->features & CURL_VERSION_LIBZ ) != 0 );
+}
+
+
+
+/**
+ * Create a handle that sends a HEAD request to a server, so that the DNS
+ * entry and the TLS session of the server end up in the session's share.
+ * @param session [in] Session whose share receives the DNS entry and the TLS
+ *        session.
+ * @param url [in] URL of the server.
+ * @param http_version [in] HTTP version that later requests to the server
+ *        ask for, so that the TLS session is negotiated with the same ALPN.
+ * @return New handle, or \a NULL if CURL could not create it.
+ */
+STATIC CURL*
+create_prewarm_handle( gtasks_session_t *session, const gchar *url,
+					   long http_version )
+{
+	CURL *curl;
+
+	curl = curl_easy_init( );
+	if( curl != NULL )
+	{
+		configure_session_handle( session, curl );
+		curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 0L );
+		curl_easy_setopt( curl, CURLOPT_NOBODY, 1L );
+		curl_easy_setopt( curl, CURLOPT_HTTP_VERSION, http_version );
+		apply_operation_deadlines( session, curl, OPERATION_LOGIN );
+		apply_address_family( session, curl, url );
+		curl_easy_setopt( curl, CURLOPT_URL, url );
+	}
+
+	return( curl );
+}
+
+
+
+/**
+ * Thread function that resolves the names of Google's servers and performs
+ * the TCP and TLS handshakes with both of them in parallel.  The DNS entries
+ * and TLS sessions end up in the session's share, where the session's
+ * requests find them.  The login server is added first because logging in
+ * is the first thing the session does.
+ * @param session_ptr [in] Pointer to the session.
+ * @return \a NULL.
+ */
+STATIC gpointer
+prewarm_connections( gpointer session_ptr )
+{
+	gtasks_session_t *session = session_ptr;
+	CURLM            *multi;
+	CURL             *curl[ 2 ];
+	const gchar      *urls[ 2 ] = { PREWARM_LOGIN_URL, PREWARM_API_URL };
+	int              running;
+	guint            url_idx;
+
+	multi = curl_multi_init( );
+	if( multi != NULL )
+	{
+		curl[ 0 ] = create_prewarm_handle( session, urls[ 0 ],
+										   CURL_HTTP_VERSION_NONE );
+		curl[ 1 ] = create_prewarm_handle(
+			session, urls[ 1 ],
+			( session->engine != NULL ) &&
+			( session->engine->multiplex == TRUE ) ?
+			CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1 );
+		for( url_idx = 0; url_idx < 2; url_idx++ )
+		{
+			if( curl[ url_idx ] != NULL )
+			{
+				curl_multi_add_handle( multi, curl[ url_idx ] );
+			}
+		}
+
+		/* Drive both handshakes until the HEAD requests are done. */
+		do
+		{
+			curl_multi_perform( multi, &running );
+			if( running > 0 )
+			{
+				curl_multi_wait( multi, NULL, 0, PREWARM_POLL_TIMEOUT, NULL );
+			}
+		} while( running > 0 );
+
+		for( url_idx = 0; url_idx < 2; url_idx++ )
+		{
+			if( curl[ url_idx ] != NULL )
+			{
+				learn_address_family( session, curl[ url_idx ],
+									  urls[ url_idx ] );
+				curl_multi_remove_handle( multi, curl[ url_idx ] );
+				curl_easy_cleanup( curl[ url_idx ] );
+			}
+		}
+		curl_multi_cleanup( multi );
+	}
+
+	return( NULL );
+}
+
+
+
+/**
+ * Begin connecting to Google's servers in the background, so that the
+ * handshakes overlap with the work that precedes the first requests.  The
+ * connections are not pre-warmed if the session has no share to keep the
+ * DNS entries and TLS sessions in, or if pre-warming is disabled.
+ * @param session [in/out] Session that receives the DNS entries and TLS
+ *        sessions.
+ * @return Nothing.
+ */
+void
+prewarm_session_connections( gtasks_session_t *session )
+{
+	if( ( global_config.prewarm_connections == TRUE ) &&
+		( session->share != NULL ) && ( session->prewarm_thread == NULL ) )
+	{
+		session->prewarm_thread = g_thread_new( "prewarm",
+												prewarm_connections,
+												session );
+	}
+}
+
+
+
+/**
+ * Apply the options that are common to all requests in a session to a CURL
+ * handle.  The options survive from one request to the next, so they are
+ * only set once per handle.
+ * @param session [in] The session that the handle belongs to.
+ * @param curl [in/out] CURL handle.
+ * @return Nothing.
+ */
+void
+configure_session_handle( const gtasks_session_t *session, CURL *curl )
+{
+	/*
+	curl_easy_setopt( curl, CURLOPT_VERBOSE, 1 );
+	*/
+	if( session->share != NULL )
+	{
+		curl_easy_setopt( curl, CURLOPT_SHARE, session->share );
+	}
+	/* Enable the cookie engine without reading any cookies from a file. */
+	curl_easy_setopt( curl, CURLOPT_COOKIEFILE, "" );
+	/* Ask for compressed responses, which CURL decompresses as the data
+	   arrives so that receive_curl_response only sees decompressed data.
+	   Google only compresses API responses if the user agent mentions
+	   gzip. */
+	if( ( global_config.compression == TRUE ) &&
+		( is_compression_available( ) == TRUE ) )
+	{
+		curl_easy_setopt( curl, CURLOPT_ACCEPT_ENCODING, "gzip, deflate" );
+		curl_easy_setopt( curl, CURLOPT_USERAGENT,
+						  PACKAGE_NAME "/" PACKAGE_VERSION " (gzip)" );
+	}
+	/* Assume redirections. */
+	curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1 );
+	curl_easy_setopt( curl, CURLOPT_UNRESTRICTED_AUTH, 1 );
+	/* All responses are received with receive_curl_response. */
+	curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, receive_curl_response );
+	curl_easy_setopt( curl, CURLOPT_HEADERDATA, NULL );
+	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, NULL );
+}
+
+
+
+/**
+ * Perform the request that has been set up on the session's CURL handle.
+ * Afterwards the per-request options are cleared, leaving the handle with
+ * the session options and with its connections intact.  The request fails
+ * without being sent if the server's circuit is open.
+ * @param session [in/out] Session with the request to perform.
+ * @param method [in] HTTP method of the request, which names its endpoint
+ *        in the latency statistics.
+ * @param url [in] URL of the request, whose server's circuit is updated
+ *        with the outcome.
+ * @return CURL result code of the request.
+ */
+CURLcode
+perform_session_request( gtasks_session_t *session, const gchar *method,
+						 const gchar *url )
+{
+	CURL     *curl = session->curl;
+	CURLcode errcode;
+	char     *effective_url;
+	long     http_status;
+
+	/* Don't start anything once the synchronization is out of time. */
+	if( is_session_expired( session ) == TRUE )
+	{
+		errcode = CURLE_OPERATION_TIMEDOUT;
+	}
+	else if( allow_circuit_request( session->breakers, url,
+									g_get_monotonic_time( ) ) == FALSE )
+	{
+		errcode = CURLE_COULDNT_CONNECT;
+	}
+	else
+	{
+		apply_operation_deadlines( session, curl, OPERATION_LOGIN );
+		apply_address_family( session, curl, url );
+		errcode = curl_easy_perform( curl );
+		learn_address_family( session, curl, url );
+		http_status = 0;
+		curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &http_status );
+		record_circuit_result( session->breakers, url, errcode, http_status,
+							   g_get_monotonic_time( ) );
+		if( session->latency != NULL )
+		{
+			effective_url = NULL;
+			curl_easy_getinfo( curl, CURLINFO_EFFECTIVE_URL, &effective_url );
+			record_request_latency( session->latency, method,
+									effective_url != NULL ?
+									effective_url : "", curl );
+		}
+	}
+	reset_session_handle( curl );
+
+	return( errcode );
+}
+
+
+
+/**
+ * Apply the deadlines of an operation class to a CURL handle:  the time to
+ * connect, the time that the transfer may stall below the low speed limit,
+ * and the time for the whole request, which is shortened to what remains of
+ * the session's synchronization deadline.  A deadline of 0 is disabled.
+ * @param session [in] Session with the synchronization deadline.
+ * @param curl [in/out] CURL handle.
+ * @param operation [in] Class of the operation that the handle performs.
+ * @return Nothing.
+ */
+void
+apply_operation_deadlines( const gtasks_session_t *session, CURL *curl,
+						   operation_class_t operation )
+{
+	const struct deadlines_t *deadlines =
+		&global_config.deadlines[ operation ];
+	gint64                   total;
+	gint64                   remaining;
+
+	curl_easy_setopt( curl, CURLOPT_CONNECTTIMEOUT, (long) deadlines->connect );
+	if( deadlines->low_speed > 0 )
+	{
+		curl_easy_setopt( curl, CURLOPT_LOW_SPEED_LIMIT,
+						  (long) global_config.low_speed_limit );
+		curl_easy_setopt( curl, CURLOPT_LOW_SPEED_TIME,
+						  (long) deadlines->low_speed );
+	}
+	else
+	{
+		curl_easy_setopt( curl, CURLOPT_LOW_SPEED_LIMIT, 0L );
+		curl_easy_setopt( curl, CURLOPT_LOW_SPEED_TIME, 0L );
+	}
+
+	/* The whole request must complete within its own deadline and within
+	   the synchronization deadline, whichever comes first. */
+	total = (gint64) deadlines->total * 1000;
+	if( session->deadline != 0 )
+	{
+		remaining = ( session->deadline - g_get_monotonic_time( ) ) / 1000;
+		if( remaining < 1 )
+		{
+			remaining = 1;
+		}
+		if( ( total == 0 ) || ( remaining < total ) )
+		{
+			total = remaining;
+		}
+	}
+	curl_easy_setopt( curl, CURLOPT_TIMEOUT_MS, (long) total );
+}
+
+
+
+/**
+ * Let IPv6 and IPv4 race to connect to a URL's host.  CURL tries IPv6
+ * first and IPv4 after the happy eyeballs timeout, unless IPv4 connected
+ * first to the host before, in which case IPv6 gets almost no head start.
+ * Either family may still win, so a host whose IPv6 path improves is
+ * learned again.
+ * @param session [in] Session with the address family cache.
+ * @param curl [in/out] CURL handle.
+ * @param url [in] URL of the request.
+ * @return Nothing.
+ */
+void
+apply_address_family( const gtasks_session_t *session, CURL *curl,
+					  const gchar *url )
+{
+	long head_start = global_config.happy_eyeballs_timeout;
+
+	if( get_preferred_address_family( session->families, url ) ==
+		ADDRESS_FAMILY_IPV4 )
+	{
+		head_start = MIN( head_start, IPV4_PREFERRED_HEAD_START );
+	}
+	curl_easy_setopt( curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, head_start );
+}
+
+
+
+/**
+ * Remember the address family that won the race to connect to a URL's host,
+ * if the request opened a new connection.
+ * @param session [in/out] Session with the address family cache.
+ * @param curl [in] CURL handle that performed the request.
+ * @param url [in] URL of the request.
+ * @return Nothing.
+ */
+void
+learn_address_family( gtasks_session_t *session, CURL *curl,
+					  const gchar *url )
+{
+	long connects = 0;
+	char *ip_address;
+
+	if( session->families != NULL )
+	{
+		curl_easy_getinfo( curl, CURLINFO_NUM_CONNECTS, &connects );
+		if( connects > 0 )
+		{
+			ip_address = NULL;
+			curl_easy_getinfo( curl, CURLINFO_PRIMARY_IP, &ip_address );
+			set_preferred_address_family( session->families, url,
+										  get_address_family( ip_address ) );
+		}
+	}
+}
+
+
+
+/**
+ * Determine whether the session's synchronization deadline has passed.
+ * @param session [in] Session.
+ * @return \a TRUE if the deadline has passed, or \a FALSE if it has not or
+ *         if the session has no deadline.
+ */
+gboolean
+is_session_expired( const gtasks_session_t *session )
+{
+	return( ( session->deadline != 0 ) &&
+			( g_get_monotonic_time( ) >= session->deadline ) );
+}
+
+
+
+/**
+ * Clear the per-request options of a CURL handle, returning it to a plain
+ * GET without headers, body, or form.  The session options are kept.
+ * @param curl [in/out] CURL handle.
+ * @return Nothing.
+ */
+void
+reset_session_handle( CURL *curl )
+{
+	curl_easy_setopt( curl, CURLOPT_CUSTOMREQUEST, NULL );
+	curl_easy_setopt( curl, CURLOPT_HTTPHEADER, NULL );
+	curl_easy_setopt( curl, CURLOPT_MIMEPOST, NULL );
+	curl_easy_setopt( curl, CURLOPT_POSTFIELDS, NULL );
+	curl_easy_setopt( curl, CURLOPT_POSTFIELDSIZE, -1L );
+	curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, receive_curl_response );
+	curl_easy_setopt( curl, CURLOPT_WRITEDATA, NULL );
+	curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, NULL );
+	curl_easy_setopt( curl, CURLOPT_HEADERDATA, NULL );
+	/* Setting the post options selects POST, so select GET last. */
+	curl_easy_setopt( curl, CURLOPT_HTTPGET, 1L );
+}
+
+
+
+/**
+ * Get the Tasks API request headers for an access token.  The header list
+ * is built once and reused for all requests with the same token.
+ * @param session [in/out] Session that caches the headers.
+ * @param access_token [in] The application's authorization token.
+ * @return Header list, which is owned by the session.
+ */
+struct curl_slist*
+get_session_api_headers( gtasks_session_t *session, const gchar *access_token )
+{
+	gchar *authorization;
+
+	if( ( session->api_headers == NULL ) ||
+		( g_strcmp0( session->access_token, access_token ) != 0 ) )
+	{
+		curl_slist_free_all( session->api_headers );
+		g_free( session->access_token );
+		session->access_token = g_strdup( access_token );
+
+		authorization = g_strconcat( "Authorization: Bearer ",
+									 access_token, NULL );
+		session->api_headers = curl_slist_append( NULL,
+												  "Accept: application/json" );
+		session->api_headers = curl_slist_append( session->api_headers,
+												  authorization );
+		g_free( authorization );
+	}
+
+	return( session->api_headers );
+}
@@ -0,0 +1,139 @@
+/**
+ * \file session.h
+ * \brief Definitions for persistent HTTP sessions.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_SESSION_H
+#define __GTASKS_SESSION_H
+
+#include <config.h>
+#include <glib.h>
+#include <curl/curl.h>
+#include "gtasks2ical.h"
+#include "latency.h"
+#include "circuitbreaker.h"
+#include "addressfamily.h"
+#include "stringpool.h"
+
+
+/* A session holds a CURL handle that is configured once with the options
+   shared by all requests, and a CURL share through which every handle in the
+   session reuses DNS lookups and TLS sessions for both accounts.google.com
+   and www.googleapis.com. */
+typedef struct
+{
+	CURL              *curl;
+	CURLSH            *share;
+	/* Locks that protect the data in the share, which is also used by the
+	   thread that pre-warms the DNS entries and TLS sessions. */
+	GMutex            share_locks[ CURL_LOCK_DATA_LAST ];
+	GThread           *prewarm_thread;
+
+	/* Request headers for the Tasks API, built once per access token. */
+	gchar             *access_token;
+	struct curl_slist *api_headers;
+
+	/* Engine that runs the Tasks API requests concurrently. */
+	struct request_engine_t *engine;
+
+	/* Latencies of the requests, or \a NULL if they are not measured. */
+	latency_stats_t   *latency;
+
+	/* Circuit breakers of Google's servers, or \a NULL if they are
+	   disabled. */
+	circuit_breakers_t *breakers;
+
+	/* Address family that connected first to each host, or \a NULL if the
+	   address families are not learned. */
+	address_family_cache_t *families;
+
+	/* Pool of the strings that repeat across the decoded tasks. */
+	string_pool_t     *strings;
+
+	/* Monotonic time when the synchronization must have completed, or 0 if
+	   it has no deadline. */
+	gint64            deadline;
+} gtasks_session_t;
+
+
+/*
+ * Create a session with a preconfigured CURL handle and a CURL share.
+ */
+gtasks_session_t *create_gtasks_session( void );
+
+/*
+ * Release a session and all of its CURL resources.
+ */
+void destroy_gtasks_session( gtasks_session_t *session );
+
+/*
+ * Begin connecting to Google's servers in the background.
+ */
+void prewarm_session_connections( gtasks_session_t *session );
+
+/*
+ * Apply the options that are common to all requests in a session to a CURL
+ * handle.
+ */
+void configure_session_handle( const gtasks_session_t *session, CURL *curl );
+
+/*
+ * Perform the request that has been set up on the session's CURL handle and
+ * clear the per-request options afterwards.
+ */
+CURLcode perform_session_request( gtasks_session_t *session,
+								  const gchar *method, const gchar *url );
+
+/*
+ * Apply the deadlines of an operation class to a CURL handle.
+ */
+void apply_operation_deadlines( const gtasks_session_t *session, CURL *curl,
+								operation_class_t operation );
+
+/*
+ * Give the address family that connected first to a URL's host a head start.
+ */
+void apply_address_family( const gtasks_session_t *session, CURL *curl,
+						   const gchar *url );
+
+/*
+ * Remember the address family of a new connection to a URL's host.
+ */
+void learn_address_family( gtasks_session_t *session, CURL *curl,
+						   const gchar *url );
+
+/*
+ * Determine whether the session's synchronization deadline has passed.
+ */
+gboolean is_session_expired( const gtasks_session_t *session );
+
+/*
+ * Clear the per-request options of a CURL handle.
+ */
+void reset_session_handle( CURL *curl );
+
+/*
+ * Get the Tasks API request headers for an access token.
+ */
+struct curl_slist *get_session_api_headers( gtasks_session_t *session,
+											const gchar *access_token );
+
+
+#endif /* __GTASKS_SESSION_H */
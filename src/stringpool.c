@@ -0,0 +1,258 @@
+/**
+ * \file stringpool.c
+ * \brief Intern repeated strings in a pool.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "stringpool.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Initial size of the hash table of a pool. */
+#define STRING_POOL_SLOTS 256
+
+/* Size of the blocks in which the strings of a pool are stored. */
+#define STRING_POOL_CHUNK 4096
+
+
+const gchar google_status_needs_action[ ] = "needsAction";
+const gchar google_status_completed[ ]    = "completed";
+
+/* Strings that every pool interns without copying them. */
+static const gchar *const well_known_strings[ ] =
+{
+	google_status_needs_action,
+	google_status_completed
+};
+
+
+
+/**
+ * Hash a string with FNV-1a.
+ * @param string [in] The string, which need not be terminated.
+ * @param length [in] Length of the string.
+ * @return Hash of the string.
+ */
+STATIC guint32
+hash_pool_string( const gchar *string, gsize length )
+{
+	guint32 hash = 2166136261u;
+	gsize   idx;
+
+	for( idx = 0; idx < length; idx++ )
+	{
+		hash = ( hash ^ (guchar) string[ idx ] ) * 16777619u;
+	}
+
+	return( hash ^ ( hash >> 15 ) );
+}
+
+
+
+/**
+ * Find the slot of a string in a pool's hash table.
+ * @param pool [in] String pool.
+ * @param string [in] The string.
+ * @param length [in] Length of the string.
+ * @param hash [in] Hash of the string.
+ * @return The slot that holds the string, or the empty slot where it
+ *         belongs.
+ */
+STATIC struct interned_string_t*
+find_pool_slot( const string_pool_t *pool, const gchar *string, gsize length,
+				guint32 hash )
+{
+	gsize                    mask = pool->size - 1;
+	gsize                    slot;
+	struct interned_string_t *entry;
+
+	for( slot = hash & mask; ; slot = ( slot + 1 ) & mask )
+	{
+		entry = &pool->slots[ slot ];
+		if( ( entry->string == NULL ) ||
+			( ( entry->hash == hash ) && ( entry->length == length ) &&
+			  ( memcmp( entry->string, string, length ) == 0 ) ) )
+		{
+			return( entry );
+		}
+	}
+}
+
+
+
+/**
+ * Double the size of a pool's hash table.
+ * @param pool [in/out] String pool.
+ * @return Nothing.
+ */
+STATIC void
+grow_string_pool( string_pool_t *pool )
+{
+	struct interned_string_t *old_slots = pool->slots;
+	gsize                    old_size   = pool->size;
+	gsize                    idx;
+	struct interned_string_t *entry;
+
+	pool->size  = 2 * old_size;
+	pool->slots = g_new0( struct interned_string_t, pool->size );
+	for( idx = 0; idx < old_size; idx++ )
+	{
+		if( old_slots[ idx ].string != NULL )
+		{
+			entry = find_pool_slot( pool, old_slots[ idx ].string,
+									old_slots[ idx ].length,
+									old_slots[ idx ].hash );
+			*entry = old_slots[ idx ];
+		}
+	}
+	g_free( old_slots );
+}
+
+
+
+/**
+ * Add a string to a pool's hash table.
+ * @param pool [in/out] String pool.
+ * @param entry [in/out] Empty slot where the string belongs.
+ * @param string [in] The string, which the pool stores as it is.
+ * @param length [in] Length of the string.
+ * @param hash [in] Hash of the string.
+ * @return Nothing.
+ */
+STATIC void
+add_pool_string( string_pool_t *pool, struct interned_string_t *entry,
+				 const gchar *string, gsize length, guint32 hash )
+{
+	entry->string = string;
+	entry->length = length;
+	entry->hash   = hash;
+	pool->count++;
+	/* Keep the table at most half full. */
+	if( 2 * pool->count > pool->size )
+	{
+		grow_string_pool( pool );
+	}
+}
+
+
+
+/**
+ * Create a string pool that holds the well-known strings.
+ * @return New string pool.
+ * Test: unit test (test-gtasks.c: string_pool).
+ */
+string_pool_t*
+create_string_pool( void )
+{
+	string_pool_t *pool;
+	gsize         idx;
+	const gchar   *string;
+	gsize         length;
+	guint32       hash;
+
+	pool = g_new0( string_pool_t, 1 );
+	pool->chunk = g_string_chunk_new( STRING_POOL_CHUNK );
+	pool->size  = STRING_POOL_SLOTS;
+	pool->slots = g_new0( struct interned_string_t, pool->size );
+	for( idx = 0; idx < G_N_ELEMENTS( well_known_strings ); idx++ )
+	{
+		string = well_known_strings[ idx ];
+		length = strlen( string );
+		hash   = hash_pool_string( string, length );
+		add_pool_string( pool, find_pool_slot( pool, string, length, hash ),
+						 string, length, hash );
+	}
+
+	return( pool );
+}
+
+
+
+/**
+ * Destroy a string pool and all the strings in it.
+ * @param pool [in/out] String pool, or \a NULL.
+ * @return Nothing.
+ */
+void
+destroy_string_pool( string_pool_t *pool )
+{
+	if( pool != NULL )
+	{
+		g_string_chunk_free( pool->chunk );
+		g_free( pool->slots );
+		g_free( pool );
+	}
+}
+
+
+
+/**
+ * Get the pool for strings that are interned without a session, such as
+ * strings that are decoded outside a request.  The pool is created when it
+ * is first used and lives as long as the program.
+ * @return The default string pool.
+ */
+string_pool_t*
+get_default_string_pool( void )
+{
+	static gsize default_pool = 0;
+
+	if( g_once_init_enter( &default_pool ) )
+	{
+		g_once_init_leave( &default_pool, (gsize) create_string_pool( ) );
+	}
+
+	return( (string_pool_t*) default_pool );
+}
+
+
+
+/**
+ * Intern a string in a pool.  The string is copied into the pool the first
+ * time it is interned; after that, the pool's copy is returned.
+ * @param pool [in/out] String pool.
+ * @param string [in] The string, which need not be terminated.
+ * @param length [in] Length of the string.
+ * @return The pool's copy of the string, which lives as long as the pool.
+ * Test: unit test (test-gtasks.c: string_pool).
+ */
+const gchar*
+intern_string( string_pool_t *pool, const gchar *string, gsize length )
+{
+	guint32                  hash;
+	struct interned_string_t *entry;
+	const gchar              *copy;
+
+	hash  = hash_pool_string( string, length );
+	entry = find_pool_slot( pool, string, length, hash );
+	if( entry->string != NULL )
+	{
+		return( entry->string );
+	}
+	copy = g_string_chunk_insert_len( pool->chunk, string, length );
+	add_pool_string( pool, entry, copy, length, hash );
+
+	return( copy );
+}
@@ -0,0 +1,81 @@
+/**
+ * \file stringpool.h
+ * \brief Definitions for the pool of interned strings.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_STRINGPOOL_H
+#define __GTASKS_STRINGPOOL_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* An interned string in a pool. */
+struct interned_string_t
+{
+	const gchar *string;
+	gsize       length;
+	guint32     hash;
+};
+
+/* A string pool keeps one copy of each string that is interned in it, so
+   that equal interned strings share their storage and can be compared by
+   pointer.  The strings are stored in \a chunk and found in an open
+   addressed hash table whose size is a power of two.  The strings live as
+   long as the pool. */
+typedef struct
+{
+	GStringChunk             *chunk;
+	struct interned_string_t *slots;
+	gsize                    size;
+	gsize                    count;
+} string_pool_t;
+
+
+/* Statuses of a Google Task.  Every pool interns the statuses as these
+   strings, so that an interned status can be compared with them by
+   pointer. */
+extern const gchar google_status_needs_action[ ];
+extern const gchar google_status_completed[ ];
+
+
+/*
+ * Create a string pool.
+ */
+string_pool_t *create_string_pool( void );
+
+/*
+ * Destroy a string pool and all the strings in it.
+ */
+void destroy_string_pool( string_pool_t *pool );
+
+/*
+ * Get the pool for strings that are interned without a session.
+ */
+string_pool_t *get_default_string_pool( void );
+
+/*
+ * Intern a string in a pool.
+ */
+const gchar *intern_string( string_pool_t *pool, const gchar *string,
+							gsize length );
+
+
+#endif /* __GTASKS_STRINGPOOL_H */
@@ -0,0 +1,876 @@
+/**
+ * \file taskschema.c
+ * \brief Generic handling of records that are described by a field schema.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include "gtasks2ical.h"
+#include "jsonpull.h"
+#include "taskschema.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Number of seeds that are tried for each size of the perfect hash table
+   before the table is made larger. */
+#define PERFECT_HASH_SEEDS 1000
+
+/* Access a member of a record. */
+#define STRING_MEMBER( record, field ) \
+	G_STRUCT_MEMBER( gchar*, record, ( field )->offset )
+#define INTERNED_MEMBER( record, field ) \
+	G_STRUCT_MEMBER( const gchar*, record, ( field )->offset )
+#define TIME_MEMBER( record, field ) \
+	G_STRUCT_MEMBER( gint64, record, ( field )->offset )
+#define BOOLEAN_MEMBER( record, field ) \
+	G_STRUCT_MEMBER( gboolean, record, ( field )->offset )
+#define RECORDS_MEMBER( record, field ) \
+	G_STRUCT_MEMBER( GSList*, record, ( field )->offset )
+
+
+/* The record that the members of a JSON object are decoded into. */
+struct schema_decoder_t
+{
+	record_schema_t *schema;
+	string_pool_t   *strings;
+	gpointer        record;
+};
+
+
+STATIC gpointer decode_schema_object( record_schema_t *schema,
+									  string_pool_t *strings,
+									  JsonObject *object );
+
+
+
+/**
+ * Hash a member name with a seed.  The hash is FNV-1a, whose initial value
+ * is varied by the seed.
+ * @param name [in] Member name, which need not be zero-terminated.
+ * @param length [in] Length of the member name.
+ * @param seed [in] Seed of the hash.
+ * @return Hash of the name.
+ */
+STATIC guint32
+hash_field_name( const gchar *name, gsize length, guint32 seed )
+{
+	guint32 hash = 2166136261u ^ ( seed * 0x9e3779b9u );
+	gsize   idx;
+
+	for( idx = 0; idx < length; idx++ )
+	{
+		hash = ( hash ^ (guchar) name[ idx ] ) * 16777619u;
+	}
+	hash ^= hash >> 15;
+
+	return( hash );
+}
+
+
+
+/**
+ * Place the member names of a schema in its hash table.
+ * @param schema [in/out] Schema of the record.
+ * @param seed [in] Seed of the hash.
+ * @param mask [in] Size of the hash table minus one.
+ * @return \a TRUE if no two names hashed to the same slot, or \a FALSE
+ *         otherwise.
+ */
+STATIC gboolean
+place_field_names( record_schema_t *schema, guint32 seed, guint32 mask )
+{
+	guint       idx;
+	const gchar *name;
+	guint32     slot;
+
+	memset( schema->slots, 0, sizeof( schema->slots ) );
+	for( idx = 0; idx < schema->field_count; idx++ )
+	{
+		name = schema->fields[ idx ].name;
+		if( name != NULL )
+		{
+			slot = hash_field_name( name, strlen( name ), seed ) & mask;
+			if( schema->slots[ slot ] != 0 )
+			{
+				return( FALSE );
+			}
+			schema->slots[ slot ] = idx + 1;
+		}
+	}
+	schema->seed = seed;
+	schema->mask = mask;
+
+	return( TRUE );
+}
+
+
+
+/**
+ * Build the perfect hash table of a schema's member names.  The smallest
+ * table of at least twice as many slots as there are members is tried
+ * first with a range of seeds, and it is doubled until a seed is found
+ * for which the names do not collide.
+ * @param schema [in/out] Schema of the record.
+ * @return Nothing.
+ */
+STATIC void
+prepare_schema( record_schema_t *schema )
+{
+	guint32 size;
+	guint32 seed;
+
+	g_assert( schema->field_count < SCHEMA_MAX_SLOTS / 2 );
+	for( size = 2; size < 2 * schema->field_count; size *= 2 )
+	{
+	}
+	for( ; size <= SCHEMA_MAX_SLOTS; size *= 2 )
+	{
+		for( seed = 0; seed < PERFECT_HASH_SEEDS; seed++ )
+		{
+			if( place_field_names( schema, seed, size - 1 ) == TRUE )
+			{
+				return;
+			}
+		}
+	}
+	g_error( "No perfect hash for a schema of %u fields", schema->field_count );
+}
+
+
+
+/**
+ * Find the field of a member in a schema.  Only the field in the member
+ * name's slot of the perfect hash table is compared with the name.
+ * @param schema [in/out] Schema of the record.
+ * @param name [in] JSON name of the member, which need not be
+ *        zero-terminated.
+ * @param length [in] Length of the name.
+ * @return The field of the member, or \a NULL if the schema has no member
+ *         of that name.
+ * Test: unit test (test-gtasks.c: task_schema).
+ */
+const schema_field_t*
+lookup_schema_field( record_schema_t *schema, const gchar *name, gsize length )
+{
+	guint8               slot;
+	const schema_field_t *field;
+
+	if( g_once_init_enter( &schema->prepared ) )
+	{
+		prepare_schema( schema );
+		g_once_init_leave( &schema->prepared, 1 );
+	}
+
+	slot = schema->slots[ hash_field_name( name, length, schema->seed ) &
+						  schema->mask ];
+	if( slot == 0 )
+	{
+		return( NULL );
+	}
+	field = &schema->fields[ slot - 1 ];
+	if( ( strncmp( field->name, name, length ) != 0 ) ||
+		( field->name[ length ] != '\0' ) )
+	{
+		return( NULL );
+	}
+
+	return( field );
+}
+
+
+
+/**
+ * Decode the value of a JSON member into the member of a record.
+ * @param field [in] Field of the member.
+ * @param strings [in/out] Pool that interned members are stored in, or
+ *        \a NULL for the default pool.
+ * @param node [in] Value of the JSON member.
+ * @param record [out] The record.
+ * @return Nothing.
+ */
+STATIC void
+decode_schema_field( const schema_field_t *field, string_pool_t *strings,
+					 JsonNode *node, gpointer record )
+{
+	const gchar *string;
+	const gchar *time_string;
+	JsonArray   *array;
+	JsonNode    *element;
+	guint       idx;
+
+	switch( field->type )
+	{
+		case FIELD_STRING:
+			if( JSON_NODE_HOLDS_VALUE( node ) )
+			{
+				g_free( STRING_MEMBER( record, field ) );
+				STRING_MEMBER( record, field ) = json_node_dup_string( node );
+			}
+			break;
+
+		case FIELD_INTERNED:
+			if( JSON_NODE_HOLDS_VALUE( node ) )
+			{
+				string = json_node_get_string( node );
+				INTERNED_MEMBER( record, field ) = ( string == NULL ) ? NULL :
+					intern_string( ( strings != NULL ) ?
+								   strings : get_default_string_pool( ),
+								   string, strlen( string ) );
+			}
+			break;
+
+		case FIELD_TIME:
+			if( JSON_NODE_HOLDS_VALUE( node ) )
+			{
+				time_string = json_node_get_string( node );
+				if( time_string != NULL )
+				{
+					parse_timestamp( time_string, strlen( time_string ),
+									 &TIME_MEMBER( record, field ) );
+				}
+			}
+			break;
+
+		case FIELD_BOOLEAN:
+			if( JSON_NODE_HOLDS_VALUE( node ) )
+			{
+				BOOLEAN_MEMBER( record, field ) =
+					json_node_get_boolean( node );
+			}
+			break;
+
+		case FIELD_RECORDS:
+			if( JSON_NODE_HOLDS_ARRAY( node ) )
+			{
+				array = json_node_get_array( node );
+				for( idx = 0; idx < json_array_get_length( array ); idx++ )
+				{
+					element = json_array_get_element( array, idx );
+					if( JSON_NODE_HOLDS_OBJECT( element ) )
+					{
+						RECORDS_MEMBER( record, field ) = g_slist_append(
+							RECORDS_MEMBER( record, field ),
+							decode_schema_object(
+								field->element, strings,
+								json_node_get_object( element ) ) );
+					}
+				}
+			}
+			break;
+	}
+}
+
+
+
+/**
+ * Decode a JSON member into a record.  Members that are not in the schema
+ * are ignored.
+ * @param schema [in/out] Schema of the record.
+ * @param strings [in/out] Pool that interned members are stored in, or
+ *        \a NULL for the default pool.
+ * @param name [in] Name of the JSON member.
+ * @param node [in] Value of the JSON member.
+ * @param record [out] The record.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: task_schema).
+ */
+void
+decode_schema_member( record_schema_t *schema, string_pool_t *strings,
+					  const gchar *name, JsonNode *node, gpointer record )
+{
+	const schema_field_t *field;
+
+	field = lookup_schema_field( schema, name, strlen( name ) );
+	if( field != NULL )
+	{
+		decode_schema_field( field, strings, node, record );
+	}
+}
+
+
+
+/**
+ * Callback function that decodes a member of a JSON object into a record.
+ * @param object [in] Unused.
+ * @param member_name [in] Name of the member.
+ * @param member_node [in] Value of the member.
+ * @param decoder_ptr [in/out] Pointer to the schema_decoder_t with the
+ *        record.
+ * @return Nothing.
+ */
+STATIC void
+decode_schema_foreach( JsonObject *object, const gchar *member_name,
+					   JsonNode *member_node, gpointer decoder_ptr )
+{
+	struct schema_decoder_t *decoder = decoder_ptr;
+
+	decode_schema_member( decoder->schema, decoder->strings, member_name,
+						  member_node, decoder->record );
+}
+
+
+
+/**
+ * Decode a JSON object into a new record.
+ * @param schema [in/out] Schema of the record.
+ * @param strings [in/out] Pool that interned members are stored in, or
+ *        \a NULL for the default pool.
+ * @param object [in] JSON object.
+ * @return The new record.
+ */
+STATIC gpointer
+decode_schema_object( record_schema_t *schema, string_pool_t *strings,
+					  JsonObject *object )
+{
+	struct schema_decoder_t decoder;
+
+	decoder.schema  = schema;
+	decoder.strings = strings;
+	decoder.record  = g_malloc0( schema->size );
+	json_object_foreach_member( object, decode_schema_foreach, &decoder );
+
+	return( decoder.record );
+}
+
+
+
+/**
+ * Intern a string token in the pull parser's string pool.  The token is
+ * looked up in place unless it is escaped.
+ * @param pull [in/out] Pull parser.
+ * @param token [in] String token.
+ * @return The interned string.
+ */
+STATIC const gchar*
+pull_interned_string( json_pull_t *pull, const json_token_t *token )
+{
+	string_pool_t *strings = pull->strings;
+	gchar         *string;
+	const gchar   *interned;
+
+	if( strings == NULL )
+	{
+		strings = get_default_string_pool( );
+	}
+	if( token->escaped == FALSE )
+	{
+		return( intern_string( strings, token->start, token->length ) );
+	}
+	string   = dup_json_string( token );
+	interned = intern_string( strings, string, strlen( string ) );
+	g_free( string );
+
+	return( interned );
+}
+
+
+
+/**
+ * Decode the value of a JSON member from a pull parser into the member of a
+ * record.  Values of the wrong type are skipped.
+ * @param pull [in/out] Pull parser before the value.
+ * @param field [in] Field of the member.
+ * @param record [out] The record.
+ * @return \a TRUE if the value was read, or \a FALSE if the document ended
+ *         or has a syntax error.
+ */
+STATIC gboolean
+pull_schema_field( json_pull_t *pull, const schema_field_t *field,
+				   gpointer record )
+{
+	json_token_t value;
+	gchar        *time_string;
+	gpointer     element;
+
+	next_json_token( pull, &value );
+	switch( field->type )
+	{
+		case FIELD_STRING:
+			if( value.type == JSON_TOKEN_STRING )
+			{
+				g_free( STRING_MEMBER( record, field ) );
+				STRING_MEMBER( record, field ) = dup_json_string( &value );
+				return( TRUE );
+			}
+			break;
+
+		case FIELD_INTERNED:
+			if( value.type == JSON_TOKEN_STRING )
+			{
+				INTERNED_MEMBER( record, field ) =
+					pull_interned_string( pull, &value );
+				return( TRUE );
+			}
+			break;
+
+		case FIELD_TIME:
+			if( value.type == JSON_TOKEN_STRING )
+			{
+				/* Time stamps are parsed in place unless they are
+				   escaped. */
+				if( value.escaped == FALSE )
+				{
+					parse_timestamp( value.start, value.length,
+									 &TIME_MEMBER( record, field ) );
+				}
+				else
+				{
+					time_string = dup_json_string( &value );
+					parse_timestamp( time_string, strlen( time_string ),
+									 &TIME_MEMBER( record, field ) );
+					g_free( time_string );
+				}
+				return( TRUE );
+			}
+			break;
+
+		case FIELD_BOOLEAN:
+			if( ( value.type == JSON_TOKEN_TRUE ) ||
+				( value.type == JSON_TOKEN_FALSE ) )
+			{
+				BOOLEAN_MEMBER( record, field ) =
+					( value.type == JSON_TOKEN_TRUE );
+				return( TRUE );
+			}
+			break;
+
+		case FIELD_RECORDS:
+			if( value.type == JSON_TOKEN_ARRAY_BEGIN )
+			{
+				while( next_json_token( pull, &value ) ==
+					   JSON_TOKEN_OBJECT_BEGIN )
+				{
+					element = g_malloc0( field->element->size );
+					RECORDS_MEMBER( record, field ) = g_slist_append(
+						RECORDS_MEMBER( record, field ), element );
+					if( pull_schema_members( pull, field->element,
+											 element ) == FALSE )
+					{
+						return( FALSE );
+					}
+				}
+				return( value.type == JSON_TOKEN_ARRAY_END );
+			}
+			break;
+	}
+
+	return( skip_json_value( pull, &value ) );
+}
+
+
+
+/**
+ * Decode the members of a JSON object from a pull parser into a record,
+ * through the end of the object.  Members that are not in the schema are
+ * skipped.
+ * @param pull [in/out] Pull parser after the beginning of the object.
+ * @param schema [in/out] Schema of the record.
+ * @param record [out] The record.
+ * @return \a TRUE if the object was read, or \a FALSE if the document ended
+ *         or has a syntax error.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+gboolean
+pull_schema_members( json_pull_t *pull, record_schema_t *schema,
+					 gpointer record )
+{
+	json_token_t         key;
+	json_token_t         value;
+	const schema_field_t *field;
+	gchar                *name;
+
+	while( next_json_token( pull, &key ) == JSON_TOKEN_STRING )
+	{
+		if( key.escaped == FALSE )
+		{
+			field = lookup_schema_field( schema, key.start, key.length );
+		}
+		else
+		{
+			name  = dup_json_string( &key );
+			field = lookup_schema_field( schema, name, strlen( name ) );
+			g_free( name );
+		}
+		if( field != NULL )
+		{
+			if( pull_schema_field( pull, field, record ) == FALSE )
+			{
+				return( FALSE );
+			}
+		}
+		else
+		{
+			next_json_token( pull, &value );
+			if( skip_json_value( pull, &value ) == FALSE )
+			{
+				return( FALSE );
+			}
+		}
+	}
+
+	return( key.type == JSON_TOKEN_OBJECT_END );
+}
+
+
+
+/**
+ * Decode a JSON object from a pull parser into a record.
+ * @param pull [in/out] Pull parser before the object.
+ * @param schema [in/out] Schema of the record.
+ * @param record [out] The record.
+ * @return \a TRUE if the object was read, or \a FALSE if the next value is
+ *         not an object, the document ended, or it has a syntax error.
+ * Test: unit test (test-gtasks.c: pull_decoder).
+ */
+gboolean
+pull_schema_record( json_pull_t *pull, record_schema_t *schema,
+					gpointer record )
+{
+	json_token_t token;
+
+	if( next_json_token( pull, &token ) != JSON_TOKEN_OBJECT_BEGIN )
+	{
+		skip_json_value( pull, &token );
+		return( FALSE );
+	}
+
+	return( pull_schema_members( pull, schema, record ) );
+}
+
+
+
+/**
+ * Append a string to a JSON document as a JSON string.
+ * @param json [in/out] JSON document.
+ * @param string [in] The string.
+ * @return Nothing.
+ */
+STATIC void
+append_json_string( GString *json, const gchar *string )
+{
+	const gchar *character;
+
+	g_string_append_c( json, '"' );
+	for( character = string; *character != '\0'; character++ )
+	{
+		switch( *character )
+		{
+			case '"':
+				g_string_append( json, "\\\"" );
+				break;
+			case '\\':
+				g_string_append( json, "\\\\" );
+				break;
+			case '\n':
+				g_string_append( json, "\\n" );
+				break;
+			case '\r':
+				g_string_append( json, "\\r" );
+				break;
+			case '\t':
+				g_string_append( json, "\\t" );
+				break;
+			default:
+				if( (guchar) *character < 0x20 )
+				{
+					g_string_append_printf( json, "\\u%04x",
+											(guchar) *character );
+				}
+				else
+				{
+					g_string_append_c( json, *character );
+				}
+				break;
+		}
+	}
+	g_string_append_c( json, '"' );
+}
+
+
+
+/**
+ * Append a time to a JSON document as an RFC 3339 time stamp in UTC.
+ * @param json [in/out] JSON document.
+ * @param time [in] The time.
+ * @return Nothing.
+ */
+STATIC void
+append_json_time( GString *json, gint64 time )
+{
+	g_string_append_c( json, '"' );
+	append_timestamp( json, time );
+	g_string_append_c( json, '"' );
+}
+
+
+
+/**
+ * Determine whether a member of a record is set.  Booleans are always set.
+ * @param field [in] Field of the member.
+ * @param record [in] The record.
+ * @return \a TRUE if the member is set, or \a FALSE otherwise.
+ */
+STATIC gboolean
+is_schema_member_set( const schema_field_t *field, gconstpointer record )
+{
+	switch( field->type )
+	{
+		case FIELD_TIME:
+			return( TIME_MEMBER( record, field ) != NO_TIMESTAMP );
+
+		case FIELD_BOOLEAN:
+			return( TRUE );
+
+		default:
+			return( G_STRUCT_MEMBER( gpointer, record, field->offset ) !=
+					NULL );
+	}
+}
+
+
+
+/**
+ * Append a record to a JSON document as a JSON object.  Members that are
+ * not exchanged with Google, and strings, times, and arrays that are not
+ * set, are left out.
+ * @param json [in/out] JSON document.
+ * @param schema [in] Schema of the record.
+ * @param record [in] The record.
+ * @return Nothing.
+ */
+STATIC void
+append_schema_record( GString *json, const record_schema_t *schema,
+					  gconstpointer record )
+{
+	guint                idx;
+	const schema_field_t *field;
+	gboolean             first = TRUE;
+	GSList               *element;
+
+	g_string_append_c( json, '{' );
+	for( idx = 0; idx < schema->field_count; idx++ )
+	{
+		field = &schema->fields[ idx ];
+		if( ( field->name == NULL ) ||
+			( is_schema_member_set( field, record ) == FALSE ) )
+		{
+			continue;
+		}
+		if( first == FALSE )
+		{
+			g_string_append_c( json, ',' );
+		}
+		first = FALSE;
+		append_json_string( json, field->name );
+		g_string_append_c( json, ':' );
+
+		switch( field->type )
+		{
+			case FIELD_STRING:
+				append_json_string( json, STRING_MEMBER( record, field ) );
+				break;
+
+			case FIELD_INTERNED:
+				append_json_string( json, INTERNED_MEMBER( record, field ) );
+				break;
+
+			case FIELD_TIME:
+				append_json_time( json, TIME_MEMBER( record, field ) );
+				break;
+
+			case FIELD_BOOLEAN:
+				g_string_append( json, BOOLEAN_MEMBER( record, field ) ?
+								 "true" : "false" );
+				break;
+
+			case FIELD_RECORDS:
+				g_string_append_c( json, '[' );
+				for( element = RECORDS_MEMBER( record, field );
+					 element != NULL; element = element->next )
+				{
+					append_schema_record( json, field->element,
+										  element->data );
+					if( element->next != NULL )
+					{
+						g_string_append_c( json, ',' );
+					}
+				}
+				g_string_append_c( json, ']' );
+				break;
+		}
+	}
+	g_string_append_c( json, '}' );
+}
+
+
+
+/**
+ * Encode a record as a JSON object, such as the body of a request that
+ * uploads a task.
+ * @param schema [in] Schema of the record.
+ * @param record [in] The record.
+ * @return Newly allocated JSON object.
+ * Test: unit test (test-gtasks.c: task_schema).
+ */
+gchar*
+encode_schema_record( const record_schema_t *schema, gconstpointer record )
+{
+	GString *json = g_string_new( NULL );
+
+	append_schema_record( json, schema, record );
+
+	return( g_string_free( json, FALSE ) );
+}
+
+
+
+/**
+ * Make a deep copy of a record, including the records in its arrays.
+ * @param schema [in] Schema of the record.
+ * @param record [in] The record.
+ * @return Newly allocated copy of the record.
+ * Test: unit test (test-gtasks.c: task_schema).
+ */
+gpointer
+copy_schema_record( const record_schema_t *schema, gconstpointer record )
+{
+	gpointer             copy;
+	guint                idx;
+	const schema_field_t *field;
+	GSList               *element;
+	GSList               *elements;
+
+	copy = g_malloc0( schema->size );
+	for( idx = 0; idx < schema->field_count; idx++ )
+	{
+		field = &schema->fields[ idx ];
+		switch( field->type )
+		{
+			case FIELD_STRING:
+				STRING_MEMBER( copy, field ) =
+					g_strdup( STRING_MEMBER( record, field ) );
+				break;
+
+			/* The copy shares the interned string. */
+			case FIELD_INTERNED:
+				INTERNED_MEMBER( copy, field ) =
+					INTERNED_MEMBER( record, field );
+				break;
+
+			case FIELD_TIME:
+				TIME_MEMBER( copy, field ) = TIME_MEMBER( record, field );
+				break;
+
+			case FIELD_BOOLEAN:
+				BOOLEAN_MEMBER( copy, field ) =
+					BOOLEAN_MEMBER( record, field );
+				break;
+
+			case FIELD_RECORDS:
+				elements = NULL;
+				for( element = RECORDS_MEMBER( record, field );
+					 element != NULL; element = element->next )
+				{
+					elements = g_slist_prepend(
+						elements, copy_schema_record( field->element,
+													  element->data ) );
+				}
+				RECORDS_MEMBER( copy, field ) = g_slist_reverse( elements );
+				break;
+		}
+	}
+
+	return( copy );
+}
+
+
+
+/**
+ * Free the members of a record, leaving the record empty.
+ * @param schema [in] Schema of the record.
+ * @param record [in/out] The record.
+ * @return Nothing.
+ */
+void
+clear_schema_record( const record_schema_t *schema, gpointer record )
+{
+	guint                idx;
+	const schema_field_t *field;
+	GSList               *element;
+
+	for( idx = 0; idx < schema->field_count; idx++ )
+	{
+		field = &schema->fields[ idx ];
+		switch( field->type )
+		{
+			case FIELD_STRING:
+				g_free( STRING_MEMBER( record, field ) );
+				STRING_MEMBER( record, field ) = NULL;
+				break;
+
+			/* Interned strings belong to their pool. */
+			case FIELD_INTERNED:
+				INTERNED_MEMBER( record, field ) = NULL;
+				break;
+
+			case FIELD_TIME:
+				TIME_MEMBER( record, field ) = NO_TIMESTAMP;
+				break;
+
+			case FIELD_BOOLEAN:
+				BOOLEAN_MEMBER( record, field ) = FALSE;
+				break;
+
+			case FIELD_RECORDS:
+				for( element = RECORDS_MEMBER( record, field );
+					 element != NULL; element = element->next )
+				{
+					destroy_schema_record( field->element, element->data );
+				}
+				g_slist_free( RECORDS_MEMBER( record, field ) );
+				RECORDS_MEMBER( record, field ) = NULL;
+				break;
+		}
+	}
+}
+
+
+
+/**
+ * Free a record and its members.
+ * @param schema [in] Schema of the record.
+ * @param record [in] The record, or \a NULL.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: task_schema).
+ */
+void
+destroy_schema_record( const record_schema_t *schema, gpointer record )
+{
+	if( record != NULL )
+	{
+		clear_schema_record( schema, record );
+		g_free( record );
+	}
+}
@@ -0,0 +1,152 @@
+/**
+ * \file taskschema.h
+ * \brief Definitions for records that are described by a field schema.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_TASKSCHEMA_H
+#define __GTASKS_TASKSCHEMA_H
+
+#include <config.h>
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include "jsonpull.h"
+#include "timestamp.h"
+
+
+/* Types of the members of a record. */
+typedef enum
+{
+	FIELD_STRING,
+	/* A string that repeats across records, such as a status, and is
+	   interned in a string pool that owns it. */
+	FIELD_INTERNED,
+	FIELD_TIME,
+	FIELD_BOOLEAN,
+	/* An array of records that are described by another schema. */
+	FIELD_RECORDS
+} field_type_t;
+
+/* The C types of the members, by field type. */
+#define FIELD_CTYPE_STRING   gchar*
+#define FIELD_CTYPE_INTERNED const gchar*
+#define FIELD_CTYPE_TIME     gint64
+#define FIELD_CTYPE_BOOLEAN  gboolean
+#define FIELD_CTYPE_RECORDS  GSList*
+
+/* A record's members are listed once, in a macro that applies the macro
+   passed to it to each member as FIELD( member, JSON name, type, element
+   schema ).  The JSON name is \a NULL if the member is not exchanged with
+   Google, and the element schema is \a NULL unless the type is RECORDS.
+   DECLARE_SCHEMA_MEMBER expands such a list to the members of the record's
+   structure, and DESCRIBE_SCHEMA_FIELD expands it to the fields of the
+   record's schema, where SCHEMA_STRUCTURE names the structure. */
+#define DECLARE_SCHEMA_MEMBER( member, json_name, type, element ) \
+	FIELD_CTYPE_##type member;
+
+#define DESCRIBE_SCHEMA_FIELD( member, json_name, type, element ) \
+	{ json_name, FIELD_##type,                                    \
+	  G_STRUCT_OFFSET( SCHEMA_STRUCTURE, member ), element },
+
+
+/* Largest number of slots in the perfect hash of a schema's member names. */
+#define SCHEMA_MAX_SLOTS 256
+
+struct record_schema_t;
+
+/* A member of a record. */
+typedef struct
+{
+	const gchar                  *name;
+	field_type_t                 type;
+	glong                        offset;
+	struct record_schema_t       *element;
+} schema_field_t;
+
+/* The schema of a record type.  The JSON names of the members are placed in
+   a perfect hash table the first time the schema is used:  the name hashed
+   with \a seed and masked with \a mask indexes the slot that holds the
+   field's index plus one, so that a member is found with a single
+   comparison. */
+typedef struct record_schema_t
+{
+	gsize                size;
+	const schema_field_t *fields;
+	guint                field_count;
+	gsize                prepared;
+	guint32              seed;
+	guint32              mask;
+	guint8               slots[ SCHEMA_MAX_SLOTS ];
+} record_schema_t;
+
+/* Initializer of a schema from the fields that DESCRIBE_SCHEMA_FIELD
+   expands. */
+#define RECORD_SCHEMA( structure, fields ) \
+	{ sizeof( structure ), fields, G_N_ELEMENTS( fields ), 0, 0, 0, { 0 } }
+
+
+/*
+ * Find the field of a member in a schema.
+ */
+const schema_field_t *lookup_schema_field( record_schema_t *schema,
+										   const gchar *name, gsize length );
+
+/*
+ * Decode a JSON member into a record.
+ */
+void decode_schema_member( record_schema_t *schema, string_pool_t *strings,
+						   const gchar *name, JsonNode *node,
+						   gpointer record );
+
+/*
+ * Decode a JSON object from a pull parser into a record.
+ */
+gboolean pull_schema_record( json_pull_t *pull, record_schema_t *schema,
+							 gpointer record );
+
+/*
+ * Decode the members of a JSON object from a pull parser into a record.
+ */
+gboolean pull_schema_members( json_pull_t *pull, record_schema_t *schema,
+							  gpointer record );
+
+/*
+ * Encode a record as a JSON object.
+ */
+gchar *encode_schema_record( const record_schema_t *schema,
+							 gconstpointer record );
+
+/*
+ * Make a deep copy of a record.
+ */
+gpointer copy_schema_record( const record_schema_t *schema,
+							 gconstpointer record );
+
+/*
+ * Free the members of a record.
+ */
+void clear_schema_record( const record_schema_t *schema, gpointer record );
+
+/*
+ * Free a record and its members.
+ */
+void destroy_schema_record( const record_schema_t *schema, gpointer record );
+
+
+#endif /* __GTASKS_TASKSCHEMA_H */
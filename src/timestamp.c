@@ -0,0 +1,345 @@
+/**
+ * \file timestamp.c
+ * \brief Parse and format RFC 3339 time stamps.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include "gtasks2ical.h"
+#include "timestamp.h"
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wunused-variable"
+
+
+/* Length of the shortest time stamp, "YYYY-MM-DDTHH:MM:SSZ". */
+#define MIN_TIMESTAMP_LENGTH 20
+
+/* Days between 0000-03-01 and the Unix epoch. */
+#define EPOCH_DAYS 719468
+
+/* Days in a 400-year era of the Gregorian calendar. */
+#define ERA_DAYS 146097
+
+#define SECONDS_PER_DAY ( 24 * 60 * 60 )
+
+
+
+/**
+ * Read two decimal digits.  Non-digits are noted instead of branched on, so
+ * that a time stamp is validated once all of its digits have been read.
+ * @param digits [in] The digits.
+ * @param invalid [in/out] Set to non-zero if either character is not a
+ *        digit.
+ * @return Value of the digits.
+ */
+STATIC guint
+read_two_digits( const gchar *digits, guint *invalid )
+{
+	guint tens  = (guchar) digits[ 0 ] - '0';
+	guint units = (guchar) digits[ 1 ] - '0';
+
+	*invalid |= ( tens > 9 ) | ( units > 9 );
+
+	return( tens * 10 + units );
+}
+
+
+
+/**
+ * Determine the number of days in a month.
+ * @param year [in] Year.
+ * @param month [in] Month, from 1 to 12.
+ * @return Number of days in the month.
+ */
+STATIC guint
+get_days_in_month( guint year, guint month )
+{
+	static const guint days[ ] =
+	{
+		31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	gboolean leap_year;
+
+	leap_year = ( ( year % 4 == 0 ) && ( year % 100 != 0 ) ) ||
+		( year % 400 == 0 );
+
+	return( days[ month - 1 ] + ( ( month == 2 ) && leap_year ) );
+}
+
+
+
+/**
+ * Count the days from the Unix epoch to a date in the Gregorian calendar.
+ * @param year [in] Year.
+ * @param month [in] Month, from 1 to 12.
+ * @param day [in] Day of the month.
+ * @return Number of days since 1970-01-01.
+ */
+STATIC gint64
+get_days_from_civil( gint64 year, guint month, guint day )
+{
+	gint64 era;
+	guint  year_of_era;
+	guint  day_of_year;
+	guint  day_of_era;
+
+	/* Count the years from March, so that the leap day is the last day of
+	   the year. */
+	year -= ( month <= 2 );
+	era         = ( year >= 0 ? year : year - 399 ) / 400;
+	year_of_era = year - era * 400;
+	day_of_year = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 +
+		day - 1;
+	day_of_era  = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+		day_of_year;
+
+	return( era * ERA_DAYS + day_of_era - EPOCH_DAYS );
+}
+
+
+
+/**
+ * Find the date in the Gregorian calendar of a number of days from the Unix
+ * epoch.
+ * @param days [in] Number of days since 1970-01-01.
+ * @param year [out] Year.
+ * @param month [out] Month, from 1 to 12.
+ * @param day [out] Day of the month.
+ * @return Nothing.
+ */
+STATIC void
+get_civil_from_days( gint64 days, gint64 *year, guint *month, guint *day )
+{
+	gint64 era;
+	guint  day_of_era;
+	guint  year_of_era;
+	guint  day_of_year;
+	guint  march_month;
+
+	days += EPOCH_DAYS;
+	era         = ( days >= 0 ? days : days - ( ERA_DAYS - 1 ) ) / ERA_DAYS;
+	day_of_era  = days - era * ERA_DAYS;
+	year_of_era = ( day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+					day_of_era / ( ERA_DAYS - 1 ) ) / 365;
+	day_of_year = day_of_era -
+		( 365 * year_of_era + year_of_era / 4 - year_of_era / 100 );
+	march_month = ( 5 * day_of_year + 2 ) / 153;
+
+	*day   = day_of_year - ( 153 * march_month + 2 ) / 5 + 1;
+	*month = march_month < 10 ? march_month + 3 : march_month - 9;
+	*year  = year_of_era + era * 400 + ( *month <= 2 );
+}
+
+
+
+/**
+ * Parse an RFC 3339 time stamp such as "2012-06-01T10:20:30.000Z" or
+ * "2012-06-01T12:20:30+02:00".  The fixed fields are read without branching
+ * on their contents, and fractions beyond microseconds are truncated.
+ * @param string [in] Time stamp, which need not be terminated.
+ * @param length [in] Length of the time stamp.
+ * @param timestamp [out] Microseconds since the Unix epoch in UTC.
+ * @return \a TRUE if the time stamp is valid, or \a FALSE otherwise, in
+ *         which case \a timestamp is unchanged.
+ * Test: unit test (test-gtasks.c: timestamp).
+ */
+gboolean
+parse_timestamp( const gchar *string, gsize length, gint64 *timestamp )
+{
+	const gchar *end = string + length;
+	const gchar *position;
+	const gchar *fraction;
+	guint       invalid = 0;
+	guint       year;
+	guint       month;
+	guint       day;
+	guint       hour;
+	guint       minute;
+	guint       second;
+	gint64      microsecond = 0;
+	gint64      scale       = G_USEC_PER_SEC / 10;
+	guint       offset_hours;
+	guint       offset_minutes;
+	gint        offset      = 0;
+	gint64      seconds;
+
+	if( ( string == NULL ) || ( length < MIN_TIMESTAMP_LENGTH ) )
+	{
+		return( FALSE );
+	}
+
+	year   = read_two_digits( string, &invalid ) * 100 +
+		read_two_digits( string + 2, &invalid );
+	month  = read_two_digits( string + 5, &invalid );
+	day    = read_two_digits( string + 8, &invalid );
+	hour   = read_two_digits( string + 11, &invalid );
+	minute = read_two_digits( string + 14, &invalid );
+	second = read_two_digits( string + 17, &invalid );
+	invalid |= ( string[ 4 ] != '-' ) | ( string[ 7 ] != '-' ) |
+		( ( string[ 10 ] | 0x20 ) != 't' ) | ( string[ 13 ] != ':' ) |
+		( string[ 16 ] != ':' );
+	invalid |= ( month - 1 > 11 ) | ( day - 1 > 30 ) | ( hour > 23 ) |
+		( minute > 59 ) | ( second > 60 );
+
+	/* Read the fraction of a second. */
+	position = string + 19;
+	if( *position == '.' )
+	{
+		fraction = ++position;
+		while( ( position < end ) && g_ascii_isdigit( *position ) )
+		{
+			microsecond += ( *position - '0' ) * scale;
+			scale /= 10;
+			position++;
+		}
+		invalid |= ( position == fraction );
+	}
+
+	/* Read the offset from UTC. */
+	if( ( position < end ) && ( ( *position | 0x20 ) == 'z' ) )
+	{
+		position++;
+	}
+	else if( ( end - position >= 6 ) &&
+			 ( ( *position == '+' ) || ( *position == '-' ) ) )
+	{
+		offset_hours   = read_two_digits( position + 1, &invalid );
+		offset_minutes = read_two_digits( position + 4, &invalid );
+		invalid |= ( position[ 3 ] != ':' ) | ( offset_hours > 23 ) |
+			( offset_minutes > 59 );
+		offset = offset_hours * 60 + offset_minutes;
+		if( *position == '-' )
+		{
+			offset = -offset;
+		}
+		position += 6;
+	}
+	else
+	{
+		invalid = 1;
+	}
+
+	if( ( invalid != 0 ) || ( position != end ) ||
+		( day > get_days_in_month( year, month ) ) )
+	{
+		return( FALSE );
+	}
+
+	seconds = get_days_from_civil( year, month, day ) * SECONDS_PER_DAY +
+		( (gint64) hour * 60 + minute - offset ) * 60 + second;
+	*timestamp = seconds * G_USEC_PER_SEC + microsecond;
+
+	return( TRUE );
+}
+
+
+
+/**
+ * Split a time into seconds and microseconds, rounding the seconds down.
+ * @param timestamp [in] Microseconds since the Unix epoch.
+ * @param microsecond [out] Microseconds into the second.
+ * @return Seconds since the Unix epoch.
+ */
+STATIC gint64
+split_timestamp( gint64 timestamp, glong *microsecond )
+{
+	gint64 seconds = timestamp / G_USEC_PER_SEC;
+
+	*microsecond = timestamp % G_USEC_PER_SEC;
+	if( *microsecond < 0 )
+	{
+		*microsecond += G_USEC_PER_SEC;
+		seconds--;
+	}
+
+	return( seconds );
+}
+
+
+
+/**
+ * Append a time to a string as an RFC 3339 time stamp in UTC with
+ * milliseconds, which is the format that Google uses.
+ * @param string [in/out] The string.
+ * @param timestamp [in] Microseconds since the Unix epoch in UTC.
+ * @return Nothing.
+ * Test: unit test (test-gtasks.c: timestamp).
+ */
+void
+append_timestamp( GString *string, gint64 timestamp )
+{
+	gint64 seconds;
+	glong  microsecond;
+	gint64 days;
+	gint   second_of_day;
+	gint64 year;
+	guint  month;
+	guint  day;
+
+	seconds       = split_timestamp( timestamp, &microsecond );
+	days          = seconds / SECONDS_PER_DAY;
+	second_of_day = seconds % SECONDS_PER_DAY;
+	if( second_of_day < 0 )
+	{
+		second_of_day += SECONDS_PER_DAY;
+		days--;
+	}
+	get_civil_from_days( days, &year, &month, &day );
+
+	g_string_append_printf( string, "%04" G_GINT64_FORMAT
+							"-%02u-%02uT%02d:%02d:%02d.%03ldZ",
+							year, month, day, second_of_day / 3600,
+							second_of_day / 60 % 60, second_of_day % 60,
+							microsecond / 1000 );
+}
+
+
+
+/**
+ * Convert a time to a local GDateTime, which is only needed to format the
+ * time for the user.
+ * @param timestamp [in] Microseconds since the Unix epoch in UTC.
+ * @return The time in the local time zone, or \a NULL if the time is not
+ *         set.
+ */
+GDateTime*
+timestamp_to_date_time( gint64 timestamp )
+{
+	GDateTime *whole_seconds;
+	GDateTime *date_time;
+	gint64    seconds;
+	glong     microsecond;
+
+	if( timestamp == NO_TIMESTAMP )
+	{
+		return( NULL );
+	}
+	seconds       = split_timestamp( timestamp, &microsecond );
+	whole_seconds = g_date_time_new_from_unix_local( seconds );
+	if( whole_seconds == NULL )
+	{
+		return( NULL );
+	}
+	date_time = g_date_time_add( whole_seconds, microsecond );
+	g_date_time_unref( whole_seconds );
+
+	return( date_time );
+}
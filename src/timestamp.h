@@ -0,0 +1,52 @@
+/**
+ * \file timestamp.h
+ * \brief Definitions for RFC 3339 time stamps.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ *
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTASKS_TIMESTAMP_H
+#define __GTASKS_TIMESTAMP_H
+
+#include <config.h>
+#include <glib.h>
+
+
+/* Times are stored as microseconds since the Unix epoch in UTC.  A time of 0
+   means that the time is not set; Google never sends the epoch itself. */
+#define NO_TIMESTAMP 0
+
+
+/*
+ * Parse an RFC 3339 time stamp.
+ */
+gboolean parse_timestamp( const gchar *string, gsize length,
+						  gint64 *timestamp );
+
+/*
+ * Append a time to a string as an RFC 3339 time stamp in UTC.
+ */
+void append_timestamp( GString *string, gint64 timestamp );
+
+/*
+ * Convert a time to a local GDateTime for formatting.
+ */
+GDateTime *timestamp_to_date_time( gint64 timestamp );
+
+
+#endif /* __GTASKS_TIMESTAMP_H */
@@ -0,0 +1,1565 @@
+/**
+ * \file test-gtasks.c
+ * \brief Test the Google Tasks API functions.
+ *
+ * Copyright (C) 2012 Ole Wolf <wolf@blazingangles.com>
+ *
+ * This file is part of gtasks2ical.
+ * 
+ * gtasks2ical is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <zlib.h>
+#include <curl/curl.h>
+#include <json-glib/json-glib.h>
+#include "gtasks2ical.h"
+#include "postform.h"
+#include "session.h"
+#include "multirequest.h"
+#include "gtasks.h"
+#include "batch.h"
+#include "responsecache.h"
+#include "bufferpool.h"
+#include "jsonstream.h"
+#include "ratelimit.h"
+#include "latency.h"
+#include "concurrency.h"
+#include "circuitbreaker.h"
+#include "addressfamily.h"
+#include "compressbody.h"
+#include "taskschema.h"
+#include "jsonpull.h"
+#include "jsonscan.h"
+#include "timestamp.h"
+#include "stringpool.h"
+#include "testfunctions.h"
+
+
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+
+struct configuration_t global_config;
+
+extern gchar *build_fields_mask( json_pull_decoder pull_decoder );
+extern gboolean pull_task_list( json_pull_t *pull, gpointer list_ptr );
+extern gboolean pull_task( json_pull_t *pull, gpointer task_ptr );
+extern gboolean pull_task_page( json_pull_t *pull, gpointer page_ptr );
+extern void start_pending_requests( request_engine_t *engine );
+extern void finish_buffered_request( request_engine_t *engine,
+									 api_request_t *request );
+extern void hedge_slow_requests( request_engine_t *engine );
+extern void cancel_hedge_request( request_engine_t *engine,
+								  api_request_t *request );
+
+
+static void test__request_engine( const char *param );
+static void test__wait_for_api_request( const char *param );
+static void test__build_batch_body( const char *param );
+static void test__demultiplex_batch_response( const char *param );
+static void test__response_cache( const char *param );
+static void test__build_fields_mask( const char *param );
+static void test__buffer_pool( const char *param );
+static void test__json_stream( const char *param );
+static void test__rate_limiter( const char *param );
+static void test__latency_histogram( const char *param );
+static void test__coalesce_requests( const char *param );
+static void test__concurrency_limiter( const char *param );
+static void test__circuit_breaker( const char *param );
+static void test__address_family_cache( const char *param );
+static void test__compress_request_body( const char *param );
+static void test__task_schema( const char *param );
+static void test__pull_decoder( const char *param );
+static void test__json_scanner( const char *param );
+static void test__timestamp( const char *param );
+static void test__string_pool( const char *param );
+static void test__hedge_requests( const char *param );
+
+
+const struct dispatch_table_t dispatch_table[ ] =
+{
+	DISPATCHENTRY( request_engine ),
+	DISPATCHENTRY( wait_for_api_request ),
+	DISPATCHENTRY( build_batch_body ),
+	DISPATCHENTRY( demultiplex_batch_response ),
+	DISPATCHENTRY( response_cache ),
+	DISPATCHENTRY( build_fields_mask ),
+	DISPATCHENTRY( buffer_pool ),
+	DISPATCHENTRY( json_stream ),
+	DISPATCHENTRY( rate_limiter ),
+	DISPATCHENTRY( latency_histogram ),
+	DISPATCHENTRY( coalesce_requests ),
+	DISPATCHENTRY( concurrency_limiter ),
+	DISPATCHENTRY( circuit_breaker ),
+	DISPATCHENTRY( address_family_cache ),
+	DISPATCHENTRY( compress_request_body ),
+	DISPATCHENTRY( task_schema ),
+	DISPATCHENTRY( pull_decoder ),
+	DISPATCHENTRY( json_scanner ),
+	DISPATCHENTRY( timestamp ),
+	DISPATCHENTRY( string_pool ),
+	DISPATCHENTRY( hedge_requests ),
+
+	{ NULL, NULL }
+};
+
+
+
+/* Build a file:// URL to a file in the test data directory. */
+static gchar*
+data_file_url( const gchar *filename )
+{
+	gchar cwd[ 1000 ];
+
+	getcwd( cwd, sizeof( cwd ) );
+	return( g_strconcat( "file://", cwd, "/../../data/", filename, NULL ) );
+}
+
+
+
+/* Decode a member of a task list from a JSON tree. */
+static void
+copy_list_member( const gchar *member_name, JsonNode *member_node,
+				  gpointer list_ptr )
+{
+	decode_schema_member( &gtask_list_schema, NULL, member_name,
+						  member_node, list_ptr );
+}
+
+
+
+/* Decode a member of a task from a JSON tree. */
+static void
+copy_task_member( const gchar *member_name, JsonNode *member_node,
+				  gpointer task_ptr )
+{
+	decode_schema_member( &gtask_schema, NULL, member_name, member_node,
+						  task_ptr );
+}
+
+
+
+/* Add a task in the "items" array of a JSON tree to a page. */
+static void
+copy_page_task( JsonArray *items, guint index, JsonNode *node,
+				gpointer page_ptr )
+{
+	struct tasks_page_t   *tasks_page = page_ptr;
+	struct json_wrapper_t json_wrapper;
+	gtask_t               *task;
+
+	task = g_new0( gtask_t, 1 );
+	json_wrapper.function = copy_task_member;
+	json_wrapper.data     = task;
+	json_object_foreach_member( json_node_get_object( node ),
+								decode_json_foreach_wrapper, &json_wrapper );
+	tasks_page->tasks = g_slist_append( tasks_page->tasks, task );
+}
+
+
+
+/* Decode a page of tasks from a JSON tree, to compare with the pull
+   decoder. */
+static void
+copy_page_member( const gchar *name, JsonNode *node, gpointer page_ptr )
+{
+	struct tasks_page_t *tasks_page = page_ptr;
+
+	if( g_strcmp0( name, "nextPageToken" ) == 0 )
+	{
+		tasks_page->next_page = json_node_dup_string( node );
+	}
+	else if( g_strcmp0( name, "items" ) == 0 )
+	{
+		json_array_foreach_element( json_node_get_array( node ),
+									copy_page_task, tasks_page );
+	}
+}
+
+
+
+static void
+test__request_engine( const char *param )
+{
+	gtasks_session_t *session;
+	gchar            *filename;
+	gchar            *url;
+	gtask_list_t     lists[ 3 ];
+	api_request_t    *request;
+	int              list_idx;
+	int              collected = 0;
+
+	/* Allow only two requests in flight at the same time. */
+	global_config.parallel_requests = 2;
+	session = create_gtasks_session( );
+	memset( lists, 0, sizeof( lists ) );
+	for( list_idx = 0; list_idx < 3; list_idx++ )
+	{
+		filename = g_strdup_printf( "tasklist-%d.json", list_idx + 1 );
+		url = data_file_url( filename );
+		request = submit_api_request( session->engine, "GET", url, NULL, NULL,
+									  copy_list_member,
+									  &lists[ list_idx ] );
+		request->user_data = GINT_TO_POINTER( list_idx + 1 );
+		g_free( url );
+		g_free( filename );
+	}
+	printf( "in flight: %u\n", session->engine->in_flight );
+
+	while( ( request = collect_api_request( session->engine ) ) != NULL )
+	{
+		printf( "in flight limit: %d\n",
+				session->engine->in_flight <= 2 ? 1 : 0 );
+		printf( "result %d: %d\n", GPOINTER_TO_INT( request->user_data ),
+				request->result );
+		destroy_api_request( request );
+		collected++;
+	}
+	printf( "collected: %d\n", collected );
+	for( list_idx = 0; list_idx < 3; list_idx++ )
+	{
+		printf( "%d: %s\n", list_idx + 1, lists[ list_idx ].title );
+		g_free( lists[ list_idx ].id );
+		g_free( lists[ list_idx ].title );
+	}
+
+	destroy_gtasks_session( session );
+}
+
+
+
+static void
+test__wait_for_api_request( const char *param )
+{
+	gtasks_session_t *session;
+	gchar            *url;
+	gtask_list_t     first;
+	gtask_list_t     second;
+	api_request_t    *first_request;
+	api_request_t    *second_request;
+	api_request_t    *request;
+	GSList           *requests;
+
+	global_config.parallel_requests = 2;
+	session = create_gtasks_session( );
+	memset( &first, 0, sizeof( first ) );
+	memset( &second, 0, sizeof( second ) );
+	url = data_file_url( "tasklist-1.json" );
+	first_request = submit_api_request( session->engine, "GET", url, NULL,
+										NULL, copy_list_member, &first );
+	g_free( url );
+	url = data_file_url( "tasklist-2.json" );
+	second_request = submit_api_request( session->engine, "GET", url, NULL,
+										 NULL, copy_list_member,
+										 &second );
+	g_free( url );
+
+	/* Wait for the second request; the first request remains available
+	   to collect_api_request. */
+	wait_for_api_request( session->engine, second_request );
+	printf( "1: %s\n", second.title );
+	destroy_api_request( second_request );
+	request = collect_api_request( session->engine );
+	printf( "2: %d\n", request == first_request ? 1 : 0 );
+	printf( "3: %s\n", first.title );
+	destroy_api_request( request );
+	request = collect_api_request( session->engine );
+	printf( "4: %d\n", request == NULL ? 1 : 0 );
+	g_free( first.id );
+	g_free( first.title );
+	g_free( second.id );
+	g_free( second.title );
+
+	/* Wait for any of a list of requests; a request that is not in the
+	   list remains available to collect_api_request. */
+	memset( &first, 0, sizeof( first ) );
+	memset( &second, 0, sizeof( second ) );
+	url = data_file_url( "tasklist-1.json" );
+	first_request = submit_api_request( session->engine, "GET", url, NULL,
+										NULL, copy_list_member, &first );
+	g_free( url );
+	url = data_file_url( "tasklist-3.json" );
+	second_request = submit_api_request( session->engine, "GET", url, NULL,
+										 NULL, copy_list_member,
+										 &second );
+	g_free( url );
+	requests = g_slist_append( NULL, first_request );
+	request = wait_for_any_api_request( session->engine, &requests );
+	printf( "5: %d %d %s\n", request == first_request ? 1 : 0,
+			requests == NULL ? 1 : 0, first.title );
+	destroy_api_request( request );
+	request = wait_for_any_api_request( session->engine, &requests );
+	printf( "6: %d\n", request == NULL ? 1 : 0 );
+	request = collect_api_request( session->engine );
+	printf( "7: %d %s\n", request == second_request ? 1 : 0, second.title );
+	destroy_api_request( request );
+	g_free( first.id );
+	g_free( first.title );
+	g_free( second.id );
+	g_free( second.title );
+
+	destroy_gtasks_session( session );
+}
+
+
+
+static void
+test__build_batch_body( const char *param )
+{
+	api_request_t get_request;
+	api_request_t patch_request;
+	GSList        *requests = NULL;
+	gchar         *body;
+	gchar         **lines;
+	int           line_idx;
+
+	memset( &get_request, 0, sizeof( get_request ) );
+	memset( &patch_request, 0, sizeof( patch_request ) );
+	get_request.method   = "GET";
+	get_request.url      = "https://www.googleapis.com/tasks/v1/lists/L1/tasks/T1";
+	patch_request.method = "PATCH";
+	patch_request.url    = "https://www.googleapis.com/tasks/v1/lists/L1/tasks/T2";
+	patch_request.body   = "{\"status\":\"completed\"}";
+	requests = g_slist_append( requests, &get_request );
+	requests = g_slist_append( requests, &patch_request );
+
+	/* Print the body with one numbered line per body line, making the line
+	   endings visible. */
+	body  = build_batch_body( requests, "batch_test" );
+	lines = g_strsplit( body, "\n", 0 );
+	for( line_idx = 0; lines[ line_idx ] != NULL; line_idx++ )
+	{
+		printf( "%d: %s$\n", line_idx + 1, lines[ line_idx ] );
+	}
+	g_strfreev( lines );
+	g_free( body );
+	g_slist_free( requests );
+}
+
+
+
+static void
+test__demultiplex_batch_response( const char *param )
+{
+	gchar         *response;
+	api_request_t requests[ 4 ];
+	GSList        *request_list = NULL;
+	gtask_list_t  list;
+	gboolean      success;
+	int           request_idx;
+
+	g_file_get_contents( "../../data/batch-response.txt", &response,
+						 NULL, NULL );
+	memset( requests, 0, sizeof( requests ) );
+	for( request_idx = 0; request_idx < 4; request_idx++ )
+	{
+		request_list = g_slist_append( request_list,
+									   &requests[ request_idx ] );
+	}
+
+	/* Wrong content type. */
+	success = demultiplex_batch_response( "application/json", response,
+										  request_list );
+	printf( "1: %d\n", success );
+
+	success = demultiplex_batch_response(
+		"multipart/mixed; boundary=batch_8Fq2kKAhP3Q_AAAAE0y6sOc",
+		response, request_list );
+	printf( "2: %d\n", success );
+	for( request_idx = 0; request_idx < 4; request_idx++ )
+	{
+		printf( "status %d: %ld\n", request_idx + 1,
+				requests[ request_idx ].http_status );
+		printf( "answered %d: %d\n", request_idx + 1,
+				requests[ request_idx ].response.data != NULL );
+	}
+	/* The parts are decoded by the requests' decoders. */
+	memset( &list, 0, sizeof( list ) );
+	decode_json_reply( requests[ 1 ].response.data, copy_list_member,
+					   &list );
+	printf( "3: %s\n", list.title );
+
+	for( request_idx = 0; request_idx < 4; request_idx++ )
+	{
+		g_free( requests[ request_idx ].response.data );
+	}
+	g_slist_free( request_list );
+	g_free( response );
+}
+
+
+
+static void
+test__response_cache( const char *param )
+{
+	response_cache_t *cache;
+	gchar            *etag;
+	gchar            *body;
+	gboolean         found;
+	const gchar      *uri = "https://www.googleapis.com/tasks/v1/lists/L1";
+
+	global_config.gmail_username = "user@gmail.com";
+	cache = create_response_cache( "cache" );
+	printf( "1: %d\n", cache != NULL );
+
+	found = read_cached_response( cache, uri, &etag, &body );
+	printf( "2: %d\n", found );
+
+	store_cached_response( cache, uri, "\"MTk3MzU2NTk3\"",
+						   "{\n \"title\": \"Task list 1\"\n}" );
+	found = read_cached_response( cache, uri, &etag, &body );
+	printf( "3: %d\n", found );
+	printf( "4: %s\n", etag );
+	printf( "5: %d\n", g_strcmp0( body, "{\n \"title\": \"Task list 1\"\n}" ) );
+	g_free( etag );
+	g_free( body );
+
+	/* Another user does not see the cached response. */
+	global_config.gmail_username = "other@gmail.com";
+	found = read_cached_response( cache, uri, &etag, &body );
+	printf( "6: %d\n", found );
+
+	destroy_response_cache( cache );
+}
+
+
+
+static void
+test__build_fields_mask( const char *param )
+{
+	gchar *mask;
+	gchar *omitted[ ] = { "selfLink", "links", "id", NULL };
+
+	mask = build_fields_mask( pull_task_list );
+	printf( "1: %s\n", mask );
+	g_free( mask );
+	mask = build_fields_mask( pull_task );
+	printf( "2: %s\n", mask );
+	g_free( mask );
+
+	/* Omitted members are left out, except for the ID. */
+	global_config.omitted_fields = omitted;
+	mask = build_fields_mask( pull_task_page );
+	printf( "3: %s\n", mask );
+	g_free( mask );
+
+	mask = build_fields_mask( NULL );
+	printf( "4: %s\n", mask == NULL ? "NULL" : mask );
+}
+
+
+
+static void
+test__buffer_pool( const char *param )
+{
+	buffer_pool_t              *pool;
+	struct curl_write_buffer_t first  = { NULL, 0, 0 };
+	struct curl_write_buffer_t second = { NULL, 0, 0 };
+	gchar                      *first_data;
+	gchar                      chunk[ 1000 ];
+	int                        chunk_idx;
+
+	pool = create_buffer_pool( 1 );
+	acquire_pooled_buffer( pool, &first );
+	printf( "1: %d %d\n", pool->hits, pool->misses );
+	printf( "2: %d \"%s\"\n", (int) first.size, first.data );
+
+	/* The buffer grows geometrically as data arrives. */
+	memset( chunk, 'x', sizeof( chunk ) );
+	for( chunk_idx = 0; chunk_idx < 40; chunk_idx++ )
+	{
+		receive_curl_response( chunk, 1, sizeof( chunk ), &first );
+	}
+	printf( "3: %d %d\n", (int) first.size,
+			first.allocated == 4 * POOL_BUFFER_SIZE );
+	printf( "4: %d\n", (int) strlen( first.data ) );
+
+	/* A released buffer is handed out again, emptied. */
+	first_data = first.data;
+	release_pooled_buffer( pool, &first );
+	printf( "5: %d\n", first.data == NULL );
+	acquire_pooled_buffer( pool, &second );
+	printf( "6: %d %d\n", pool->hits, pool->misses );
+	printf( "7: %d %d \"%s\"\n", second.data == first_data, (int) second.size,
+			second.data );
+
+	/* A full pool frees released buffers. */
+	acquire_pooled_buffer( pool, &first );
+	release_pooled_buffer( pool, &first );
+	release_pooled_buffer( pool, &second );
+	printf( "8: %d %d %d\n", pool->hits, pool->misses, pool->free_count );
+
+	destroy_buffer_pool( pool );
+}
+
+
+
+static void
+print_streamed_task( const gchar *element, gsize length, gpointer count_ptr )
+{
+	gtask_t task;
+	int     *count = count_ptr;
+
+	memset( &task, 0, sizeof( task ) );
+	decode_json_pull( element, length, NULL, pull_task, &task );
+	( *count )++;
+	printf( "task %d: %d %s\n", *count, length == strlen( element ),
+			task.title );
+	clear_schema_record( &gtask_schema, &task );
+}
+
+
+static void
+print_page_member( const gchar *name, JsonNode *node, gpointer data )
+{
+	if( JSON_NODE_HOLDS_ARRAY( node ) )
+	{
+		printf( "member: %s %u\n", name,
+				json_array_get_length( json_node_get_array( node ) ) );
+	}
+	else
+	{
+		printf( "member: %s\n", name );
+	}
+}
+
+
+static void
+test__json_stream( const char *param )
+{
+	json_stream_t    *stream;
+	gchar            *filename;
+	gchar            *contents;
+	gsize            length;
+	gsize            offset;
+	gtasks_session_t *session;
+	gchar            *url;
+	api_request_t    *request;
+	int              count = 0;
+
+	/* Feed the page to a stream in small chunks. */
+	filename = g_build_filename( "..", "..", "data", "tasks-page.json", NULL );
+	g_file_get_contents( filename, &contents, &length, NULL );
+	stream = create_json_stream( "items", print_streamed_task, &count );
+	for( offset = 0; offset < length; offset += 3 )
+	{
+		feed_json_stream( stream, &contents[ offset ],
+						  MIN( 3, length - offset ) );
+	}
+	printf( "1: %d %d\n", count, (int) stream->received == (int) length );
+	decode_json_reply( stream->document->str, print_page_member, NULL );
+	destroy_json_stream( stream );
+	g_free( contents );
+	g_free( filename );
+
+	/* Stream the page through the request engine. */
+	count = 0;
+	session = create_gtasks_session( );
+	url = data_file_url( "tasks-page.json" );
+	request = submit_api_request( session->engine, "GET", url, NULL, NULL,
+								  print_page_member, NULL );
+	stream_api_request( request, "items", print_streamed_task, &count );
+	wait_for_api_request( session->engine, request );
+	printf( "2: %d %d\n", count, request->answered );
+	destroy_api_request( request );
+	g_free( url );
+	destroy_gtasks_session( session );
+}
+
+
+
+static void
+test__rate_limiter( const char *param )
+{
+	rate_limiter_t *limiter;
+	gint64         now;
+	gint64         delay;
+	guint          attempt;
+	gboolean       within_bounds = TRUE;
+
+	/* Two requests per second, three at once. */
+	limiter = create_rate_limiter( 2.0, 3 );
+	now = limiter->refilled;
+	printf( "1: %u\n", count_rate_limiter_tokens( limiter, now ) );
+	printf( "2: %d\n", (int) take_rate_limiter_tokens( limiter, 3, now ) );
+	printf( "3: %d\n", (int) take_rate_limiter_tokens( limiter, 1, now ) );
+	printf( "4: %d\n", (int) take_rate_limiter_tokens( limiter, 1,
+													   now + 500000 ) );
+	/* A pause holds back all requests. */
+	pause_rate_limiter( limiter, now + 10 * G_USEC_PER_SEC );
+	printf( "5: %u %d\n",
+			count_rate_limiter_tokens( limiter, now + G_USEC_PER_SEC ),
+			(int) take_rate_limiter_tokens( limiter, 1,
+											now + G_USEC_PER_SEC ) );
+	printf( "6: %u\n",
+			count_rate_limiter_tokens( limiter, now + 11 * G_USEC_PER_SEC ) );
+	destroy_rate_limiter( limiter );
+	printf( "7: %d\n", create_rate_limiter( 0.0, 3 ) == NULL );
+
+	printf( "8: %d %d %d\n", (int) parse_retry_after( " 120\r\n" ),
+			(int) parse_retry_after( "0" ),
+			(int) parse_retry_after( "soon" ) );
+
+	/* The backoff doubles up to the largest delay, with jitter. */
+	for( attempt = 1; attempt <= 10; attempt++ )
+	{
+		delay = get_retry_delay( attempt, 500000, 4000000 );
+		if( ( delay < MIN( 250000 << ( attempt - 1 ), 2000000 ) ) ||
+			( delay > MIN( 500000 << ( attempt - 1 ), 4000000 ) ) )
+		{
+			within_bounds = FALSE;
+		}
+	}
+	printf( "9: %d\n", within_bounds );
+
+	printf( "10: %d %d %d %d %d\n",
+			is_retryable_request( "GET", CURLE_OK, 429 ),
+			is_retryable_request( "POST", CURLE_OK, 503 ),
+			is_retryable_request( "POST", CURLE_OK, 500 ),
+			is_retryable_request( "GET", CURLE_OK, 404 ),
+			is_retryable_request( "POST", CURLE_RECV_ERROR, 0 ) );
+
+	/* A Retry-After delay is honored up to the largest delay; beyond it,
+	   the request is not repeated. */
+	printf( "11: %d %d %d\n",
+			(int) get_retry_after_delay( 500000, 0, 4000000 ),
+			(int) get_retry_after_delay( 500000, 3000000, 4000000 ),
+			(int) get_retry_after_delay( 500000,
+										 parse_retry_after( "86400" ),
+										 4000000 ) );
+}
+
+
+
+static void
+test__latency_histogram( const char *param )
+{
+	latency_histogram_t *histogram;
+	gint64              value;
+	gchar               *name;
+
+	histogram = g_new0( latency_histogram_t, 1 );
+	printf( "1: %d\n", (int) get_histogram_percentile( histogram, 50.0 ) );
+	for( value = 1; value <= 1000; value++ )
+	{
+		record_histogram_value( histogram, value );
+	}
+	printf( "2: %d %d %d %d\n",
+			(int) get_histogram_percentile( histogram, 0.0 ),
+			(int) get_histogram_percentile( histogram, 50.0 ),
+			(int) get_histogram_percentile( histogram, 99.0 ),
+			(int) get_histogram_percentile( histogram, 100.0 ) );
+	/* Large values are kept with a small relative error. */
+	record_histogram_value( histogram, 3600000000LL );
+	value = get_histogram_percentile( histogram, 100.0 );
+	printf( "3: %d\n", value == 3600000000LL );
+	value = get_histogram_percentile( histogram, 99.95 );
+	printf( "4: %d\n", (int) value );
+	g_free( histogram );
+
+	name = get_latency_endpoint_name( "GET",
+		"https://www.googleapis.com/tasks/v1/lists/"
+		"MDg0NTQ0NjE3NTIwMDIxMjY0MTc6MDow/tasks?maxResults=100" );
+	printf( "5: %s\n", name );
+	g_free( name );
+	name = get_latency_endpoint_name( "POST",
+		"https://accounts.google.com/o/oauth2/token" );
+	printf( "6: %s\n", name );
+	g_free( name );
+}
+
+
+
+static void
+test__coalesce_requests( const char *param )
+{
+	gtasks_session_t *session;
+	gchar            *url;
+	gtask_list_t     lists[ 3 ];
+	api_request_t    *requests[ 3 ];
+	int              list_idx;
+	const gchar      *body = "{\"title\":\"Task list 2\"}";
+	gchar            *etag;
+	gchar            *cached_body;
+	gboolean         found[ 2 ];
+
+	global_config.parallel_requests = 2;
+	session = create_gtasks_session( );
+	memset( lists, 0, sizeof( lists ) );
+	url = data_file_url( "tasklist-2.json" );
+	for( list_idx = 0; list_idx < 3; list_idx++ )
+	{
+		requests[ list_idx ] = submit_api_request( session->engine, "GET",
+												   url, NULL, NULL,
+												   copy_list_member,
+												   &lists[ list_idx ] );
+	}
+	g_free( url );
+	/* Only the first request is sent. */
+	printf( "1: %u %u\n", g_queue_get_length( &session->engine->pending ),
+			session->engine->coalesced );
+
+	/* Each request decodes the shared response on its own. */
+	for( list_idx = 0; list_idx < 3; list_idx++ )
+	{
+		wait_for_api_request( session->engine, requests[ list_idx ] );
+		printf( "%d: %d %d %s\n", list_idx + 2,
+				requests[ list_idx ]->completed,
+				requests[ list_idx ]->answered, lists[ list_idx ].title );
+		destroy_api_request( requests[ list_idx ] );
+		g_free( lists[ list_idx ].id );
+		g_free( lists[ list_idx ].title );
+	}
+
+	/* A follower, which has no cache, does not write the response to the
+	   cache; its leader does. */
+	session->engine->cache = create_response_cache( "cache" );
+	for( list_idx = 0; list_idx < 2; list_idx++ )
+	{
+		requests[ list_idx ] = g_new0( api_request_t, 1 );
+		requests[ list_idx ]->method      = g_strdup( "GET" );
+		requests[ list_idx ]->url         = data_file_url(
+			list_idx == 0 ? "tasklist-1.json" : "tasklist-3.json" );
+		requests[ list_idx ]->etag        = g_strdup( "\"e1\"" );
+		requests[ list_idx ]->http_status = 200;
+		requests[ list_idx ]->cache       =
+			( list_idx == 0 ) ? NULL : session->engine->cache;
+		requests[ list_idx ]->response.data      = g_strdup( body );
+		requests[ list_idx ]->response.size      = strlen( body );
+		requests[ list_idx ]->response.allocated = strlen( body ) + 1;
+		finish_buffered_request( session->engine, requests[ list_idx ] );
+		found[ list_idx ] = read_cached_response( session->engine->cache,
+												  requests[ list_idx ]->url,
+												  &etag, &cached_body );
+		g_free( etag );
+		g_free( cached_body );
+		destroy_api_request( requests[ list_idx ] );
+	}
+	printf( "5: %d %d\n", found[ 0 ], found[ 1 ] );
+
+	destroy_gtasks_session( session );
+}
+
+
+
+static void
+test__concurrency_limiter( const char *param )
+{
+	concurrency_limiter_t *limiter;
+	gint64                now = 1000000;
+	guint                 sample;
+
+	g_remove( "concurrency.limit" );
+	limiter = create_concurrency_limiter( 4, 8, "concurrency.limit" );
+	printf( "1: %u\n", get_concurrency_limit( limiter ) );
+	/* The limit grows by one per window while the latency is flat. */
+	for( sample = 0; sample < 20; sample++ )
+	{
+		record_concurrency_sample( limiter, 10000, FALSE, now );
+		now += 1000;
+	}
+	printf( "2: %u\n", get_concurrency_limit( limiter ) );
+	/* Refused requests halve the limit once per round trip. */
+	record_concurrency_sample( limiter, 10000, TRUE, now );
+	printf( "3: %u\n", get_concurrency_limit( limiter ) );
+	record_concurrency_sample( limiter, 10000, TRUE, now + 1000 );
+	printf( "4: %u\n", get_concurrency_limit( limiter ) );
+	/* So does a latency spike. */
+	now += 20000;
+	for( sample = 0; sample < 2; sample++ )
+	{
+		record_concurrency_sample( limiter, 50000, FALSE, now );
+		now += 50000;
+	}
+	printf( "5: %u\n", get_concurrency_limit( limiter ) );
+	/* The limit is kept between runs, within the largest limit. */
+	destroy_concurrency_limiter( limiter );
+	limiter = create_concurrency_limiter( 4, 8, "concurrency.limit" );
+	printf( "6: %u\n", get_concurrency_limit( limiter ) );
+	destroy_concurrency_limiter( limiter );
+	limiter = create_concurrency_limiter( 4, 1, "concurrency.limit" );
+	printf( "7: %u\n", get_concurrency_limit( limiter ) );
+	destroy_concurrency_limiter( limiter );
+}
+
+
+
+static void
+test__circuit_breaker( const char *param )
+{
+	circuit_breakers_t *breakers;
+	const gchar        *url = "https://www.googleapis.com/tasks/v1/lists";
+	gchar              *name;
+	gint64             now = 1000000;
+	gboolean           probe;
+
+	name = get_circuit_name( "https://www.googleapis.com/tasks/v1/x?y=z" );
+	printf( "1: %s\n", name );
+	g_free( name );
+
+	/* Three consecutive failures open the circuit of the server only. */
+	breakers = create_circuit_breakers( 3, 1000000 );
+	record_circuit_result( breakers, url, CURLE_COULDNT_CONNECT, 0, now );
+	record_circuit_result( breakers, url, CURLE_OK, 500, now );
+	printf( "2: %d\n", allow_circuit_request( breakers, url, now ) );
+	record_circuit_result( breakers, url, CURLE_OPERATION_TIMEDOUT, 0, now );
+	printf( "3: %d %d\n", allow_circuit_request( breakers, url, now + 1 ),
+			allow_circuit_request( breakers,
+								   "https://accounts.google.com/o/oauth2",
+								   now + 1 ) );
+	/* A single probe is let through, and its failure reopens the
+	   circuit. */
+	now += 1000000;
+	probe = allow_circuit_request( breakers, url, now );
+	printf( "4: %d %d\n", probe,
+			allow_circuit_request( breakers, url, now + 1 ) );
+	record_circuit_result( breakers, url, CURLE_OK, 503, now + 2 );
+	printf( "5: %d\n", allow_circuit_request( breakers, url, now + 3 ) );
+	/* A response from a working server closes the circuit. */
+	now += 2000000;
+	printf( "6: %d\n", allow_circuit_request( breakers, url, now ) );
+	record_circuit_result( breakers, url, CURLE_OK, 404, now );
+	record_circuit_result( breakers, url, CURLE_COULDNT_CONNECT, 0, now );
+	printf( "7: %d\n", allow_circuit_request( breakers, url, now ) );
+	destroy_circuit_breakers( breakers );
+
+	printf( "8: %d %d\n", create_circuit_breakers( 0, 1000000 ) == NULL,
+			allow_circuit_request( NULL, url, now ) );
+}
+
+
+
+static void
+test__address_family_cache( const char *param )
+{
+	address_family_cache_t *cache;
+	gchar                  *host;
+
+	host = get_url_host( "https://user@WWW.Googleapis.com:443/tasks/v1" );
+	printf( "1: %s\n", host );
+	g_free( host );
+	host = get_url_host( "http://[2001:db8::1]:8080/" );
+	printf( "2: %s\n", host );
+	g_free( host );
+
+	printf( "3: %d %d %d\n", get_address_family( "142.250.74.10" ),
+			get_address_family( "2a00:1450:400f::200a" ),
+			get_address_family( NULL ) );
+
+	/* The address families are kept between runs. */
+	g_remove( "address-families" );
+	cache = create_address_family_cache( "address-families" );
+	printf( "4: %d\n", get_preferred_address_family(
+				cache, "https://www.googleapis.com/tasks/v1" ) );
+	set_preferred_address_family( cache, "https://www.googleapis.com/a",
+								  ADDRESS_FAMILY_IPV4 );
+	set_preferred_address_family( cache, "https://accounts.google.com/",
+								  ADDRESS_FAMILY_IPV6 );
+	destroy_address_family_cache( cache );
+	cache = create_address_family_cache( "address-families" );
+	printf( "5: %d %d\n",
+			get_preferred_address_family( cache,
+										  "https://www.googleapis.com/b" ),
+			get_preferred_address_family( cache,
+										  "https://accounts.google.com/o" ) );
+	destroy_address_family_cache( cache );
+}
+
+
+
+static void
+test__compress_request_body( const char *param )
+{
+	GString  *body;
+	gchar    *compressed;
+	gsize    compressed_length;
+	gchar    *inflated;
+	z_stream stream;
+	int      i;
+
+	/* Tasks with long notes compress well. */
+	body = g_string_new( "{\"items\":[" );
+	for( i = 0; i < 100; i++ )
+	{
+		g_string_append_printf( body, "%s{\"title\":\"Task %d\","
+								"\"notes\":\"Remember to water the plants\"}",
+								i > 0 ? "," : "", i );
+	}
+	g_string_append( body, "]}" );
+	compressed = compress_request_body( body->str, body->len,
+										&compressed_length );
+	printf( "1: %d\n", compressed_length < body->len / 4 );
+	printf( "2: %02x %02x\n", (guchar) compressed[ 0 ],
+			(guchar) compressed[ 1 ] );
+
+	/* The compressed body is a gzip stream of the body. */
+	inflated = g_malloc( body->len + 1 );
+	memset( &stream, 0, sizeof( stream ) );
+	inflateInit2( &stream, 15 + 16 );
+	stream.next_in   = (Bytef*) compressed;
+	stream.avail_in  = compressed_length;
+	stream.next_out  = (Bytef*) inflated;
+	stream.avail_out = body->len + 1;
+	printf( "3: %d\n", inflate( &stream, Z_FINISH ) );
+	inflateEnd( &stream );
+	printf( "4: %d\n", stream.total_out == body->len &&
+			memcmp( inflated, body->str, body->len ) == 0 );
+	g_free( inflated );
+	g_free( compressed );
+
+	/* Short bodies are not made smaller by compression. */
+	compressed = compress_request_body( "{}", 2, &compressed_length );
+	printf( "5: %d\n", compressed == NULL );
+	g_string_free( body, TRUE );
+}
+
+
+
+static void
+test__task_schema( const char *param )
+{
+	const gchar *json =
+		"{\"kind\":\"tasks#task\",\"id\":\"t1\","
+		"\"title\":\"Water \\\"plants\\\"\",\"status\":\"needsAction\","
+		"\"updated\":\"2012-06-01T10:20:30.000Z\",\"deleted\":false,"
+		"\"links\":[{\"type\":\"email\",\"description\":\"Mail\","
+		"\"link\":\"mailto:a@b.c\"}]}";
+	gtask_t              *task;
+	gtask_t              *copy;
+	gtask_link_t         *link;
+	guint                idx;
+	const schema_field_t *field;
+	gboolean             found = TRUE;
+	gchar                *encoded;
+	gchar                *copy_encoded;
+
+	/* Every member is found in its slot of the perfect hash table. */
+	for( idx = 0; idx < gtask_schema.field_count; idx++ )
+	{
+		field = &gtask_schema.fields[ idx ];
+		if( ( field->name != NULL ) &&
+			( lookup_schema_field( &gtask_schema, field->name,
+								   strlen( field->name ) ) != field ) )
+		{
+			found = FALSE;
+		}
+	}
+	printf( "1: %d %d %d\n", found,
+			lookup_schema_field( &gtask_schema, "kind", 4 ) == NULL,
+			lookup_schema_field( &gtask_schema, "notes(", 5 ) ==
+			lookup_schema_field( &gtask_schema, "notes", 5 ) );
+
+	task = g_new0( gtask_t, 1 );
+	decode_json_reply( json, copy_task_member, task );
+	link = task->links->data;
+	printf( "2: %s %s %d %s\n", task->id, task->title,
+			g_slist_length( task->links ), link->link );
+
+	encoded = encode_schema_record( &gtask_schema, task );
+	printf( "3: %s\n", encoded );
+
+	/* A copy shares nothing with the original. */
+	copy = copy_schema_record( &gtask_schema, task );
+	link = copy->links->data;
+	printf( "4: %d %d\n", copy->title != task->title,
+			link != task->links->data );
+	destroy_schema_record( &gtask_schema, task );
+	copy_encoded = encode_schema_record( &gtask_schema, copy );
+	printf( "5: %d\n", g_strcmp0( encoded, copy_encoded ) );
+	destroy_schema_record( &gtask_schema, copy );
+	g_free( encoded );
+	g_free( copy_encoded );
+}
+
+
+
+/* Build a page of tasks such as Google sends them. */
+static GString*
+build_task_page( int tasks )
+{
+	GString *page;
+	int     i;
+
+	page = g_string_new( "{\"kind\":\"tasks#tasks\",\"etag\":\"\\\"p\\\"\","
+						 "\"nextPageToken\":\"next\",\"items\":[" );
+	for( i = 0; i < tasks; i++ )
+	{
+		g_string_append_printf( page, "%s{\"kind\":\"tasks#task\","
+			"\"id\":\"task%d\",\"etag\":\"\\\"e%d\\\"\",\"title\":\"Task %d\","
+			"\"updated\":\"2012-06-01T10:20:30.000Z\","
+			"\"selfLink\":\"https://www.googleapis.com/tasks/v1/lists/l/"
+			"tasks/task%d\",\"position\":\"%020d\","
+			"\"notes\":\"Line one\\nLine \\\"two\\\" \\u00e9\","
+			"\"status\":\"needsAction\",\"due\":\"2012-07-01T00:00:00.000Z\","
+			"\"deleted\":false,\"links\":[{\"type\":\"email\","
+			"\"description\":\"Mail\",\"link\":\"mailto:a@b.c\"}]}",
+			i > 0 ? "," : "", i, i, i, i, i );
+	}
+	g_string_append( page, "]}" );
+
+	return( page );
+}
+
+
+static void
+free_task_page( struct tasks_page_t *page )
+{
+	GSList *task;
+
+	for( task = page->tasks; task != NULL; task = task->next )
+	{
+		destroy_schema_record( &gtask_schema, task->data );
+	}
+	g_slist_free( page->tasks );
+	g_free( page->next_page );
+	memset( page, 0, sizeof( *page ) );
+}
+
+
+static void
+test__pull_decoder( const char *param )
+{
+	const gchar         *document =
+		"{\"a\":[1,-2.5e3,true,false,null],\"s\":\"x\"}";
+	const gchar         *escaped = "\"x\\ny \\u00e9\\ud83d\\ude00\\/\"";
+	json_pull_t         pull;
+	json_token_t        token;
+	GString             *types;
+	gchar               *string;
+	GString             *page;
+	struct tasks_page_t dom_page;
+	struct tasks_page_t pull_page;
+	gboolean            decoded;
+	gboolean            identical;
+	GSList              *dom_task;
+	GSList              *pull_task;
+	gchar               *dom_json;
+	gchar               *pull_json;
+	int                 iterations;
+	int                 i;
+	gint64              start;
+	gint64              dom_time;
+	gint64              pull_time;
+
+	types = g_string_new( NULL );
+	init_json_pull( &pull, document, strlen( document ) );
+	while( next_json_token( &pull, &token ) > JSON_TOKEN_ERROR )
+	{
+		g_string_append_c( types, "..{}[]snTFN"[ token.type ] );
+	}
+	printf( "1: %s %d\n", types->str, token.type == JSON_TOKEN_END );
+	g_string_free( types, TRUE );
+
+	init_json_pull( &pull, escaped, strlen( escaped ) );
+	next_json_token( &pull, &token );
+	string = dup_json_string( &token );
+	printf( "2: %d\n",
+			strcmp( string, "x\ny \xc3\xa9\xf0\x9f\x98\x80/" ) );
+	g_free( string );
+
+	/* The pull decoder decodes a page exactly as the JSON tree does. */
+	page = build_task_page( 100 );
+	memset( &dom_page, 0, sizeof( dom_page ) );
+	memset( &pull_page, 0, sizeof( pull_page ) );
+	decode_json_reply( page->str, copy_page_member, &dom_page );
+	decoded = decode_json_pull( page->str, page->len, NULL, pull_task_page,
+								&pull_page );
+	identical = ( g_strcmp0( dom_page.next_page, pull_page.next_page ) == 0 );
+	for( dom_task = dom_page.tasks, pull_task = pull_page.tasks;
+		 ( dom_task != NULL ) && ( pull_task != NULL );
+		 dom_task = dom_task->next, pull_task = pull_task->next )
+	{
+		dom_json  = encode_schema_record( &gtask_schema, dom_task->data );
+		pull_json = encode_schema_record( &gtask_schema, pull_task->data );
+		identical = identical && ( strcmp( dom_json, pull_json ) == 0 );
+		g_free( dom_json );
+		g_free( pull_json );
+	}
+	printf( "3: %d %d %d %d\n", decoded, g_slist_length( dom_page.tasks ),
+			g_slist_length( pull_page.tasks ), identical );
+	free_task_page( &pull_page );
+
+	/* A truncated page is decoded as far as it goes. */
+	decoded = decode_json_pull( page->str, page->len / 2, NULL,
+								pull_task_page, &pull_page );
+	printf( "4: %d %d\n", decoded, g_slist_length( pull_page.tasks ) );
+	free_task_page( &pull_page );
+
+	/* Compare the time it takes to decode a page with each decoder when
+	   the test is given a number of iterations. */
+	if( param != NULL )
+	{
+		iterations = atoi( param );
+		start = g_get_monotonic_time( );
+		for( i = 0; i < iterations; i++ )
+		{
+			free_task_page( &dom_page );
+			decode_json_reply( page->str, copy_page_member, &dom_page );
+		}
+		dom_time = g_get_monotonic_time( ) - start;
+		start = g_get_monotonic_time( );
+		for( i = 0; i < iterations; i++ )
+		{
+			free_task_page( &pull_page );
+			decode_json_pull( page->str, page->len, NULL, pull_task_page,
+							  &pull_page );
+		}
+		pull_time = g_get_monotonic_time( ) - start;
+		printf( "JSON tree: %.1f us/page, pull parser: %.1f us/page\n",
+				(gdouble) dom_time / iterations,
+				(gdouble) pull_time / iterations );
+		free_task_page( &pull_page );
+	}
+	free_task_page( &dom_page );
+	g_string_free( page, TRUE );
+}
+
+
+
+/* List the tokens of a document, using a structural index if one is given. */
+static gchar*
+describe_json_tokens( const gchar *json, gsize length,
+					  const json_index_t *index )
+{
+	json_pull_t  pull;
+	json_token_t token;
+	GString      *tokens;
+
+	init_json_pull( &pull, json, length );
+	if( index != NULL )
+	{
+		pull.structure       = index->positions;
+		pull.structure_count = index->count;
+	}
+	tokens = g_string_new( NULL );
+	do
+	{
+		next_json_token( &pull, &token );
+		g_string_append_printf( tokens, "%d:%ld:%lu:%d ", token.type,
+								(long) ( token.start - json ),
+								(unsigned long) token.length, token.escaped );
+	} while( token.type > JSON_TOKEN_ERROR );
+
+	return( g_string_free( tokens, FALSE ) );
+}
+
+
+/* Decode a page of tasks with a scanner and encode the tasks again. */
+static gchar*
+decode_indexed_page( const GString *page, json_scanner_t scanner )
+{
+	struct tasks_page_t decoded;
+	GString             *encoded;
+	GSList              *task;
+	gchar               *task_json;
+
+	global_config.json_scanner = scanner;
+	memset( &decoded, 0, sizeof( decoded ) );
+	decode_json_pull( page->str, page->len, NULL, pull_task_page,
+					  &decoded );
+	encoded = g_string_new( decoded.next_page );
+	for( task = decoded.tasks; task != NULL; task = task->next )
+	{
+		task_json = encode_schema_record( &gtask_schema, task->data );
+		g_string_append( encoded, task_json );
+		g_free( task_json );
+	}
+	free_task_page( &decoded );
+
+	return( g_string_free( encoded, FALSE ) );
+}
+
+
+static void
+test__json_scanner( const char *param )
+{
+	const json_scanner_t scanners[ ] =
+	{
+		JSON_SCANNER_SCALAR, JSON_SCANNER_SSE42, JSON_SCANNER_AVX2
+	};
+	const gchar          *small = "{\"a\":\"b,\\\"}\",\"c\":[1]}";
+	GString              *document;
+	json_scanner_t       scanner;
+	json_index_t         index;
+	gchar                *plain_tokens;
+	gchar                *indexed_tokens;
+	gboolean             identical;
+	gsize                shift;
+	gsize                i;
+	GString              *page;
+	gchar                *plain_page;
+	gchar                *indexed_page;
+	int                  iterations;
+	int                  j;
+	gint64               start;
+
+	/* Every scanner finds the same tokens as the tokenizer without an
+	   index, wherever the escapes and strings fall in the 64-byte blocks. */
+	identical = TRUE;
+	for( shift = 0; shift <= 70; shift++ )
+	{
+		document = g_string_new( NULL );
+		for( i = 0; i < shift; i++ )
+		{
+			g_string_append_c( document, ' ' );
+		}
+		g_string_append( document, "{\"k\\\"ey\":\"a,b:{c}[d]\","
+						 "\"b\":\"\\\\\",\"c\":[\"\\\\\\\"\",true,null,-1.5],"
+						 "\"d\":{\"e\":\"" );
+		for( i = 0; i < 70; i++ )
+		{
+			g_string_append_c( document, '\\' );
+		}
+		g_string_append( document, "\\\"]\"},\"f\":\"\"}" );
+		plain_tokens = describe_json_tokens( document->str, document->len,
+											 NULL );
+		for( i = 0; i < G_N_ELEMENTS( scanners ); i++ )
+		{
+			identical = identical &&
+				scan_json_structure( get_json_scanner( scanners[ i ] ),
+									 document->str, document->len, &index );
+			indexed_tokens = describe_json_tokens( document->str,
+												   document->len, &index );
+			identical = identical &&
+				( strcmp( plain_tokens, indexed_tokens ) == 0 );
+			g_free( indexed_tokens );
+			free_json_index( &index );
+		}
+		g_free( plain_tokens );
+		g_string_free( document, TRUE );
+	}
+	printf( "1: %d\n", identical );
+
+	/* The index holds the quotes and the structural characters outside the
+	   strings. */
+	scan_json_structure( JSON_SCANNER_SCALAR, small, strlen( small ),
+						 &index );
+	printf( "2:" );
+	for( i = 0; i < index.count; i++ )
+	{
+		printf( " %u", index.positions[ i ] );
+	}
+	printf( "\n" );
+	free_json_index( &index );
+
+	/* A document that ends inside a string is not indexed. */
+	printf( "3: %d\n",
+			scan_json_structure( JSON_SCANNER_SCALAR, "{\"a\":\"b", 7,
+								 &index ) );
+	free_json_index( &index );
+
+	/* A page of tasks is decoded identically with each scanner. */
+	page = build_task_page( 100 );
+	plain_page = decode_indexed_page( page, JSON_SCANNER_OFF );
+	printf( "4:" );
+	for( i = 0; i < G_N_ELEMENTS( scanners ); i++ )
+	{
+		indexed_page = decode_indexed_page( page, scanners[ i ] );
+		printf( " %d", strcmp( plain_page, indexed_page ) == 0 );
+		g_free( indexed_page );
+	}
+	printf( "\n" );
+	g_free( plain_page );
+
+	/* Compare the time it takes to decode a page with each scanner when the
+	   test is given a number of iterations. */
+	if( param != NULL )
+	{
+		iterations = atoi( param );
+		for( i = 0; i <= G_N_ELEMENTS( scanners ); i++ )
+		{
+			scanner = JSON_SCANNER_OFF;
+			if( i < G_N_ELEMENTS( scanners ) )
+			{
+				scanner = get_json_scanner( scanners[ i ] );
+			}
+			start = g_get_monotonic_time( );
+			for( j = 0; j < iterations; j++ )
+			{
+				g_free( decode_indexed_page( page, scanner ) );
+			}
+			printf( "Scanner %d: %.1f us/page\n", scanner,
+					(gdouble) ( g_get_monotonic_time( ) - start ) /
+					iterations );
+		}
+	}
+	global_config.json_scanner = JSON_SCANNER_AUTO;
+	g_string_free( page, TRUE );
+}
+
+
+
+static void
+test__timestamp( const char *param )
+{
+	const gchar *invalid[ ] =
+	{
+		"2012-13-01T10:20:30Z", "2012-02-30T10:20:30Z",
+		"1900-02-29T10:20:30Z", "2012-06-01T24:20:30Z",
+		"2012-06-01T10:20:30", "2012-06-01T10:20:30.Z",
+		"2012-06-01X10:20:30Z", "2012-06-01T10:20:3aZ",
+		"2012-06-01T10:20:30Zx", "2012-06-01T10:20:30+0200",
+		"2012-06-01T10:20:30+02:60", "2012-06-01"
+	};
+	const gchar *google = "2012-06-01T10:20:30.000Z";
+	gint64      timestamp;
+	gint64      offset_timestamp;
+	gint64      parsed;
+	gint64      time;
+	GString     *formatted;
+	gboolean    identical;
+	int         rejected;
+	gsize       idx;
+	int         iterations;
+	int         i;
+	gint64      start;
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	GTimeVal    timeval;
+	G_GNUC_END_IGNORE_DEPRECATIONS
+	GDateTime   *date_time;
+
+	parse_timestamp( google, strlen( google ), &timestamp );
+	printf( "1: %" G_GINT64_FORMAT "\n", timestamp );
+
+	/* Offsets from UTC and fractions of any length are accepted. */
+	parse_timestamp( "2012-06-01T12:50:30.123456789+02:30", 35,
+					 &offset_timestamp );
+	printf( "2: %" G_GINT64_FORMAT " %d\n", offset_timestamp - timestamp,
+			parse_timestamp( "2012-02-29t10:20:30z", 20, &parsed ) );
+
+	rejected = 0;
+	for( idx = 0; idx < G_N_ELEMENTS( invalid ); idx++ )
+	{
+		parsed = -1;
+		rejected += ( parse_timestamp( invalid[ idx ], strlen( invalid[ idx ] ),
+									   &parsed ) == FALSE ) &&
+			( parsed == -1 );
+	}
+	printf( "3: %d\n", rejected );
+
+	/* Formatted times are parsed back to the same millisecond, from the
+	   17th to the 25th century. */
+	identical = TRUE;
+	formatted = g_string_new( NULL );
+	for( time = -11644473600000000LL; time < 13569465600000000LL;
+		 time += 987654321123LL )
+	{
+		g_string_truncate( formatted, 0 );
+		append_timestamp( formatted, time );
+		identical = identical &&
+			parse_timestamp( formatted->str, formatted->len, &parsed ) &&
+			( parsed == time - ( ( time % 1000 ) + 1000 ) % 1000 );
+	}
+	g_string_truncate( formatted, 0 );
+	append_timestamp( formatted, timestamp );
+	printf( "4: %d %s\n", identical, formatted->str );
+	g_string_free( formatted, TRUE );
+
+	/* Compare the time it takes to parse a time stamp with the GLib
+	   functions that were used before, which are deprecated, when the test
+	   is given a number of iterations. */
+	if( param != NULL )
+	{
+		iterations = atoi( param );
+		start = g_get_monotonic_time( );
+		G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+		for( i = 0; i < iterations; i++ )
+		{
+			g_time_val_from_iso8601( google, &timeval );
+			date_time = g_date_time_new_from_timeval_local( &timeval );
+			g_date_time_unref( date_time );
+		}
+		G_GNUC_END_IGNORE_DEPRECATIONS
+		printf( "GDateTime: %.3f us/time stamp, ",
+				(gdouble) ( g_get_monotonic_time( ) - start ) / iterations );
+		start = g_get_monotonic_time( );
+		for( i = 0; i < iterations; i++ )
+		{
+			parse_timestamp( google, strlen( google ), &parsed );
+		}
+		printf( "parser: %.3f us/time stamp\n",
+				(gdouble) ( g_get_monotonic_time( ) - start ) / iterations );
+	}
+}
+
+
+
+static void
+test__string_pool( const char *param )
+{
+	string_pool_t       *pool;
+	string_pool_t       *other_pool;
+	gchar               buffer[ 16 ];
+	const gchar         *abc;
+	const gchar         *interned[ 10000 ];
+	gboolean            identical;
+	int                 idx;
+	GString             *page;
+	struct tasks_page_t tasks;
+	struct tasks_page_t other_tasks;
+	GSList              *task;
+	GSList              *other_task;
+	gboolean            shared_status;
+	gboolean            shared_type;
+	gboolean            distinct_pools;
+	const gchar         *type;
+
+	/* Equal strings are interned once. */
+	pool = create_string_pool( );
+	abc = intern_string( pool, "abcdef", 3 );
+	strcpy( buffer, "abc" );
+	printf( "1: %d %d %s\n", intern_string( pool, buffer, 3 ) == abc,
+			intern_string( pool, "abd", 3 ) != abc, abc );
+
+	/* The statuses are interned as the well-known strings. */
+	printf( "2: %d %d\n",
+			intern_string( pool, "needsAction", 11 ) ==
+			google_status_needs_action,
+			intern_string( pool, "completed", 9 ) == google_status_completed );
+
+	/* Strings are still found after the pool has grown. */
+	for( idx = 0; idx < 10000; idx++ )
+	{
+		sprintf( buffer, "s%d", idx );
+		interned[ idx ] = intern_string( pool, buffer, strlen( buffer ) );
+	}
+	identical = TRUE;
+	for( idx = 0; idx < 10000; idx++ )
+	{
+		sprintf( buffer, "s%d", idx );
+		identical = identical &&
+			( intern_string( pool, buffer, strlen( buffer ) ) ==
+			  interned[ idx ] ) && ( strcmp( interned[ idx ], buffer ) == 0 );
+	}
+	printf( "3: %d %d\n", identical,
+			intern_string( pool, "abc", 3 ) == abc );
+
+	/* The tasks of a page share their statuses and link types, but tasks
+	   that are decoded into different pools do not. */
+	other_pool = create_string_pool( );
+	page = build_task_page( 100 );
+	memset( &tasks, 0, sizeof( tasks ) );
+	memset( &other_tasks, 0, sizeof( other_tasks ) );
+	decode_json_pull( page->str, page->len, pool, pull_task_page, &tasks );
+	decode_json_pull( page->str, page->len, other_pool, pull_task_page,
+					  &other_tasks );
+	shared_status  = TRUE;
+	shared_type    = TRUE;
+	distinct_pools = TRUE;
+	type = ( (gtask_link_t*) ( (gtask_t*) tasks.tasks->data )->links->data )
+		->type;
+	for( task = tasks.tasks, other_task = other_tasks.tasks;
+		 ( task != NULL ) && ( other_task != NULL );
+		 task = task->next, other_task = other_task->next )
+	{
+		shared_status = shared_status &&
+			( ( (gtask_t*) task->data )->status ==
+			  google_status_needs_action );
+		shared_type = shared_type &&
+			( ( (gtask_link_t*) ( (gtask_t*) task->data )->links->data )
+			  ->type == type );
+		distinct_pools = distinct_pools &&
+			( ( (gtask_link_t*) ( (gtask_t*) other_task->data )->links->data )
+			  ->type != type );
+	}
+	printf( "4: %d %d %d %s\n", shared_status, shared_type, distinct_pools,
+			type );
+	free_task_page( &tasks );
+	free_task_page( &other_tasks );
+	g_string_free( page, TRUE );
+	destroy_string_pool( other_pool );
+	destroy_string_pool( pool );
+}
+
+
+
+static void
+test__hedge_requests( const char *param )
+{
+	gtasks_session_t   *session;
+	gchar              *urls[ 2 ];
+	gchar              *name;
+	latency_endpoint_t *endpoint;
+	gtask_list_t       lists[ 2 ];
+	api_request_t      *request;
+	api_request_t      *streamed;
+	int                url_idx;
+	int                sample;
+	int                count = 0;
+
+	global_config.parallel_requests = 4;
+	global_config.hedged_requests   = TRUE;
+	global_config.hedge_percentile  = 95.0;
+	session = create_gtasks_session( );
+	memset( lists, 0, sizeof( lists ) );
+
+	/* Seed the latencies so that requests to both endpoints are hedged as
+	   soon as they are started. */
+	for( url_idx = 0; url_idx < 2; url_idx++ )
+	{
+		name = g_strdup_printf( "tasklist-%d.json", url_idx + 1 );
+		urls[ url_idx ] = data_file_url( name );
+		g_free( name );
+		record_decode_latency( session->latency, "GET", urls[ url_idx ], 0 );
+		name = get_latency_endpoint_name( "GET", urls[ url_idx ] );
+		endpoint = g_hash_table_lookup( session->latency->endpoints, name );
+		g_free( name );
+		for( sample = 0; sample < 20; sample++ )
+		{
+			record_histogram_value( &endpoint->phases[ LATENCY_TOTAL ], 0 );
+		}
+	}
+	request = submit_api_request( session->engine, "GET", urls[ 0 ], NULL,
+								  NULL, copy_list_member, &lists[ 0 ] );
+	streamed = submit_api_request( session->engine, "GET", urls[ 1 ], NULL,
+								   NULL, copy_list_member, &lists[ 1 ] );
+	stream_api_request( streamed, "items", print_streamed_task, &count );
+	start_pending_requests( session->engine );
+	printf( "1: %d %d\n", request->hedge_time != 0,
+			streamed->hedge_time != 0 );
+
+	/* A streamed request that has begun to receive its response is not
+	   hedged. */
+	streamed->stream->received = 1;
+	hedge_slow_requests( session->engine );
+	printf( "2: %d %d %d %d %u\n", request->hedge != NULL,
+			request->hedge_time == 0, streamed->hedge == NULL,
+			streamed->hedge_time == 0, session->engine->hedges );
+	streamed->stream->received = 0;
+
+	/* A request whose duplicate is lost is not duplicated again. */
+	cancel_hedge_request( session->engine, request );
+	hedge_slow_requests( session->engine );
+	printf( "3: %d %u\n", request->hedge == NULL, session->engine->hedges );
+
+	wait_for_api_request( session->engine, request );
+	wait_for_api_request( session->engine, streamed );
+	for( url_idx = 0; url_idx < 2; url_idx++ )
+	{
+		printf( "%d: %s\n", url_idx + 4, lists[ url_idx ].title );
+		g_free( lists[ url_idx ].id );
+		g_free( lists[ url_idx ].title );
+		g_free( urls[ url_idx ] );
+	}
+	destroy_api_request( request );
+	destroy_api_request( streamed );
+
+	destroy_gtasks_session( session );
+}
@@ -29,6 +29,7 @@
 #include "gtasks2ical.h"
 #include "oauth2-google.h"
 #include "postform.h"
+#include "session.h"
 #include "testfunctions.h"
 
 
@@ -47,14 +48,16 @@ extern form_field_t *find_form( const gchar *raw_html_page,
 								const gchar *const *input_names );
 extern size_t receive_curl_response( const char *ptr, size_t size,
 									 size_t nmemb, void *state_data );
-extern gchar *read_url( CURL *curl, const gchar *url );
-extern form_field_t *get_form_from_url( CURL* curl, const gchar *url,
+extern gchar *read_url( gtasks_session_t *session, const gchar *url );
+extern form_field_t *get_form_from_url( gtasks_session_t *session,
+										const gchar *url,
 										const gchar *form_action,
 										const gchar *const *input_names );
 extern void modify_form_inputs( gpointer input_ptr, gpointer form_ptr );
 extern void modify_form( form_field_t *form, const GSList *inputs_to_modify );
-extern gchar *post_form( CURL *curl, const form_field_t *form,
+extern gchar *post_form( gtasks_session_t *session, const form_field_t *form,
 						 struct curl_slist *headers );
+extern gchar *encode_form( const form_field_t *form, gsize *length );
 
 
 static void test__get_forms( const char *param );
@@ -66,6 +69,7 @@ static void test__read_url( const char *param );
 static void test__get_form_from_url( const char *param );
 static void test__modify_form_inputs( const char *param );
 static void test__modify_form( const char *param );
+static void test__encode_form( const char *param );
 static void test__post_form( const char *param );
 static void test__login_to_gmail( const char *param );
 
@@ -81,6 +85,7 @@ const struct dispatch_table_t dispatch_table[ ] =
 	DISPATCHENTRY( get_form_from_url ),
 	DISPATCHENTRY( modify_form_inputs ),
 	DISPATCHENTRY( modify_form ),
+	DISPATCHENTRY( encode_form ),
 	DISPATCHENTRY( post_form ),
 	DISPATCHENTRY( login_to_gmail ),
 
@@ -256,8 +261,8 @@ static void test__receive_curl_response( const char *param )
 
 static void test__read_url( const char *param )
 {
-	CURL  *curl;
-	gchar *html;
+	gtasks_session_t *session;
+	gchar            *html;
 
 	/* Skip test if no internet access is available. */
 	if( test_check_internet( ) == FALSE )
@@ -265,9 +270,9 @@ static void test__read_url( const char *param )
 		exit( 77 );
 	}
 
-	curl = curl_easy_init( );
-	html = read_url( curl, "http://www.microsoft.com" );
-	curl_easy_cleanup( curl );
+	session = create_gtasks_session( );
+	html = read_url( session, "http://www.microsoft.com" );
+	destroy_gtasks_session( session );
 	if( html != NULL )
 	{
 		printf( "%s\n", html );
@@ -279,7 +284,7 @@ static void test__read_url( const char *param )
 
 static void test__get_form_from_url( const char *param )
 {
-	CURL *curl;
+	gtasks_session_t *session;
 	int  ctr;
 	char login_url[ 2048 ] = "file://";
 
@@ -291,9 +296,9 @@ static void test__get_form_from_url( const char *param )
 	getcwd( &login_url[ strlen( "file://" ) ], sizeof( login_url ) );
 	strcat( login_url, "/../../data/google-login.html" );
 
-	curl = curl_easy_init( );
-	form = get_form_from_url( curl, login_url, action, input_names );
-	curl_easy_cleanup( curl );
+	session = create_gtasks_session( );
+	form = get_form_from_url( session, login_url, action, input_names );
+	destroy_gtasks_session( session );
 
 	ctr = 1;
 	print_form( form, &ctr );
@@ -378,6 +383,31 @@ static void test__modify_form( const char *param )
 
 
 
+static void test__encode_form( const char *param )
+{
+	input_field_t input1 = { "in1", "a&b" };
+	input_field_t input2 = { "in2", NULL };
+	input_field_t input3 = { "e-mail", "x@y.z" };
+	form_field_t  form1  = { "form 1", "v/1", "action1", NULL };
+	form_field_t  form2  = { NULL, NULL, "action2", NULL };
+	gchar         *body;
+	gsize         length;
+
+	form1.input_fields = g_slist_append( NULL, &input1 );
+	form1.input_fields = g_slist_append( form1.input_fields, &input2 );
+	form1.input_fields = g_slist_append( form1.input_fields, &input3 );
+	body = encode_form( &form1, &length );
+	printf( "1: %s (%u)\n", body, (unsigned) length );
+	g_free( body );
+	g_slist_free( form1.input_fields );
+
+	body = encode_form( &form2, &length );
+	printf( "2: '%s' (%u)\n", body, (unsigned) length );
+	g_free( body );
+}
+
+
+
 static void test__post_form( const char *param )
 {
 	FILE               *filehd;
@@ -385,7 +415,7 @@ static void test__post_form( const char *param )
 	const gchar *const input_names[ ] = { NULL, NULL };
 	form_field_t       *form;
 	char               action_url[ 2048 ] = "file://";
-	CURL               *curl;
+	gtasks_session_t   *session;
 	char               *html;
 
 	html_buf = malloc( 75000 );
@@ -413,9 +443,9 @@ static void test__post_form( const char *param )
 	strcat( action_url, "/../../data/post.response.html" );
 	form->action = action_url;
 
-	curl = curl_easy_init( );
-	html = post_form( curl, form, NULL );
-	curl_easy_cleanup( curl );
+	session = create_gtasks_session( );
+	html = post_form( session, form, NULL );
+	destroy_gtasks_session( session );
 	printf( "%s\n", html );
 }
 
@@ -426,9 +456,7 @@ static void test__login_to_gmail( const char *param )
 	FILE *filehd;
 	char username[ 100 ];
 	char password[ 100 ];
-	CURL *curl;
-
-	global_config.ipv4_only = TRUE;
+	gtasks_session_t *session;
 
 	/* Skip test if no internet access is available. */
 	if( test_check_internet( ) == FALSE )
@@ -447,9 +475,8 @@ static void test__login_to_gmail( const char *param )
 	fgets( username, sizeof( username ), filehd );
 	fgets( password, sizeof( username ), filehd );
 
-	curl = curl_easy_init( );
-	curl_easy_setopt( curl, CURLOPT_COOKIESESSION, 1 );
-	curl_easy_setopt( curl, CURLOPT_COOKIEFILE, "cookies.txt" );
-	(void)login_to_gmail( curl, username, password );
-	curl_easy_cleanup( curl );
+	session = create_gtasks_session( );
+	curl_easy_setopt( session->curl, CURLOPT_COOKIEFILE, "cookies.txt" );
+	(void)login_to_gmail( session, username, password );
+	destroy_gtasks_session( session );
 }